@@ -0,0 +1,127 @@
+#include "AsyncMultiply.h"
+#include <cerrno>
+#include <ctime>
+#include <string>
+
+const char* jobStatusName(JobStatus status) {
+    switch (status) {
+        case JobStatus::Queued: return "queued";
+        case JobStatus::Running: return "running";
+        case JobStatus::Finished: return "finished";
+        case JobStatus::Cancelled: return "cancelled";
+        case JobStatus::DeadlineExceeded: return "deadline exceeded";
+        case JobStatus::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+JobAborted::JobAborted(JobStatus r)
+    : std::runtime_error(std::string("Multiply job stopped: ") + jobStatusName(r)), reason(r) {}
+
+CancellationToken::CancellationToken() : cancelled(false), hasDeadline(false) {}
+
+void CancellationToken::cancel() {
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+void CancellationToken::setDeadline(std::chrono::steady_clock::time_point when) {
+    hasDeadline = true;
+    deadline = when;
+}
+
+JobStatus CancellationToken::check() const {
+    if (cancelled.load(std::memory_order_relaxed)) {
+        return JobStatus::Cancelled;
+    }
+    if (hasDeadline && std::chrono::steady_clock::now() >= deadline) {
+        return JobStatus::DeadlineExceeded;
+    }
+    return JobStatus::Running;
+}
+
+JobState::JobState() : status(JobStatus::Queued), executionTime(0) {
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&changed, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+JobState::~JobState() {
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&mutex);
+}
+
+JobStatus JobState::getStatus() const {
+    pthread_mutex_lock(&mutex);
+    JobStatus current = status;
+    pthread_mutex_unlock(&mutex);
+    return current;
+}
+
+bool JobState::isDone() const {
+    JobStatus current = getStatus();
+    return current != JobStatus::Queued && current != JobStatus::Running;
+}
+
+long long JobState::getExecutionTime() const {
+    pthread_mutex_lock(&mutex);
+    long long time = executionTime;
+    pthread_mutex_unlock(&mutex);
+    return time;
+}
+
+void JobState::markRunning() {
+    pthread_mutex_lock(&mutex);
+    status = JobStatus::Running;
+    pthread_mutex_unlock(&mutex);
+}
+
+void JobState::finish(JobStatus final, long long time, std::exception_ptr failure) {
+    pthread_mutex_lock(&mutex);
+    status = final;
+    executionTime = time;
+    error = failure;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&mutex);
+}
+
+bool JobState::waitFor(long long timeoutMs) const {
+    timespec until;
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    if (timeoutMs >= 0) {
+        until.tv_sec += timeoutMs / 1000;
+        until.tv_nsec += (timeoutMs % 1000) * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec += 1;
+            until.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&mutex);
+    while (status == JobStatus::Queued || status == JobStatus::Running) {
+        if (timeoutMs < 0) {
+            pthread_cond_wait(&changed, &mutex);
+        }
+        else if (pthread_cond_timedwait(&changed, &mutex, &until) == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool done = status != JobStatus::Queued && status != JobStatus::Running;
+    pthread_mutex_unlock(&mutex);
+    return done;
+}
+
+void JobState::rethrowIfUnsuccessful() const {
+    JobStatus current = getStatus();
+    if (current == JobStatus::Cancelled || current == JobStatus::DeadlineExceeded) {
+        throw JobAborted(current);
+    }
+    if (current == JobStatus::Failed) {
+        pthread_mutex_lock(&mutex);
+        std::exception_ptr failure = error;
+        pthread_mutex_unlock(&mutex);
+        std::rethrow_exception(failure);
+    }
+}
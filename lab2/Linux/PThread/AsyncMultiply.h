@@ -0,0 +1,138 @@
+#ifndef ASYNC_MULTIPLY_H
+#define ASYNC_MULTIPLY_H
+
+#include "Matrix.h"
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+enum class JobStatus {
+    Queued,
+    Running,
+    Finished,
+    Cancelled,
+    DeadlineExceeded,
+    Failed
+};
+
+const char* jobStatusName(JobStatus status);
+
+// Thrown when a job was stopped by cancel() or its deadline
+class JobAborted : public std::runtime_error {
+private:
+    JobStatus reason;
+
+public:
+    explicit JobAborted(JobStatus reason);
+
+    // Cancelled or DeadlineExceeded
+    JobStatus getReason() const { return reason; }
+};
+
+// Stop request for a running job: an explicit cancel() or a deadline. Workers
+// poll it between tiles, so a job stops within one tile's worth of work.
+class CancellationToken {
+private:
+    std::atomic<bool> cancelled;
+    bool hasDeadline;
+    std::chrono::steady_clock::time_point deadline;
+
+public:
+    CancellationToken();
+
+    // May be called from any thread at any time
+    void cancel();
+    // Only before the job is handed to another thread
+    void setDeadline(std::chrono::steady_clock::time_point when);
+
+    // Running while the job may go on, otherwise Cancelled or DeadlineExceeded
+    JobStatus check() const;
+    bool stopRequested() const { return check() != JobStatus::Running; }
+};
+
+// Completion state shared by a background job and its handles
+class JobState {
+private:
+    mutable pthread_mutex_t mutex;
+    mutable pthread_cond_t changed;   // on CLOCK_MONOTONIC, for timed waits
+    JobStatus status;
+    std::exception_ptr error;
+    long long executionTime;
+
+public:
+    CancellationToken token;
+
+    JobState();
+    virtual ~JobState();
+
+    JobState(const JobState&) = delete;
+    JobState& operator=(const JobState&) = delete;
+
+    JobStatus getStatus() const;
+    bool isDone() const;
+    long long getExecutionTime() const;
+
+    void markRunning();
+    // Final status; wakes every waiter
+    void finish(JobStatus final, long long time, std::exception_ptr failure = nullptr);
+
+    // Waits until the job is done, at most timeoutMs milliseconds (forever if
+    // negative). True if it is done.
+    bool waitFor(long long timeoutMs) const;
+
+    // After the job is done: throws JobAborted, or rethrows the job's own error
+    void rethrowIfUnsuccessful() const;
+};
+
+template <typename Acc>
+struct AsyncMultiplyJob : JobState {
+    BasicMatrix<Acc> result;   // set before finish(Finished)
+};
+
+// Caller's side of a multiplyAsync() job. Copies share the job. The job keeps
+// running if every handle is dropped; cancel() first to stop it.
+template <typename Acc>
+class MultiplyHandle {
+private:
+    std::shared_ptr<AsyncMultiplyJob<Acc>> job;
+
+public:
+    MultiplyHandle() {}
+    explicit MultiplyHandle(std::shared_ptr<AsyncMultiplyJob<Acc>> j) : job(std::move(j)) {}
+
+    bool valid() const { return job != nullptr; }
+
+    JobStatus getStatus() const { return job->getStatus(); }
+    bool isDone() const { return job->isDone(); }
+
+    // True if the job is done within timeoutMs milliseconds
+    bool waitFor(long long timeoutMs) const { return job->waitFor(timeoutMs); }
+    void wait() const { job->waitFor(-1); }
+
+    // Asks the job to stop; a queued job never starts
+    void cancel() { job->token.cancel(); }
+
+    // Waits for the job and returns its result. Throws JobAborted if it was
+    // cancelled or ran past its deadline, or the job's own exception.
+    const BasicMatrix<Acc>& get() const {
+        wait();
+        job->rethrowIfUnsuccessful();
+        return job->result;
+    }
+
+    // Same, moving the result out of the job (once)
+    BasicMatrix<Acc> take() {
+        wait();
+        job->rethrowIfUnsuccessful();
+        return std::move(job->result);
+    }
+
+    // Multiply time of a finished job (queueing not included), in microseconds
+    long long getExecutionTime() const { return job->getExecutionTime(); }
+};
+
+#endif // ASYNC_MULTIPLY_H
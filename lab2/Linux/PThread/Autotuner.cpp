@@ -0,0 +1,227 @@
+#include "Autotuner.h"
+#include "PThreadMultiplier.h"
+#include "MatrixFile.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+std::string cpuModelName() {
+    static const std::string model = []() -> std::string {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.compare(0, 10, "model name") == 0) {
+                size_t colon = line.find(':');
+                if (colon != std::string::npos) {
+                    size_t begin = line.find_first_not_of(" \t", colon + 1);
+                    if (begin != std::string::npos) return line.substr(begin);
+                }
+            }
+        }
+        return "unknown";
+    }();
+    return model;
+}
+
+template <typename T, typename Acc>
+std::string tuningDTypeName() {
+    std::string element = matrixDTypeName(MatrixDTypeOf<T>::value);
+    std::string accumulator = matrixDTypeName(MatrixDTypeOf<Acc>::value);
+    return element == accumulator ? element : element + "->" + accumulator;
+}
+
+TuningProfile::TuningProfile(const std::string& p) : path(p) {
+    pthread_mutex_init(&mutex, nullptr);
+
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::vector<std::string> fields;
+        std::istringstream fieldStream(line);
+        std::string field;
+        while (std::getline(fieldStream, field, '\t')) {
+            fields.push_back(field);
+        }
+        if (fields.size() != 8) {
+            std::cerr << "Ignoring malformed line in " << path << ": " << line << std::endl;
+            continue;
+        }
+
+        TuningEntry entry;
+        entry.cpu = fields[0];
+        entry.dtype = fields[1];
+        entry.M = std::atoi(fields[2].c_str());
+        entry.K = std::atoi(fields[3].c_str());
+        entry.N = std::atoi(fields[4].c_str());
+        entry.blockSize = std::atoi(fields[5].c_str());
+        entry.threads = std::atoi(fields[6].c_str());
+        entry.time = std::atoll(fields[7].c_str());
+        if (entry.blockSize > 0 && entry.threads > 0) {
+            entries.push_back(entry);
+        }
+    }
+}
+
+TuningProfile::~TuningProfile() {
+    pthread_mutex_destroy(&mutex);
+}
+
+TuningProfile& TuningProfile::defaultProfile() {
+    static TuningProfile profile([]() -> std::string {
+        const char* env = std::getenv("MATRIX_TUNING_PROFILE");
+        return env != nullptr && *env != '\0' ? env : "matrix_tuning.profile";
+    }());
+    return profile;
+}
+
+// How far apart two shapes are: sum of |log| of the per-dimension ratios,
+// or -1 when some dimension differs by more than a factor of two
+static double shapeDistance(const TuningEntry& e, int M, int K, int N) {
+    const int have[3] = { e.M, e.K, e.N };
+    const int want[3] = { M, K, N };
+    double distance = 0.0;
+    for (int d = 0; d < 3; ++d) {
+        double ratio = static_cast<double>(std::max(have[d], 1)) / std::max(want[d], 1);
+        if (ratio > 2.0 || ratio < 0.5) return -1.0;
+        distance += std::fabs(std::log(ratio));
+    }
+    return distance;
+}
+
+bool TuningProfile::find(const std::string& dtype, int M, int K, int N, TuningEntry& entry) const {
+    const std::string& cpu = cpuModelName();
+    double bestDistance = -1.0;
+
+    pthread_mutex_lock(&mutex);
+    for (const TuningEntry& e : entries) {
+        if (e.cpu != cpu || e.dtype != dtype) continue;
+        double distance = shapeDistance(e, M, K, N);
+        if (distance >= 0.0 && (bestDistance < 0.0 || distance < bestDistance)) {
+            bestDistance = distance;
+            entry = e;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return bestDistance >= 0.0;
+}
+
+void TuningProfile::store(const TuningEntry& entry) {
+    pthread_mutex_lock(&mutex);
+
+    bool replaced = false;
+    for (TuningEntry& e : entries) {
+        if (e.cpu == entry.cpu && e.dtype == entry.dtype &&
+            e.M == entry.M && e.K == entry.K && e.N == entry.N) {
+            e = entry;
+            replaced = true;
+        }
+    }
+    if (!replaced) {
+        entries.push_back(entry);
+    }
+
+    // Write a temporary file and rename it, so readers never see half a profile
+    std::string temporary = path + ".tmp";
+    bool written;
+    {
+        std::ofstream out(temporary.c_str(), std::ios::trunc);
+        out << "# cpu\tdtype\tM\tK\tN\tblockSize\tthreads\ttimeUs\n";
+        for (const TuningEntry& e : entries) {
+            out << e.cpu << '\t' << e.dtype << '\t' << e.M << '\t' << e.K << '\t' << e.N << '\t'
+                << e.blockSize << '\t' << e.threads << '\t' << e.time << '\n';
+        }
+        written = static_cast<bool>(out.flush());
+    }
+    bool renamed = written && std::rename(temporary.c_str(), path.c_str()) == 0;
+
+    pthread_mutex_unlock(&mutex);
+
+    if (!renamed) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot write tuning profile '" + path + "'");
+    }
+}
+
+Autotuner::Autotuner(TuningProfile& p, int r) : profile(p), repeats(std::max(1, r)) {}
+
+template <typename T, typename Acc>
+TuningEntry Autotuner::tune(int M, int K, int N) {
+    if (M < 0 || K < 0 || N < 0) {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+
+    BasicMatrix<T> A(M, K);
+    BasicMatrix<T> B(K, N);
+    A.randomFill();
+    B.randomFill();
+
+    PThreadMultiplier multiplier;
+    int poolSize = multiplier.getPoolSize();
+    trials.clear();
+
+    TuningTrial best = { 0, 0, LLONG_MAX };
+    auto measure = [&](int blockSize, int threads) {
+        for (const TuningTrial& t : trials) {
+            if (t.blockSize == blockSize && t.threads == threads) return;
+        }
+        multiplier.setMaxThreads(threads);
+        TuningTrial trial = { blockSize, threads, LLONG_MAX };
+        for (int r = 0; r < repeats; ++r) {
+            multiplier.template multiply<T, Acc>(A, B, blockSize);
+            trial.time = std::min(trial.time, multiplier.getLastExecutionTime());
+        }
+        trials.push_back(trial);
+        if (trial.time < best.time) {
+            best = trial;
+        }
+    };
+
+    // Coarse: powers of two up to the whole matrix
+    int largest = std::max(1, std::max(M, N));
+    for (int blockSize = 8; blockSize < largest; blockSize *= 2) {
+        measure(blockSize, poolSize);
+    }
+    measure(largest, poolSize);
+
+    // Fine: halfway to the neighbouring powers of two
+    int coarse = best.blockSize;
+    for (int blockSize : { coarse * 3 / 4, coarse * 3 / 2 }) {
+        if (blockSize >= 1 && blockSize <= largest) {
+            measure(blockSize, poolSize);
+        }
+    }
+
+    // Fewer threads can win on small products, where wakeups dominate
+    for (int threads = poolSize / 2; threads >= 1; threads /= 2) {
+        long long before = best.time;
+        measure(best.blockSize, threads);
+        if (best.time >= before) break;
+    }
+
+    TuningEntry entry;
+    entry.cpu = cpuModelName();
+    entry.dtype = tuningDTypeName<T, Acc>();
+    entry.M = M;
+    entry.K = K;
+    entry.N = N;
+    entry.blockSize = best.blockSize;
+    entry.threads = best.threads;
+    entry.time = best.time;
+    profile.store(entry);
+    return entry;
+}
+
+#define INSTANTIATE_AUTOTUNER(T, Acc)                                  \
+    template std::string tuningDTypeName<T, Acc>();                    \
+    template TuningEntry Autotuner::tune<T, Acc>(int, int, int);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_AUTOTUNER)
+#undef INSTANTIATE_AUTOTUNER
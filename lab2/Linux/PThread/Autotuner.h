@@ -0,0 +1,87 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+// Tuned PThreadMultiplier parameters for one problem shape on one machine
+struct TuningEntry {
+    std::string cpu;        // CPU model name
+    std::string dtype;      // e.g. "int32" or "int8->int32"
+    int M;
+    int K;
+    int N;
+    int blockSize;
+    int threads;
+    long long time;         // best measured time, microseconds
+};
+
+// Tuning results kept in a small tab-separated text file, one entry per line.
+// All members are thread-safe.
+class TuningProfile {
+private:
+    std::string path;
+    std::vector<TuningEntry> entries;
+    mutable pthread_mutex_t mutex;
+
+public:
+    // Loads `path` if it exists; a missing file is an empty profile
+    explicit TuningProfile(const std::string& path);
+    ~TuningProfile();
+
+    TuningProfile(const TuningProfile&) = delete;
+    TuningProfile& operator=(const TuningProfile&) = delete;
+
+    // Profile at $MATRIX_TUNING_PROFILE, or "matrix_tuning.profile" in the
+    // working directory when the variable is not set
+    static TuningProfile& defaultProfile();
+
+    const std::string& getPath() const { return path; }
+
+    // Entry for this CPU and dtype whose shape is closest to M x K x N, as long
+    // as every dimension is within a factor of two; false if there is none
+    bool find(const std::string& dtype, int M, int K, int N, TuningEntry& entry) const;
+
+    // Adds or replaces the entry for (cpu, dtype, M, K, N) and rewrites the file
+    void store(const TuningEntry& entry);
+};
+
+// Name of the CPU tuning results are keyed on (from /proc/cpuinfo)
+std::string cpuModelName();
+
+// Key of an (element, accumulator) pair in the profile
+template <typename T, typename Acc>
+std::string tuningDTypeName();
+
+// One measured configuration
+struct TuningTrial {
+    int blockSize;
+    int threads;
+    long long time;
+};
+
+// Searches block size and thread count for PThreadMultiplier::multiply:
+// a geometric sweep of block sizes, a refinement step around the best one,
+// then halving the thread count while that keeps helping. About a dozen
+// configurations instead of one run per block size.
+class Autotuner {
+private:
+    TuningProfile& profile;
+    int repeats;
+    std::vector<TuningTrial> trials;
+
+public:
+    // Each configuration is timed `repeats` times and the fastest run kept
+    explicit Autotuner(TuningProfile& profile = TuningProfile::defaultProfile(), int repeats = 3);
+
+    // Tunes an M x K by K x N product on random data, stores the winner in the
+    // profile and returns it. Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+    template <typename T, typename Acc>
+    TuningEntry tune(int M, int K, int N);
+
+    // Every configuration measured by the last tune(), in order
+    const std::vector<TuningTrial>& getLastTrials() const { return trials; }
+};
+
+#endif // AUTOTUNER_H
@@ -0,0 +1,122 @@
+#include "BatchedGemm.h"
+#include "Gemm.h"
+#include <algorithm>
+#include <stdexcept>
+
+// C = A * B for one product whose sizes are known at compile time. A row of C
+// is accumulated in registers and the constant trip counts let the compiler
+// unroll and vectorize the whole thing.
+template <int M, int K, int N, typename T, typename Acc>
+static void fixedKernel(const T* a, int lda, const T* b, int ldb, Acc* c, int ldc,
+                        int, int, int) {
+    for (int i = 0; i < M; ++i) {
+        Acc row[N] = {};
+        const T* ai = a + i * lda;
+#pragma GCC unroll 16
+        for (int p = 0; p < K; ++p) {
+            Acc x = static_cast<Acc>(ai[p]);
+            const T* bp = b + p * ldb;
+#pragma GCC unroll 16
+            for (int j = 0; j < N; ++j) {
+                row[j] += x * static_cast<Acc>(bp[j]);
+            }
+        }
+        Acc* ci = c + i * ldc;
+#pragma GCC unroll 16
+        for (int j = 0; j < N; ++j) {
+            ci[j] = row[j];
+        }
+    }
+}
+
+// Other small shapes: same loop order, accumulating straight into C
+template <typename T, typename Acc>
+static void genericKernel(const T* a, int lda, const T* b, int ldb, Acc* c, int ldc,
+                          int M, int K, int N) {
+    for (int i = 0; i < M; ++i) {
+        Acc* ci = c + i * ldc;
+        std::fill(ci, ci + N, Acc(0));
+        const T* ai = a + i * lda;
+        for (int p = 0; p < K; ++p) {
+            Acc x = static_cast<Acc>(ai[p]);
+            const T* bp = b + p * ldb;
+            for (int j = 0; j < N; ++j) {
+                ci[j] += x * static_cast<Acc>(bp[j]);
+            }
+        }
+    }
+}
+
+// Larger products amortize packing, so they go to the SIMD GEMM (Gemm.h),
+// which packs into thread-local buffers and allocates nothing per call
+template <typename T, typename Acc>
+static void packedKernel(const T* a, int lda, const T* b, int ldb, Acc* c, int ldc,
+                         int M, int K, int N) {
+    gemm<T, Acc>(BasicMatrixView<const T>(a, M, K, lda), BasicMatrixView<const T>(b, K, N, ldb),
+                 BasicMatrixView<Acc>(c, M, N, ldc));
+}
+
+// Up to this many multiply-adds per product the unpacked loops win
+static const long long BATCH_UNPACKED_LIMIT = 16 * 16 * 16;
+
+template <typename T, typename Acc>
+struct BatchKernel {
+    typedef void (*Fn)(const T* a, int lda, const T* b, int ldb, Acc* c, int ldc,
+                       int M, int K, int N);
+};
+
+template <typename T, typename Acc>
+static typename BatchKernel<T, Acc>::Fn batchKernelFor(int M, int K, int N) {
+    if (M == K && K == N) {
+        switch (M) {
+            case 2: return fixedKernel<2, 2, 2, T, Acc>;
+            case 3: return fixedKernel<3, 3, 3, T, Acc>;
+            case 4: return fixedKernel<4, 4, 4, T, Acc>;
+            case 6: return fixedKernel<6, 6, 6, T, Acc>;
+            case 8: return fixedKernel<8, 8, 8, T, Acc>;
+            case 12: return fixedKernel<12, 12, 12, T, Acc>;
+            case 16: return fixedKernel<16, 16, 16, T, Acc>;
+        }
+    }
+    if (static_cast<long long>(M) * K * N <= BATCH_UNPACKED_LIMIT) {
+        return genericKernel<T, Acc>;
+    }
+    return packedKernel<T, Acc>;
+}
+
+// Products per task claimed from the shared cursor
+static const int BATCH_CHUNK = 64;
+
+template <typename T, typename Acc>
+void batchedMultiply(const StridedBatch<const T>& A, const StridedBatch<const T>& B,
+                     const StridedBatch<Acc>& C, ThreadPool* pool) {
+    if (A.count != B.count || A.count != C.count) {
+        throw std::invalid_argument("Batches must have the same number of matrices");
+    }
+    if (A.cols != B.rows || C.rows != A.rows || C.cols != B.cols) {
+        throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
+    }
+    if (A.ld < A.cols || B.ld < B.cols || C.ld < C.cols) {
+        throw std::invalid_argument("Leading dimension smaller than the row length");
+    }
+
+    int M = A.rows;
+    int K = A.cols;
+    int N = B.cols;
+    int count = A.count;
+    typename BatchKernel<T, Acc>::Fn kernel = batchKernelFor<T, Acc>(M, K, N);
+
+    ThreadPool::forEachChunk(pool, count, BATCH_CHUNK, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            kernel(A.data + i * A.batchStride, A.ld, B.data + i * B.batchStride, B.ld,
+                   C.data + i * C.batchStride, C.ld, M, K, N);
+        }
+    });
+}
+
+#define INSTANTIATE_BATCHED_GEMM(T, Acc)                                              \
+    template void batchedMultiply<T, Acc>(const StridedBatch<const T>&,               \
+                                          const StridedBatch<const T>&,               \
+                                          const StridedBatch<Acc>&, ThreadPool*);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_BATCHED_GEMM)
+#undef INSTANTIATE_BATCHED_GEMM
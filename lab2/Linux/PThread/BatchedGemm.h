@@ -0,0 +1,51 @@
+#ifndef BATCHED_GEMM_H
+#define BATCHED_GEMM_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <cstddef>
+
+// `count` matrices of rows x cols laid out at a fixed distance from each other:
+// matrix i starts at data + i * batchStride and has rows ld elements apart.
+// A tightly packed batch has ld = cols and batchStride = rows * cols.
+template <typename T>
+struct StridedBatch {
+    T* data;
+    int count;
+    int rows;
+    int cols;
+    int ld;
+    std::ptrdiff_t batchStride;
+
+    StridedBatch() : data(nullptr), count(0), rows(0), cols(0), ld(0), batchStride(0) {}
+    StridedBatch(T* d, int n, int r, int c, int l, std::ptrdiff_t s)
+        : data(d), count(n), rows(r), cols(c), ld(l), batchStride(s) {}
+
+    // Tightly packed batch
+    StridedBatch(T* d, int n, int r, int c)
+        : data(d), count(n), rows(r), cols(c), ld(c),
+          batchStride(static_cast<std::ptrdiff_t>(r) * c) {}
+
+    template <typename U>
+    StridedBatch(const StridedBatch<U>& b,
+                 typename std::enable_if<std::is_convertible<U*, T*>::value>::type* = nullptr)
+        : data(b.data), count(b.count), rows(b.rows), cols(b.cols), ld(b.ld),
+          batchStride(b.batchStride) {}
+
+    BasicMatrixView<T> operator[](int i) const {
+        return BasicMatrixView<T>(data + i * batchStride, rows, cols, ld);
+    }
+};
+
+// C[i] = A[i] * B[i] for every i in the batch. Shapes are checked once for
+// the whole batch. Each product runs on one thread; the pool (if any) splits
+// the batch instead of the products. Square 2, 3, 4, 6, 8, 12 and 16 products
+// use kernels with compile-time sizes, fully unrolled by the compiler; other
+// shapes up to 16^3 multiply-adds use a generic loop with the same structure,
+// and anything larger goes to the packed gemm() without allocating.
+// Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+template <typename T, typename Acc>
+void batchedMultiply(const StridedBatch<const T>& A, const StridedBatch<const T>& B,
+                     const StridedBatch<Acc>& C, ThreadPool* pool = nullptr);
+
+#endif // BATCHED_GEMM_H
@@ -0,0 +1,298 @@
+#include "Benchmark.h"
+#include "Autotuner.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+BenchmarkResult summarizeTimings(const BenchmarkCase& config, std::vector<double> times) {
+    BenchmarkResult r;
+    r.config = config;
+    r.runs = static_cast<int>(times.size());
+    r.minTime = r.medianTime = r.p95Time = r.meanTime = r.stddevTime = 0.0;
+    r.gops = r.bandwidth = 0.0;
+    if (times.empty()) {
+        return r;
+    }
+
+    std::sort(times.begin(), times.end());
+    size_t n = times.size();
+    r.minTime = times.front();
+    r.medianTime = n % 2 == 1 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2.0;
+    // Nearest rank
+    size_t rank = static_cast<size_t>(std::ceil(0.95 * n));
+    r.p95Time = times[std::max<size_t>(rank, 1) - 1];
+
+    double sum = 0.0;
+    for (double t : times) sum += t;
+    r.meanTime = sum / n;
+    double squares = 0.0;
+    for (double t : times) squares += (t - r.meanTime) * (t - r.meanTime);
+    r.stddevTime = n > 1 ? std::sqrt(squares / (n - 1)) : 0.0;
+
+    if (r.medianTime > 0.0) {
+        double M = config.M, K = config.K, N = config.N;
+        double seconds = r.medianTime * 1e-6;
+        r.gops = 2.0 * M * N * K / seconds * 1e-9;
+        double bytes = (M * K + K * N) * config.elementSize + M * N * config.resultSize;
+        r.bandwidth = bytes / seconds * 1e-9;
+    }
+    return r;
+}
+
+BenchmarkSuite::BenchmarkSuite(const BenchmarkOptions& o) : options(o) {
+    if (options.warmup < 0 || options.repeats < 1) {
+        throw std::invalid_argument("Benchmark needs warmup >= 0 and repeats >= 1");
+    }
+}
+
+const BenchmarkResult& BenchmarkSuite::run(const BenchmarkCase& config,
+                                           const std::function<void()>& fn,
+                                           const std::function<PerfCounts()>& counters) {
+    for (int i = 0; i < options.warmup; ++i) {
+        fn();
+    }
+
+    std::vector<double> times;
+    PerfCounts counted;
+    for (int i = 0; i < options.repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        if (counters) {
+            counted += counters();
+        }
+    }
+
+    results.push_back(summarizeTimings(config, times));
+    results.back().counters = counted.averaged(options.repeats);
+    return results.back();
+}
+
+const std::vector<BenchmarkResult>& BenchmarkSuite::getResults() const {
+    return results;
+}
+
+// "-" for a missing rate
+static void printRate(std::ostream& out, int width, double value) {
+    if (value < 0.0) {
+        out << std::setw(width) << "-";
+    }
+    else {
+        out << std::setw(width) << value;
+    }
+}
+
+void BenchmarkSuite::printTable(std::ostream& out) const {
+    bool withCounters = false;
+    for (const BenchmarkResult& r : results) {
+        withCounters = withCounters || r.counters.any();
+    }
+
+    out << std::left << std::setw(14) << "multiplier" << std::setw(8) << "dtype"
+        << std::right << std::setw(16) << "M x K x N" << std::setw(7) << "block"
+        << std::setw(5) << "thr" << std::setw(12) << "median us" << std::setw(12) << "p95 us"
+        << std::setw(10) << "stddev" << std::setw(9) << "GOPS" << std::setw(9) << "GB/s";
+    if (withCounters) {
+        // Misses per thousand instructions
+        out << std::setw(7) << "IPC" << std::setw(9) << "L1D/ki" << std::setw(9) << "LLC/ki"
+            << std::setw(9) << "dTLB/ki";
+    }
+    out << "\n";
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed;
+    for (const BenchmarkResult& r : results) {
+        std::ostringstream shape;
+        shape << r.config.M << "x" << r.config.K << "x" << r.config.N;
+        out << std::left << std::setw(14) << r.config.multiplier << std::setw(8) << r.config.dtype
+            << std::right << std::setw(16) << shape.str() << std::setw(7) << r.config.blockSize
+            << std::setw(5) << r.config.threads
+            << std::setprecision(0) << std::setw(12) << r.medianTime << std::setw(12) << r.p95Time
+            << std::setw(10) << r.stddevTime
+            << std::setprecision(2) << std::setw(9) << r.gops << std::setw(9) << r.bandwidth;
+        if (withCounters) {
+            printRate(out, 7, r.counters.ipc());
+            out << std::setprecision(1);
+            printRate(out, 9, r.counters.perKiloInstruction(PerfEvent::L1DMisses));
+            printRate(out, 9, r.counters.perKiloInstruction(PerfEvent::LLCMisses));
+            printRate(out, 9, r.counters.perKiloInstruction(PerfEvent::DTLBMisses));
+        }
+        out << "\n";
+    }
+    out.flags(flags);
+}
+
+static std::string jsonString(const std::string& s) {
+    std::ostringstream out;
+    out << '"';
+    for (char c : s) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+                        << std::dec << std::setfill(' ');
+                }
+                else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+static std::string utcTimestamp() {
+    std::time_t now = std::time(nullptr);
+    std::tm utc;
+    gmtime_r(&now, &utc);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return buffer;
+}
+
+void BenchmarkSuite::writeJson(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    out << std::setprecision(6);
+
+    out << "{\n  \"machine\": {\n"
+        << "    \"cpu\": " << jsonString(cpuModelName()) << ",\n"
+        << "    \"simd\": " << jsonString(simdIsaName(activeSimdIsa())) << ",\n"
+        << "    \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef __VERSION__
+        << "    \"compiler\": " << jsonString(__VERSION__) << ",\n"
+#endif
+        << "    \"timestamp\": " << jsonString(utcTimestamp()) << "\n  },\n"
+        << "  \"options\": { \"warmup\": " << options.warmup
+        << ", \"repeats\": " << options.repeats << " },\n"
+        << "  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    { \"multiplier\": " << jsonString(r.config.multiplier)
+            << ", \"dtype\": " << jsonString(r.config.dtype)
+            << ", \"M\": " << r.config.M << ", \"K\": " << r.config.K << ", \"N\": " << r.config.N
+            << ", \"blockSize\": " << r.config.blockSize << ", \"threads\": " << r.config.threads
+            << ", \"runs\": " << r.runs
+            << ", \"minUs\": " << r.minTime << ", \"medianUs\": " << r.medianTime
+            << ", \"p95Us\": " << r.p95Time << ", \"meanUs\": " << r.meanTime
+            << ", \"stddevUs\": " << r.stddevTime
+            << ", \"gops\": " << r.gops << ", \"bandwidthGBs\": " << r.bandwidth
+            << ", \"counters\": ";
+        if (r.counters.any()) {
+            // Only the events that were counted
+            const char* separator = "{ ";
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+                if (r.counters.values[e] < 0) continue;
+                out << separator << jsonString(perfEventName(static_cast<PerfEvent>(e))) << ": "
+                    << r.counters.values[e];
+                separator = ", ";
+            }
+            out << " }";
+        }
+        else {
+            out << "null";
+        }
+        out << " }";
+    }
+    out << "\n  ]\n}\n";
+    out.flags(flags);
+}
+
+static const char* CSV_HEADER =
+    "multiplier,dtype,M,K,N,blockSize,threads,runs,minUs,medianUs,p95Us,meanUs,stddevUs,gops,bandwidthGBs,"
+    "cycles,instructions,l1dMisses,llcMisses,dtlbMisses";
+
+// Columns before the counters; files written before the counters were added end there
+static const size_t CSV_TIMING_FIELDS = 15;
+
+void BenchmarkSuite::writeCsv(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    out << std::setprecision(6);
+    out << CSV_HEADER << "\n";
+    for (const BenchmarkResult& r : results) {
+        out << r.config.multiplier << ',' << r.config.dtype << ',' << r.config.M << ','
+            << r.config.K << ',' << r.config.N << ',' << r.config.blockSize << ','
+            << r.config.threads << ',' << r.runs << ',' << r.minTime << ',' << r.medianTime << ','
+            << r.p95Time << ',' << r.meanTime << ',' << r.stddevTime << ',' << r.gops << ','
+            << r.bandwidth;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            out << ',' << r.counters.values[e];
+        }
+        out << "\n";
+    }
+    out.flags(flags);
+}
+
+// Cases are matched on everything that describes the configuration
+static std::string caseKey(const std::vector<std::string>& fields) {
+    std::string key;
+    for (int i = 0; i < 7; ++i) {
+        key += fields[i];
+        key += ',';
+    }
+    return key;
+}
+
+int BenchmarkSuite::compareWithBaseline(const std::string& csvPath, double tolerance,
+                                        std::ostream& out) const {
+    std::ifstream in(csvPath.c_str());
+    if (!in) {
+        throw std::runtime_error("Cannot open benchmark baseline '" + csvPath + "'");
+    }
+
+    std::map<std::string, double> baseline;   // key -> median
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line.compare(0, 11, "multiplier,") == 0) continue;
+        std::vector<std::string> fields;
+        std::istringstream fieldStream(line);
+        std::string field;
+        while (std::getline(fieldStream, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() != CSV_TIMING_FIELDS &&
+            fields.size() != CSV_TIMING_FIELDS + PERF_EVENT_COUNT) {
+            std::cerr << "Ignoring malformed line in " << csvPath << ": " << line << std::endl;
+            continue;
+        }
+        baseline[caseKey(fields)] = std::atof(fields[9].c_str());
+    }
+
+    int regressions = 0;
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    for (const BenchmarkResult& r : results) {
+        std::ostringstream key;
+        key << r.config.multiplier << ',' << r.config.dtype << ',' << r.config.M << ','
+            << r.config.K << ',' << r.config.N << ',' << r.config.blockSize << ','
+            << r.config.threads << ',';
+        std::map<std::string, double>::const_iterator it = baseline.find(key.str());
+        if (it == baseline.end() || it->second <= 0.0) continue;
+
+        double change = r.medianTime / it->second - 1.0;
+        bool slower = change > tolerance;
+        regressions += slower;
+        out << std::left << std::setw(14) << r.config.multiplier << std::setw(8) << r.config.dtype
+            << std::right << std::setw(6) << r.config.M << "x" << r.config.K << "x" << r.config.N
+            << " block " << r.config.blockSize << ": " << std::showpos << change * 100.0
+            << std::noshowpos << "%" << (slower ? "  REGRESSION" : "") << "\n";
+    }
+    out.flags(flags);
+    return regressions;
+}
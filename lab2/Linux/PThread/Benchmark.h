@@ -0,0 +1,81 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "PerfCounters.h"
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct BenchmarkOptions {
+    int warmup;    // untimed runs before measuring
+    int repeats;   // timed runs per case
+
+    BenchmarkOptions() : warmup(1), repeats(5) {}
+};
+
+// One configuration: which multiplier on which shape
+struct BenchmarkCase {
+    std::string multiplier;
+    std::string dtype;
+    int M;
+    int K;
+    int N;
+    int blockSize;      // 0 when not applicable or tuned
+    int threads;
+    int elementSize;    // bytes per element of A and B
+    int resultSize;     // bytes per element of C
+};
+
+// Statistics over the timed runs of one case. Times in microseconds.
+struct BenchmarkResult {
+    BenchmarkCase config;
+    int runs;
+    double minTime;
+    double medianTime;
+    double p95Time;
+    double meanTime;
+    double stddevTime;
+    double gops;        // 2 * M * N * K / median, in 10^9 operations per second
+    double bandwidth;   // A, B read and C written once, per median, in GB/s
+    PerfCounts counters;   // per timed run (mean); -1 where not collected
+};
+
+// Runs cases with warmup and repetition and collects their statistics.
+// Results can be printed as a table or written as JSON / CSV; the CSV doubles
+// as a baseline for compareWithBaseline().
+class BenchmarkSuite {
+private:
+    BenchmarkOptions options;
+    std::vector<BenchmarkResult> results;
+
+public:
+    explicit BenchmarkSuite(const BenchmarkOptions& options = BenchmarkOptions());
+
+    // Calls fn warmup + repeats times, timing the repeats with a steady clock.
+    // If given, counters() is called after every timed run and must return the
+    // hardware counters of that run (e.g. PThreadMultiplier::getLastCounters).
+    const BenchmarkResult& run(const BenchmarkCase& config, const std::function<void()>& fn,
+                               const std::function<PerfCounts()>& counters = nullptr);
+
+    const std::vector<BenchmarkResult>& getResults() const;
+
+    // Adds IPC and misses per thousand instructions when some case has counters
+    void printTable(std::ostream& out) const;
+
+    // Machine description (CPU, SIMD ISA, hardware threads, compiler, time)
+    // followed by one object per case
+    void writeJson(std::ostream& out) const;
+    void writeCsv(std::ostream& out) const;
+
+    // Reads a CSV written by writeCsv() and prints, for every case present in
+    // both, the change of the median time. Returns the number of cases more
+    // than `tolerance` (e.g. 0.10 = 10%) slower than the baseline.
+    // Throws std::runtime_error if the file cannot be read.
+    int compareWithBaseline(const std::string& csvPath, double tolerance, std::ostream& out) const;
+};
+
+// Summary statistics of a set of timings (microseconds)
+BenchmarkResult summarizeTimings(const BenchmarkCase& config, std::vector<double> times);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,618 @@
+#include "Distributed.h"
+#include "Gemm.h"
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+void Communicator::broadcast(const std::vector<int>& group, int root, void* data,
+                             std::size_t bytes) {
+    int n = static_cast<int>(group.size());
+    int me = static_cast<int>(std::find(group.begin(), group.end(), myRank) - group.begin());
+    if (me == n || root < 0 || root >= n) {
+        throw std::invalid_argument("Broadcast root or caller is not in the group");
+    }
+    if (n == 1 || bytes == 0) {
+        return;
+    }
+
+    // Positions relative to the root: receive from the parent (the lowest set
+    // bit cleared), then forward to the children below that bit
+    int relative = (me - root + n) % n;
+    int mask = 1;
+    while (mask < n) {
+        if (relative & mask) {
+            recv(group[(relative - mask + root) % n], data, bytes);
+            break;
+        }
+        mask <<= 1;
+    }
+    for (mask >>= 1; mask > 0; mask >>= 1) {
+        if (relative + mask < n) {
+            send(group[(relative + mask + root) % n], data, bytes);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Shared memory transport
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory rings need lock-free 64-bit atomics");
+
+// Bytes in flight per ordered pair of ranks
+static const std::size_t SHM_RING_BYTES = 256 * 1024;
+
+// Byte counters of one ring, each on its own cache line
+struct ShmRing {
+    alignas(64) std::atomic<std::uint64_t> head;   // written by the sender
+    alignas(64) std::atomic<std::uint64_t> tail;   // written by the receiver
+};
+
+// Spins, then yields, then sleeps until ready(); throws once the group is aborted
+template <typename Ready>
+static void waitUntil(const std::atomic<int>& aborted, Ready ready) {
+    for (int round = 0; !ready(); ++round) {
+        if (aborted.load(std::memory_order_relaxed)) {
+            throw std::runtime_error("Process group aborted");
+        }
+        if (round < 64) {
+            continue;
+        }
+        if (round < 1024) {
+            sched_yield();
+        }
+        else {
+            timespec pause = { 0, 50 * 1000 };
+            nanosleep(&pause, nullptr);
+        }
+    }
+}
+
+class SharedMemoryCommunicator : public Communicator {
+private:
+    void* mapping;
+    std::size_t mappingBytes;
+    std::atomic<int>* aborted;
+    ShmRing* rings;    // size * size, [from * size + to]
+    char* buffers;     // SHM_RING_BYTES per ring
+
+    ShmRing& ring(int from, int to) { return rings[from * groupSize + to]; }
+    char* buffer(int from, int to) {
+        return buffers + (static_cast<std::size_t>(from) * groupSize + to) * SHM_RING_BYTES;
+    }
+
+    void checkPeer(int peer) const {
+        if (peer < 0 || peer >= groupSize || peer == myRank) {
+            throw std::invalid_argument("Bad peer rank " + std::to_string(peer));
+        }
+    }
+
+public:
+    explicit SharedMemoryCommunicator(int size) : Communicator(size) {
+        std::size_t pairs = static_cast<std::size_t>(size) * size;
+        std::size_t header = 64;
+        mappingBytes = header + pairs * sizeof(ShmRing) + pairs * SHM_RING_BYTES;
+        // Pages are only allocated for the rings that carry traffic
+        mapping = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                       -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error(std::string("Cannot map shared memory: ") + std::strerror(errno));
+        }
+        char* base = static_cast<char*>(mapping);
+        aborted = new (base) std::atomic<int>(0);
+        rings = reinterpret_cast<ShmRing*>(base + header);
+        for (std::size_t i = 0; i < pairs; ++i) {
+            new (&rings[i].head) std::atomic<std::uint64_t>(0);
+            new (&rings[i].tail) std::atomic<std::uint64_t>(0);
+        }
+        buffers = base + header + pairs * sizeof(ShmRing);
+    }
+
+    ~SharedMemoryCommunicator() {
+        munmap(mapping, mappingBytes);
+    }
+
+    void attach(int rank) {
+        myRank = rank;
+    }
+
+    void send(int to, const void* data, std::size_t bytes) {
+        checkPeer(to);
+        ShmRing& r = ring(myRank, to);
+        char* ringBuffer = buffer(myRank, to);
+        const char* source = static_cast<const char*>(data);
+        std::uint64_t head = r.head.load(std::memory_order_relaxed);
+        while (bytes > 0) {
+            std::uint64_t tail = 0;
+            waitUntil(*aborted, [&]() {
+                tail = r.tail.load(std::memory_order_acquire);
+                return head - tail < SHM_RING_BYTES;
+            });
+            std::size_t offset = head % SHM_RING_BYTES;
+            std::size_t chunk = std::min<std::size_t>(
+                bytes, std::min<std::size_t>(SHM_RING_BYTES - (head - tail), SHM_RING_BYTES - offset));
+            std::memcpy(ringBuffer + offset, source, chunk);
+            head += chunk;
+            r.head.store(head, std::memory_order_release);
+            source += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    void recv(int from, void* data, std::size_t bytes) {
+        checkPeer(from);
+        ShmRing& r = ring(from, myRank);
+        const char* ringBuffer = buffer(from, myRank);
+        char* target = static_cast<char*>(data);
+        std::uint64_t tail = r.tail.load(std::memory_order_relaxed);
+        while (bytes > 0) {
+            std::uint64_t head = 0;
+            waitUntil(*aborted, [&]() {
+                head = r.head.load(std::memory_order_acquire);
+                return head != tail;
+            });
+            std::size_t offset = tail % SHM_RING_BYTES;
+            std::size_t chunk = std::min<std::size_t>(
+                bytes, std::min<std::size_t>(head - tail, SHM_RING_BYTES - offset));
+            std::memcpy(target, ringBuffer + offset, chunk);
+            tail += chunk;
+            r.tail.store(tail, std::memory_order_release);
+            target += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    // Aborts the whole group: every process polls the shared flag while it waits
+    void abort() {
+        aborted->store(1, std::memory_order_relaxed);
+    }
+};
+
+std::unique_ptr<Communicator> createSharedMemoryCommunicator(int size) {
+    if (size < 1) {
+        throw std::invalid_argument("A process group needs at least one rank");
+    }
+    return std::unique_ptr<Communicator>(new SharedMemoryCommunicator(size));
+}
+
+// ---------------------------------------------------------------------------
+// Unix socket transport
+
+class SocketCommunicator : public Communicator {
+private:
+    // [i * size + j]: the end rank i uses to talk to rank j (-1 once closed)
+    std::vector<int> fds;
+
+    int endpoint(int peer) const {
+        if (peer < 0 || peer >= groupSize || peer == myRank) {
+            throw std::invalid_argument("Bad peer rank " + std::to_string(peer));
+        }
+        return fds[myRank * groupSize + peer];
+    }
+
+    void closeAll() {
+        for (int& fd : fds) {
+            if (fd >= 0) close(fd);
+            fd = -1;
+        }
+    }
+
+public:
+    explicit SocketCommunicator(int size)
+        : Communicator(size), fds(static_cast<std::size_t>(size) * size, -1) {
+        for (int i = 0; i < size; ++i) {
+            for (int j = i + 1; j < size; ++j) {
+                int pair[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+                    int error = errno;
+                    closeAll();
+                    throw std::runtime_error(std::string("Cannot create socket pair: ") +
+                                             std::strerror(error));
+                }
+                fds[i * size + j] = pair[0];
+                fds[j * size + i] = pair[1];
+            }
+        }
+    }
+
+    ~SocketCommunicator() {
+        closeAll();
+    }
+
+    // Closes the ends that belong to other ranks, so a dead peer shows up as EOF
+    void attach(int rank) {
+        myRank = rank;
+        for (int i = 0; i < groupSize; ++i) {
+            if (i == rank) continue;
+            for (int j = 0; j < groupSize; ++j) {
+                int& fd = fds[i * groupSize + j];
+                if (fd >= 0) close(fd);
+                fd = -1;
+            }
+        }
+    }
+
+    void send(int to, const void* data, std::size_t bytes) {
+        int fd = endpoint(to);
+        const char* source = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t sent = ::send(fd, source, bytes, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Send to rank " + std::to_string(to) + " failed: " +
+                                         std::strerror(errno));
+            }
+            source += sent;
+            bytes -= sent;
+        }
+    }
+
+    void recv(int from, void* data, std::size_t bytes) {
+        int fd = endpoint(from);
+        char* target = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t received = ::recv(fd, target, bytes, 0);
+            if (received < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Receive from rank " + std::to_string(from) + " failed: " +
+                                         std::strerror(errno));
+            }
+            if (received == 0) {
+                throw std::runtime_error("Rank " + std::to_string(from) + " closed the connection");
+            }
+            target += received;
+            bytes -= received;
+        }
+    }
+
+    // Shutting the sockets down wakes blocked calls with EOF / EPIPE
+    void abort() {
+        for (int j = 0; j < groupSize; ++j) {
+            int fd = myRank >= 0 ? fds[myRank * groupSize + j] : -1;
+            if (fd >= 0) shutdown(fd, SHUT_RDWR);
+        }
+    }
+};
+
+std::unique_ptr<Communicator> createSocketCommunicator(int size) {
+    if (size < 1) {
+        throw std::invalid_argument("A process group needs at least one rank");
+    }
+    return std::unique_ptr<Communicator>(new SocketCommunicator(size));
+}
+
+// ---------------------------------------------------------------------------
+// Process group
+
+static std::string describeExit(int worker, int status) {
+    std::string who = "Worker process " + std::to_string(worker);
+    if (WIFSIGNALED(status)) {
+        return who + " was killed by signal " + std::to_string(WTERMSIG(status));
+    }
+    return who + " exited with status " + std::to_string(WEXITSTATUS(status));
+}
+
+void runProcessGroup(Communicator& comm, const std::function<void(Communicator&)>& worker,
+                     const std::function<void(Communicator&)>& coordinator) {
+    int workers = comm.size() - 1;
+    pid_t parent = getpid();
+    std::vector<pid_t> pids;
+
+    // Output still buffered here would otherwise be written again by any
+    // worker that reports an error (std::cerr flushes std::cout)
+    std::cout.flush();
+    std::fflush(nullptr);
+
+    for (int w = 0; w < workers; ++w) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            int error = errno;
+            for (pid_t p : pids) kill(p, SIGKILL);
+            for (pid_t p : pids) waitpid(p, nullptr, 0);
+            throw std::runtime_error(std::string("Cannot fork worker process: ") + std::strerror(error));
+        }
+        if (pid == 0) {
+            // Only this thread exists in the child; leave without running the
+            // parent's exit handlers or flushing its buffers a second time
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != parent) {
+                _exit(1);
+            }
+            int status = 0;
+            try {
+                comm.attach(w);
+                worker(comm);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Worker process " << w << ": " << e.what() << std::endl;
+                status = 1;
+            }
+            catch (...) {
+                status = 1;
+            }
+            _exit(status);
+        }
+        pids.push_back(pid);
+    }
+    comm.attach(workers);
+
+    // Reaps workers as they exit. The first failure kills the rest and wakes
+    // the coordinator, which may be blocked on the worker that died. Once the
+    // coordinator has failed, SIGKILL exits are its own kills, not failures;
+    // a worker that failed by itself is still reported, as it caused the
+    // coordinator's error.
+    std::string failure;
+    std::atomic<bool> coordinatorFailed(false);
+    std::thread watchdog([&]() {
+        std::vector<bool> done(workers, false);
+        int remaining = workers;
+        while (remaining > 0) {
+            for (int w = 0; w < workers; ++w) {
+                int status = 0;
+                if (done[w] || waitpid(pids[w], &status, WNOHANG) != pids[w]) continue;
+                done[w] = true;
+                --remaining;
+                bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                bool killedByCoordinator = coordinatorFailed.load() && WIFSIGNALED(status) &&
+                                           WTERMSIG(status) == SIGKILL;
+                if (!ok && !killedByCoordinator && failure.empty()) {
+                    failure = describeExit(w, status);
+                    for (int other = 0; other < workers; ++other) {
+                        if (!done[other]) kill(pids[other], SIGKILL);
+                    }
+                    comm.abort();
+                }
+            }
+            if (remaining > 0) {
+                timespec pause = { 0, 1000 * 1000 };
+                nanosleep(&pause, nullptr);
+            }
+        }
+    });
+
+    std::exception_ptr error;
+    try {
+        coordinator(comm);
+    }
+    catch (...) {
+        error = std::current_exception();
+        // Nobody will read from or write to the workers any more. Flagged
+        // first, so the watchdog does not take the kills for worker failures.
+        coordinatorFailed.store(true);
+        for (pid_t p : pids) kill(p, SIGKILL);
+    }
+    watchdog.join();
+
+    if (!failure.empty()) {
+        throw std::runtime_error(failure);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SUMMA
+
+ProcessGrid ProcessGrid::forProcesses(int processes) {
+    ProcessGrid grid;
+    grid.rows = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(processes))));
+    while (processes % grid.rows != 0) {
+        --grid.rows;
+    }
+    grid.cols = processes / grid.rows;
+    return grid;
+}
+
+// First index of band `part` when `total` is cut into `parts` near-equal bands
+static int bandBegin(int total, int parts, int part) {
+    return static_cast<int>(static_cast<long long>(total) * part / parts);
+}
+
+// Band holding `index`
+static int bandOf(int total, int parts, int index) {
+    int part = static_cast<int>(static_cast<long long>(index) * parts / total);
+    while (bandBegin(total, parts, part + 1) <= index) ++part;
+    while (bandBegin(total, parts, part) > index) --part;
+    return part;
+}
+
+// Blocks travel as one contiguous row-major message
+template <typename T>
+static void sendBlock(Communicator& comm, int to, const BasicMatrixView<const T>& block) {
+    std::vector<T> packed(static_cast<std::size_t>(block.rows) * block.cols);
+    for (int i = 0; i < block.rows; ++i) {
+        std::copy(block.rowPtr(i), block.rowPtr(i) + block.cols,
+                  packed.begin() + static_cast<std::size_t>(i) * block.cols);
+    }
+    comm.send(to, packed.data(), packed.size() * sizeof(T));
+}
+
+template <typename T>
+static void recvBlock(Communicator& comm, int from, const BasicMatrixView<T>& block) {
+    std::vector<T> packed(static_cast<std::size_t>(block.rows) * block.cols);
+    comm.recv(from, packed.data(), packed.size() * sizeof(T));
+    for (int i = 0; i < block.rows; ++i) {
+        const T* row = packed.data() + static_cast<std::size_t>(i) * block.cols;
+        std::copy(row, row + block.cols, block.rowPtr(i));
+    }
+}
+
+// Blocks of worker (r, c) in the coordinates of A, B and C
+struct SummaBlocks {
+    int rowBegin, rows;     // of A and C
+    int colBegin, cols;     // of B and C
+    int aKBegin, aK;        // columns of A
+    int bKBegin, bK;        // rows of B
+
+    SummaBlocks(const ProcessGrid& grid, int rank, int M, int K, int N) {
+        int r = rank / grid.cols;
+        int c = rank % grid.cols;
+        rowBegin = bandBegin(M, grid.rows, r);
+        rows = bandBegin(M, grid.rows, r + 1) - rowBegin;
+        colBegin = bandBegin(N, grid.cols, c);
+        cols = bandBegin(N, grid.cols, c + 1) - colBegin;
+        aKBegin = bandBegin(K, grid.cols, c);
+        aK = bandBegin(K, grid.cols, c + 1) - aKBegin;
+        bKBegin = bandBegin(K, grid.rows, r);
+        bK = bandBegin(K, grid.rows, r + 1) - bKBegin;
+    }
+};
+
+template <typename T, typename Acc>
+static void summaWorker(Communicator& comm, const ProcessGrid& grid, int M, int K, int N,
+                        int panelWidth) {
+    int coordinator = comm.size() - 1;
+    int r = comm.rank() / grid.cols;
+    int c = comm.rank() % grid.cols;
+    SummaBlocks my(grid, comm.rank(), M, K, N);
+
+    std::vector<T> localA(static_cast<std::size_t>(my.rows) * my.aK);
+    std::vector<T> localB(static_cast<std::size_t>(my.bK) * my.cols);
+    comm.recv(coordinator, localA.data(), localA.size() * sizeof(T));
+    comm.recv(coordinator, localB.data(), localB.size() * sizeof(T));
+
+    std::vector<int> rowGroup(grid.cols), colGroup(grid.rows);
+    for (int j = 0; j < grid.cols; ++j) rowGroup[j] = r * grid.cols + j;
+    for (int i = 0; i < grid.rows; ++i) colGroup[i] = i * grid.cols + c;
+
+    std::vector<Acc> localC(static_cast<std::size_t>(my.rows) * my.cols, Acc(0));
+    std::vector<T> panelA(static_cast<std::size_t>(my.rows) * panelWidth);
+    std::vector<T> panelB(static_cast<std::size_t>(panelWidth) * my.cols);
+    long long communication = 0;
+
+    bool first = true;
+    for (int k = 0; k < K;) {
+        // A panel never straddles two owners in the process row, nor B's in the column
+        int ownerCol = bandOf(K, grid.cols, k);
+        int ownerRow = bandOf(K, grid.rows, k);
+        int kEnd = std::min(k + panelWidth, std::min(bandBegin(K, grid.cols, ownerCol + 1),
+                                                     bandBegin(K, grid.rows, ownerRow + 1)));
+        int width = kEnd - k;
+
+        if (c == ownerCol) {
+            for (int i = 0; i < my.rows; ++i) {
+                const T* source = localA.data() + static_cast<std::size_t>(i) * my.aK + (k - my.aKBegin);
+                std::copy(source, source + width, panelA.begin() + static_cast<std::size_t>(i) * width);
+            }
+        }
+        // The owner's rows of B are already contiguous
+        T* bPanel = r == ownerRow
+                        ? localB.data() + static_cast<std::size_t>(k - my.bKBegin) * my.cols
+                        : panelB.data();
+
+        auto start = std::chrono::steady_clock::now();
+        comm.broadcast(rowGroup, ownerCol, panelA.data(),
+                       static_cast<std::size_t>(my.rows) * width * sizeof(T));
+        comm.broadcast(colGroup, ownerRow, bPanel,
+                       static_cast<std::size_t>(width) * my.cols * sizeof(T));
+        auto end = std::chrono::steady_clock::now();
+        communication += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        if (my.rows > 0 && my.cols > 0) {
+            gemm<T, Acc>(BasicMatrixView<const T>(panelA.data(), my.rows, width, width),
+                         BasicMatrixView<const T>(bPanel, width, my.cols, my.cols),
+                         BasicMatrixView<Acc>(localC.data(), my.rows, my.cols, my.cols), !first);
+        }
+        first = false;
+        k = kEnd;
+    }
+
+    comm.send(coordinator, &communication, sizeof(communication));
+    comm.send(coordinator, localC.data(), localC.size() * sizeof(Acc));
+}
+
+DistributedMultiplier::DistributedMultiplier(const DistributedOptions& o)
+    : options(o), executionTime(0), communicationTime(0) {
+    if (options.processes <= 0) {
+        options.processes = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (options.panelWidth <= 0) {
+        options.panelWidth = GemmBlocking::KC;
+    }
+    grid = ProcessGrid::forProcesses(options.processes);
+}
+
+template <typename T, typename Acc>
+BasicMatrix<Acc> DistributedMultiplier::multiply(const BasicMatrix<T>& A, const BasicMatrix<T>& B) {
+    if (A.getCols() != B.getRows()) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+    int M = A.getRows();
+    int K = A.getCols();
+    int N = B.getCols();
+    int processes = grid.rows * grid.cols;
+
+    BasicMatrix<Acc> result(M, N);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::unique_ptr<Communicator> comm =
+        options.transport == DistributedTransport::SharedMemory
+            ? createSharedMemoryCommunicator(processes + 1)
+            : createSocketCommunicator(processes + 1);
+
+    const ProcessGrid layout = grid;
+    int panelWidth = options.panelWidth;
+    long long slowest = 0;
+    runProcessGroup(
+        *comm,
+        [&](Communicator& c) { summaWorker<T, Acc>(c, layout, M, K, N, panelWidth); },
+        [&](Communicator& c) {
+            for (int w = 0; w < processes; ++w) {
+                SummaBlocks blocks(layout, w, M, K, N);
+                sendBlock<T>(c, w, A.block(blocks.rowBegin, blocks.aKBegin, blocks.rows, blocks.aK));
+                sendBlock<T>(c, w, B.block(blocks.bKBegin, blocks.colBegin, blocks.bK, blocks.cols));
+            }
+            for (int w = 0; w < processes; ++w) {
+                SummaBlocks blocks(layout, w, M, K, N);
+                long long communication = 0;
+                c.recv(w, &communication, sizeof(communication));
+                slowest = std::max(slowest, communication);
+                recvBlock<Acc>(c, w, result.block(blocks.rowBegin, blocks.colBegin,
+                                                  blocks.rows, blocks.cols));
+            }
+        });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    communicationTime = slowest;
+
+    return result;
+}
+
+ProcessGrid DistributedMultiplier::getGrid() const {
+    return grid;
+}
+
+long long DistributedMultiplier::getLastExecutionTime() const {
+    return executionTime;
+}
+
+long long DistributedMultiplier::getLastCommunicationTime() const {
+    return communicationTime;
+}
+
+#define INSTANTIATE_DISTRIBUTED(T, Acc)                                   \
+    template BasicMatrix<Acc> DistributedMultiplier::multiply<T, Acc>( \
+        const BasicMatrix<T>&, const BasicMatrix<T>&);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_DISTRIBUTED)
+#undef INSTANTIATE_DISTRIBUTED
@@ -0,0 +1,120 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "Matrix.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Ordered, reliable byte messages between the processes of a group, ranked
+// 0..size()-1. Messages between two ranks arrive in the order they were sent;
+// a send() is matched by exactly one recv() of the same size.
+// A communicator is created before the processes are forked and attached to its
+// rank in each of them (see runProcessGroup). Transports only have to provide
+// point-to-point messages, so one that crosses machines (e.g. TCP) plugs in
+// without touching the algorithms built on top.
+class Communicator {
+protected:
+    int groupSize;
+    int myRank;
+
+    explicit Communicator(int size) : groupSize(size), myRank(-1) {}
+
+public:
+    virtual ~Communicator() {}
+
+    Communicator(const Communicator&) = delete;
+    Communicator& operator=(const Communicator&) = delete;
+
+    int size() const { return groupSize; }
+    int rank() const { return myRank; }
+
+    // Called once per process after the fork: keeps this rank's endpoints
+    virtual void attach(int rank) = 0;
+
+    // Both block until the whole message is out / in. Throw std::runtime_error
+    // when the peer is gone or the group was aborted.
+    virtual void send(int to, const void* data, std::size_t bytes) = 0;
+    virtual void recv(int from, void* data, std::size_t bytes) = 0;
+
+    // Wakes every blocked send() / recv() of this process with an error.
+    // Safe to call from another thread.
+    virtual void abort() = 0;
+
+    // data of group[root] is copied to every other member of `group` along a
+    // binomial tree (log2(size) rounds). Every member calls it with the same
+    // group, root and size.
+    void broadcast(const std::vector<int>& group, int root, void* data, std::size_t bytes);
+};
+
+// Lock-free single-producer / single-consumer rings, one per ordered pair of
+// ranks, in an anonymous shared mapping. Waiting spins briefly, then yields.
+std::unique_ptr<Communicator> createSharedMemoryCommunicator(int size);
+
+// A Unix domain socket pair per pair of ranks
+std::unique_ptr<Communicator> createSocketCommunicator(int size);
+
+// Forks size() - 1 worker processes with ranks 0..size()-2 that run
+// worker(comm) and exit; the calling process takes the last rank and runs
+// coordinator(comm), then waits for the workers. If a worker fails (exception,
+// non-zero exit, signal), the others are killed and std::runtime_error is
+// thrown; workers die with the coordinator as well. The first failure is
+// reported: an exception of the coordinator is rethrown as is, unless a worker
+// had already failed.
+void runProcessGroup(Communicator& comm, const std::function<void(Communicator&)>& worker,
+                     const std::function<void(Communicator&)>& coordinator);
+
+enum class DistributedTransport {
+    SharedMemory,
+    UnixSockets
+};
+
+// Processes arranged as rows x cols, rows <= cols and as square as possible
+struct ProcessGrid {
+    int rows;
+    int cols;
+
+    static ProcessGrid forProcesses(int processes);
+};
+
+struct DistributedOptions {
+    int processes;    // worker processes; 0 means one per hardware thread
+    int panelWidth;   // K-width of the panels broadcast per step; 0 means GemmBlocking::KC
+    DistributedTransport transport;
+
+    DistributedOptions() : processes(4), panelWidth(0), transport(DistributedTransport::UnixSockets) {}
+};
+
+// C = A * B by SUMMA on a 2D grid of worker processes. Worker (r, c) owns the
+// r-th band of rows and c-th band of columns of C, A's block (row band r, K band
+// c) and B's block (K band r, column band c). At every step the owners of the
+// current K panel broadcast their piece of A along the process row and of B
+// along the process column, and every worker adds the panel product to its
+// block of C with gemm(). The coordinator scatters the blocks and gathers C
+// through the same communicator, so nothing relies on the workers sharing the
+// coordinator's memory.
+class DistributedMultiplier {
+private:
+    DistributedOptions options;
+    ProcessGrid grid;
+    long long executionTime;
+    long long communicationTime;
+
+public:
+    explicit DistributedMultiplier(const DistributedOptions& options = DistributedOptions());
+
+    // Instantiated for the pairs in MATRIX_PRODUCT_TYPES
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiply(const BasicMatrix<T>& A, const BasicMatrix<T>& B);
+
+    ProcessGrid getGrid() const;
+
+    // Wall time of the last multiply, process start-up and scatter / gather included
+    long long getLastExecutionTime() const;
+
+    // Longest time a single worker spent in panel broadcasts during the last multiply
+    long long getLastCommunicationTime() const;
+};
+
+#endif // DISTRIBUTED_H
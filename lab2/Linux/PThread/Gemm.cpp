@@ -0,0 +1,296 @@
+#include "Gemm.h"
+#include "AlignedAllocator.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// Packs the mc x kc block of A starting at (row, col) into mr-row panels, scaled
+// by alpha. Inside a panel the mr values of one k are adjacent; rows past mc are zero.
+template <typename T, typename Acc>
+static void packA(const BasicMatrixView<const T>& A, int row, int col, int mc, int kc, int mr,
+                  Acc alpha, Acc* dst) {
+    for (int ir = 0; ir < mc; ir += mr) {
+        int m = std::min(mr, mc - ir);
+        for (int i = 0; i < mr; ++i) {
+            if (i < m) {
+                const T* src = A.rowPtr(row + ir + i) + col;
+                if (alpha == Acc(1)) {
+                    for (int p = 0; p < kc; ++p) {
+                        dst[p * mr + i] = static_cast<Acc>(src[p]);
+                    }
+                }
+                else {
+                    for (int p = 0; p < kc; ++p) {
+                        dst[p * mr + i] = static_cast<Acc>(src[p]) * alpha;
+                    }
+                }
+            }
+            else {
+                for (int p = 0; p < kc; ++p) {
+                    dst[p * mr + i] = Acc(0);
+                }
+            }
+        }
+        dst += static_cast<size_t>(kc) * mr;
+    }
+}
+
+// Packs the kc x nc block of B starting at (row, col) into nr-column panels.
+// Inside a panel the nr values of one k are adjacent; columns past nc are zero.
+template <typename T, typename Acc>
+static void packB(const BasicMatrixView<const T>& B, int row, int col, int kc, int nc, int nr,
+                  Acc* dst) {
+    for (int jr = 0; jr < nc; jr += nr) {
+        int n = std::min(nr, nc - jr);
+        for (int p = 0; p < kc; ++p) {
+            const T* src = B.rowPtr(row + p) + col + jr;
+            Acc* d = dst + p * nr;
+            for (int j = 0; j < n; ++j) {
+                d[j] = static_cast<Acc>(src[j]);
+            }
+            for (int j = n; j < nr; ++j) {
+                d[j] = Acc(0);
+            }
+        }
+        dst += static_cast<size_t>(kc) * nr;
+    }
+}
+
+// Same panels as packA, from A stored transposed (K x M): one k of a panel is
+// mr adjacent values of a stored row
+template <typename T, typename Acc>
+static void packATransposed(const BasicMatrixView<const T>& At, int row, int col, int mc, int kc,
+                            int mr, Acc alpha, Acc* dst) {
+    for (int ir = 0; ir < mc; ir += mr) {
+        int m = std::min(mr, mc - ir);
+        for (int p = 0; p < kc; ++p) {
+            const T* src = At.rowPtr(col + p) + row + ir;
+            Acc* d = dst + p * mr;
+            for (int i = 0; i < m; ++i) {
+                d[i] = static_cast<Acc>(src[i]) * alpha;
+            }
+            for (int i = m; i < mr; ++i) {
+                d[i] = Acc(0);
+            }
+        }
+        dst += static_cast<size_t>(kc) * mr;
+    }
+}
+
+// Same panels as packB, from B stored transposed (N x K): each column of a
+// panel is kc adjacent values of a stored row
+template <typename T, typename Acc>
+static void packBTransposed(const BasicMatrixView<const T>& Bt, int row, int col, int kc, int nc,
+                            int nr, Acc* dst) {
+    for (int jr = 0; jr < nc; jr += nr) {
+        int n = std::min(nr, nc - jr);
+        for (int j = 0; j < nr; ++j) {
+            if (j < n) {
+                const T* src = Bt.rowPtr(col + jr + j) + row;
+                for (int p = 0; p < kc; ++p) {
+                    dst[p * nr + j] = static_cast<Acc>(src[p]);
+                }
+            }
+            else {
+                for (int p = 0; p < kc; ++p) {
+                    dst[p * nr + j] = Acc(0);
+                }
+            }
+        }
+        dst += static_cast<size_t>(kc) * nr;
+    }
+}
+
+// Portable 4 x 8 micro-kernel for accumulators without a hand-written SIMD kernel.
+// The fixed-length inner loop is left to the compiler's auto-vectorizer.
+template <typename Acc>
+static void genericMicroKernel(int kc, const Acc* a, const Acc* b, Acc* c, int ldc,
+                               int m, int n, bool accumulate) {
+    const int MR = 4;
+    const int NR = 8;
+    Acc acc[MR][NR] = {};
+
+    for (int p = 0; p < kc; ++p) {
+        for (int i = 0; i < MR; ++i) {
+            Acc ai = a[i];
+            for (int j = 0; j < NR; ++j) {
+                acc[i][j] += ai * b[j];
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+
+    for (int i = 0; i < m; ++i) {
+        Acc* row = c + static_cast<size_t>(i) * ldc;
+        if (accumulate) {
+            for (int j = 0; j < n; ++j) row[j] += acc[i][j];
+        }
+        else {
+            for (int j = 0; j < n; ++j) row[j] = acc[i][j];
+        }
+    }
+}
+
+template <typename Acc>
+struct MicroKernel {
+    int mr;
+    int nr;
+    void (*fn)(int kc, const Acc* a, const Acc* b, Acc* c, int ldc, int m, int n, bool accumulate);
+};
+
+template <typename Acc>
+static MicroKernel<Acc> microKernelFor() {
+    MicroKernel<Acc> kernel = { 4, 8, genericMicroKernel<Acc> };
+    return kernel;
+}
+
+// int32 accumulators use the run-time dispatched SIMD kernels
+template <>
+MicroKernel<std::int32_t> microKernelFor<std::int32_t>() {
+    const GemmMicroKernel& simd = gemmMicroKernel();
+    MicroKernel<std::int32_t> kernel = { simd.mr, simd.nr, simd.fn };
+    return kernel;
+}
+
+// C = beta * C, without reading C when beta is 0
+template <typename Acc>
+static void scaleBlock(const BasicMatrixView<Acc>& C, Acc beta) {
+    for (int i = 0; i < C.rows; ++i) {
+        Acc* c = C.rowPtr(i);
+        if (beta == Acc(0)) {
+            std::fill(c, c + C.cols, Acc(0));
+        }
+        else {
+            for (int j = 0; j < C.cols; ++j) c[j] *= beta;
+        }
+    }
+}
+
+// C = alpha * op(A) * op(B) + beta * C followed by the epilogue (null: none)
+template <typename T, typename Acc>
+static void gemmFused(MatrixOp opA, const BasicMatrixView<const T>& A,
+                      MatrixOp opB, const BasicMatrixView<const T>& B,
+                      const BasicMatrixView<Acc>& C, Acc alpha, Acc beta,
+                      const GemmEpilogue<Acc>* epilogue) {
+    bool transA = opA == MatrixOp::Transposed;
+    bool transB = opB == MatrixOp::Transposed;
+    const int M = transA ? A.cols : A.rows;
+    const int K = transA ? A.rows : A.cols;
+    const int N = transB ? B.rows : B.cols;
+    if ((transB ? B.cols : B.rows) != K || C.rows != M || C.cols != N) {
+        throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
+    }
+
+    if (K == 0) {
+        if (beta != Acc(1)) {
+            scaleBlock(C, beta);
+        }
+        if (epilogue != nullptr) {
+            epilogue->apply(C, 0, 0);
+        }
+        return;
+    }
+
+    // The kernels either store a tile or add it to C, so other betas scale the
+    // tile just before its first panel, while the kernel is about to load it anyway
+    bool accumulate = beta != Acc(0);
+    bool scale = accumulate && beta != Acc(1);
+
+    // Reused between calls on the same thread so tiles do not pay for allocation
+    typedef std::vector<Acc, AlignedAllocator<Acc, 64>> PackBuffer;
+    static thread_local PackBuffer packedA;
+    static thread_local PackBuffer packedB;
+
+    // Tile shape depends on the ISA picked at run time
+    const MicroKernel<Acc> kernel = microKernelFor<Acc>();
+    const int MR = kernel.mr;
+    const int NR = kernel.nr;
+
+    const int MC = GemmBlocking::MC;
+    const int KC = GemmBlocking::KC;
+    const int NC = GemmBlocking::NC;
+
+    size_t needA = static_cast<size_t>((std::min(MC, M) + MR - 1) / MR * MR) * std::min(KC, K);
+    size_t needB = static_cast<size_t>((std::min(NC, N) + NR - 1) / NR * NR) * std::min(KC, K);
+    if (packedA.size() < needA) packedA.resize(needA);
+    if (packedB.size() < needB) packedB.resize(needB);
+
+    for (int jc = 0; jc < N; jc += NC) {
+        int nc = std::min(NC, N - jc);
+
+        for (int pc = 0; pc < K; pc += KC) {
+            int kc = std::min(KC, K - pc);
+            bool add = accumulate || pc > 0;
+            bool first = pc == 0;
+            bool last = pc + kc == K;
+
+            if (transB) {
+                packBTransposed(B, pc, jc, kc, nc, NR, packedB.data());
+            }
+            else {
+                packB(B, pc, jc, kc, nc, NR, packedB.data());
+            }
+
+            for (int ic = 0; ic < M; ic += MC) {
+                int mc = std::min(MC, M - ic);
+
+                if (transA) {
+                    packATransposed(A, ic, pc, mc, kc, MR, alpha, packedA.data());
+                }
+                else {
+                    packA(A, ic, pc, mc, kc, MR, alpha, packedA.data());
+                }
+
+                for (int jr = 0; jr < nc; jr += NR) {
+                    const Acc* b = packedB.data() + static_cast<size_t>(jr) * kc;
+                    for (int ir = 0; ir < mc; ir += MR) {
+                        const Acc* a = packedA.data() + static_cast<size_t>(ir) * kc;
+                        int m = std::min(MR, mc - ir);
+                        int n = std::min(NR, nc - jr);
+                        if (first && scale) {
+                            scaleBlock(C.block(ic + ir, jc + jr, m, n), beta);
+                        }
+                        kernel.fn(kc, a, b, C.rowPtr(ic + ir) + jc + jr, C.stride, m, n, add);
+                        if (last && epilogue != nullptr) {
+                            epilogue->apply(C.block(ic + ir, jc + jr, m, n), ic + ir, jc + jr);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T, typename Acc>
+void gemm(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+          const BasicMatrixView<Acc>& C, bool accumulate) {
+    gemmFused<T, Acc>(MatrixOp::Normal, A, MatrixOp::Normal, B, C,
+                      Acc(1), accumulate ? Acc(1) : Acc(0), nullptr);
+}
+
+template <typename T, typename Acc>
+void gemm(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+          const BasicMatrixView<Acc>& C, Acc alpha, Acc beta, const GemmEpilogue<Acc>& epilogue) {
+    gemmFused<T, Acc>(MatrixOp::Normal, A, MatrixOp::Normal, B, C,
+                      alpha, beta, epilogue.empty() ? nullptr : &epilogue);
+}
+
+template <typename T, typename Acc>
+void gemm(MatrixOp opA, const BasicMatrixView<const T>& A,
+          MatrixOp opB, const BasicMatrixView<const T>& B,
+          const BasicMatrixView<Acc>& C, Acc alpha, Acc beta, const GemmEpilogue<Acc>& epilogue) {
+    gemmFused<T, Acc>(opA, A, opB, B, C, alpha, beta, epilogue.empty() ? nullptr : &epilogue);
+}
+
+#define INSTANTIATE_GEMM(T, Acc)                                                           \
+    template void gemm<T, Acc>(const BasicMatrixView<const T>&, const BasicMatrixView<const T>&, \
+                               const BasicMatrixView<Acc>&, bool);                          \
+    template void gemm<T, Acc>(const BasicMatrixView<const T>&, const BasicMatrixView<const T>&, \
+                               const BasicMatrixView<Acc>&, Acc, Acc, const GemmEpilogue<Acc>&); \
+    template void gemm<T, Acc>(MatrixOp, const BasicMatrixView<const T>&,                   \
+                               MatrixOp, const BasicMatrixView<const T>&,                   \
+                               const BasicMatrixView<Acc>&, Acc, Acc, const GemmEpilogue<Acc>&);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_GEMM)
+#undef INSTANTIATE_GEMM
@@ -0,0 +1,124 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "Matrix.h"
+#include <algorithm>
+
+// Cache blocking of the packed GEMM (in elements):
+//   KC x NR micro-panel of B stays in L1, MC x KC block of A in L2,
+//   KC x NC block of B in L3.
+struct GemmBlocking {
+    static const int MC = 96;
+    static const int KC = 256;
+    static const int NC = 2048;
+};
+
+// How gemm() reads a stored operand
+enum class MatrixOp {
+    Normal,      // as stored
+    Transposed   // the stored matrix is the operand's transpose
+};
+
+// C = A * B, or C += A * B when accumulate is true.
+// A is M x K, B is K x N, C is M x N; C must not overlap A or B.
+// Elements are widened from T to Acc while A and B are packed, so the
+// micro-kernel always runs on Acc. For int32 accumulators it is the widest SIMD
+// kernel the CPU supports (see SimdKernels.h); other types use a portable kernel.
+// Panels of A and B are packed into thread-local buffers, so concurrent calls
+// from different threads are safe as long as their C regions are disjoint.
+// Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+template <typename T, typename Acc>
+void gemm(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+          const BasicMatrixView<Acc>& C, bool accumulate = false);
+
+enum class GemmActivation {
+    None,
+    Relu,    // max(x, 0)
+    Clamp    // min(max(x, low), high)
+};
+
+// Post-processing fused into gemm(): after the last K panel of a micro-tile is
+// accumulated, the tile (still in L1) gets the biases added, then the activation,
+// then the custom callback. Everything is optional; the default does nothing.
+template <typename Acc>
+struct GemmEpilogue {
+    const Acc* rowBias;   // one value per row of C, or null
+    const Acc* colBias;   // one value per column of C, or null
+    GemmActivation activation;
+    Acc low;
+    Acc high;
+    
+    // Called for each finished tile; (row, col) is the tile's top-left corner in
+    // the caller's C (see rowOrigin / colOrigin)
+    void (*custom)(const BasicMatrixView<Acc>& tile, int row, int col, void* context);
+    void* context;
+    
+    // Position of the C passed to gemm() inside the caller's matrix, for callers
+    // that split C into blocks and run gemm() on each
+    int rowOrigin;
+    int colOrigin;
+    
+    GemmEpilogue()
+        : rowBias(nullptr), colBias(nullptr), activation(GemmActivation::None),
+          low(0), high(0), custom(nullptr), context(nullptr), rowOrigin(0), colOrigin(0) {}
+    
+    bool empty() const {
+        return rowBias == nullptr && colBias == nullptr &&
+               activation == GemmActivation::None && custom == nullptr;
+    }
+    
+    // The same epilogue for the block of C starting at (row, col)
+    GemmEpilogue shifted(int row, int col) const {
+        GemmEpilogue e = *this;
+        if (e.rowBias != nullptr) e.rowBias += row;
+        if (e.colBias != nullptr) e.colBias += col;
+        e.rowOrigin += row;
+        e.colOrigin += col;
+        return e;
+    }
+    
+    // Applies the epilogue to the block of C at (row, col), relative to gemm()'s C
+    void apply(const BasicMatrixView<Acc>& tile, int row, int col) const {
+        for (int i = 0; i < tile.rows; ++i) {
+            Acc* c = tile.rowPtr(i);
+            if (rowBias != nullptr) {
+                Acc bias = rowBias[row + i];
+                for (int j = 0; j < tile.cols; ++j) c[j] += bias;
+            }
+            if (colBias != nullptr) {
+                const Acc* bias = colBias + col;
+                for (int j = 0; j < tile.cols; ++j) c[j] += bias[j];
+            }
+            if (activation == GemmActivation::Relu) {
+                for (int j = 0; j < tile.cols; ++j) c[j] = std::max(c[j], Acc(0));
+            }
+            else if (activation == GemmActivation::Clamp) {
+                for (int j = 0; j < tile.cols; ++j) c[j] = std::min(std::max(c[j], low), high);
+            }
+        }
+        if (custom != nullptr) {
+            custom(tile, rowOrigin + row, colOrigin + col, context);
+        }
+    }
+};
+
+// Fused form: C = alpha * A * B + beta * C, then the epilogue, in one pass over
+// C. alpha is folded into the packing of A and beta into the first K panel of
+// each micro-tile, so C is read and written once. beta 0 never reads C (it may
+// hold garbage). Same threading rules as above.
+template <typename T, typename Acc>
+void gemm(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+          const BasicMatrixView<Acc>& C, Acc alpha, Acc beta,
+          const GemmEpilogue<Acc>& epilogue = GemmEpilogue<Acc>());
+
+// C = alpha * op(A) * op(B) + beta * C, then the epilogue. A transposed operand
+// is packed straight from its stored rows (A^T: K x M stored, B^T: N x K
+// stored), so A^T B and A B^T cost the same as A B and need no explicit
+// transpose. Same threading rules as above.
+template <typename T, typename Acc>
+void gemm(MatrixOp opA, const BasicMatrixView<const T>& A,
+          MatrixOp opB, const BasicMatrixView<const T>& B,
+          const BasicMatrixView<Acc>& C, Acc alpha = Acc(1), Acc beta = Acc(0),
+          const GemmEpilogue<Acc>& epilogue = GemmEpilogue<Acc>());
+
+#endif // GEMM_H
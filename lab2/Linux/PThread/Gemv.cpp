@@ -0,0 +1,212 @@
+#include "Gemv.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// Columns of A handled per pass: the matching slice of every vector stays in
+// L1 / L2 however long the rows are
+static const int GEMV_STRIP = 4096;
+
+// Elements of A per row block of a pass, reused by every vector of a batch
+// while it is in L2
+static const int GEMV_BLOCK_ELEMENTS = 1 << 15;
+
+// Elements of A per task of matVec() / vecMat()
+static const int GEMV_CHUNK_ELEMENTS = 1 << 16;
+
+// Dot product and axpy over one row, widening T to Acc
+template <typename T, typename Acc>
+struct VectorKernels {
+    // Four partial sums keep the adds independent
+    Acc dot(int n, const T* a, const T* x) const {
+        Acc s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        int j = 0;
+        for (; j + 4 <= n; j += 4) {
+            s0 += static_cast<Acc>(a[j]) * static_cast<Acc>(x[j]);
+            s1 += static_cast<Acc>(a[j + 1]) * static_cast<Acc>(x[j + 1]);
+            s2 += static_cast<Acc>(a[j + 2]) * static_cast<Acc>(x[j + 2]);
+            s3 += static_cast<Acc>(a[j + 3]) * static_cast<Acc>(x[j + 3]);
+        }
+        for (; j < n; ++j) {
+            s0 += static_cast<Acc>(a[j]) * static_cast<Acc>(x[j]);
+        }
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    void axpy(int n, Acc alpha, const T* a, Acc* y) const {
+        for (int j = 0; j < n; ++j) {
+            y[j] += alpha * static_cast<Acc>(a[j]);
+        }
+    }
+};
+
+// int32 rows use the run-time dispatched SIMD kernels, looked up once per call
+template <>
+struct VectorKernels<std::int32_t, std::int32_t> {
+    DotKernelFn dotFn;
+    AxpyKernelFn axpyFn;
+
+    VectorKernels() : dotFn(dotKernel()), axpyFn(axpyKernel()) {}
+
+    std::int32_t dot(int n, const std::int32_t* a, const std::int32_t* x) const {
+        return dotFn(n, a, x);
+    }
+
+    void axpy(int n, std::int32_t alpha, const std::int32_t* a, std::int32_t* y) const {
+        axpyFn(n, alpha, a, y);
+    }
+};
+
+template <typename T, typename Acc>
+static void checkGemvSizes(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& X,
+                           const BasicMatrixView<Acc>& Y) {
+    if (X.cols != A.cols || Y.rows != X.rows || Y.cols != A.rows) {
+        throw std::invalid_argument("Incompatible matrix and vector sizes");
+    }
+}
+
+template <typename T, typename Acc>
+static void checkGevmSizes(const BasicMatrixView<const T>& X, const BasicMatrixView<const T>& A,
+                           const BasicMatrixView<Acc>& Y) {
+    if (X.cols != A.rows || Y.rows != X.rows || Y.cols != A.cols) {
+        throw std::invalid_argument("Incompatible matrix and vector sizes");
+    }
+}
+
+template <typename Acc>
+static void clearRows(const BasicMatrixView<Acc>& Y) {
+    for (int v = 0; v < Y.rows; ++v) {
+        std::fill(Y.rowPtr(v), Y.rowPtr(v) + Y.cols, Acc(0));
+    }
+}
+
+template <typename T, typename Acc>
+void gemv(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& X,
+          const BasicMatrixView<Acc>& Y, bool accumulate) {
+    checkGemvSizes(A, X, Y);
+    int M = A.rows;
+    int K = A.cols;
+    if (!accumulate && K == 0) {
+        clearRows(Y);
+        return;
+    }
+
+    VectorKernels<T, Acc> kernels;
+    for (int k0 = 0; k0 < K; k0 += GEMV_STRIP) {
+        int kc = std::min(GEMV_STRIP, K - k0);
+        bool add = accumulate || k0 != 0;
+        int blockRows = std::max(1, GEMV_BLOCK_ELEMENTS / kc);
+        for (int i0 = 0; i0 < M; i0 += blockRows) {
+            int i1 = std::min(i0 + blockRows, M);
+            for (int v = 0; v < X.rows; ++v) {
+                const T* x = X.rowPtr(v) + k0;
+                Acc* y = Y.rowPtr(v);
+                for (int i = i0; i < i1; ++i) {
+                    Acc s = kernels.dot(kc, A.rowPtr(i) + k0, x);
+                    y[i] = add ? y[i] + s : s;
+                }
+            }
+        }
+    }
+}
+
+template <typename T, typename Acc>
+void gevm(const BasicMatrixView<const T>& X, const BasicMatrixView<const T>& A,
+          const BasicMatrixView<Acc>& Y, bool accumulate) {
+    checkGevmSizes(X, A, Y);
+    int M = A.rows;
+    int K = A.cols;
+    if (!accumulate) {
+        clearRows(Y);
+    }
+
+    VectorKernels<T, Acc> kernels;
+    for (int k0 = 0; k0 < K; k0 += GEMV_STRIP) {
+        int kc = std::min(GEMV_STRIP, K - k0);
+        int blockRows = std::max(1, GEMV_BLOCK_ELEMENTS / kc);
+        for (int i0 = 0; i0 < M; i0 += blockRows) {
+            int i1 = std::min(i0 + blockRows, M);
+            for (int v = 0; v < X.rows; ++v) {
+                const T* x = X.rowPtr(v);
+                Acc* y = Y.rowPtr(v) + k0;
+                for (int i = i0; i < i1; ++i) {
+                    kernels.axpy(kc, static_cast<Acc>(x[i]), A.rowPtr(i) + k0, y);
+                }
+            }
+        }
+    }
+}
+
+// Whole rows of A per task
+static int chunkRows(int cols) {
+    return std::max(1, GEMV_CHUNK_ELEMENTS / std::max(cols, 1));
+}
+
+template <typename T, typename Acc>
+void matVec(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& X,
+            const BasicMatrixView<Acc>& Y, ThreadPool* pool, int workers) {
+    checkGemvSizes(A, X, Y);
+    ThreadPool::forEachChunk(pool, A.rows, chunkRows(A.cols), [&](int begin, int end, int) {
+        gemv<T, Acc>(A.rowRange(begin, end), X, Y.block(0, begin, Y.rows, end - begin));
+    }, workers);
+}
+
+template <typename T, typename Acc>
+void vecMat(const BasicMatrixView<const T>& X, const BasicMatrixView<const T>& A,
+            const BasicMatrixView<Acc>& Y, ThreadPool* pool, int workers) {
+    checkGevmSizes(X, A, Y);
+    clearRows(Y);
+    if (Y.rows == 0 || Y.cols == 0) {
+        return;
+    }
+
+    // Worker 0 sums straight into Y, the others into a zeroed copy allocated
+    // (and first touched) by the worker on its first chunk
+    std::vector<BasicMatrix<Acc>> partials(pool != nullptr ? pool->size() : 1);
+    int used = ThreadPool::forEachChunk(pool, A.rows, chunkRows(A.cols), [&](int begin, int end, int worker) {
+        BasicMatrixView<Acc> target = Y;
+        if (worker != 0) {
+            if (partials[worker].getRows() == 0) {
+                partials[worker] = BasicMatrix<Acc>(Y.rows, Y.cols);
+            }
+            target = partials[worker].view();
+        }
+        gevm<T, Acc>(X.block(0, begin, X.rows, end - begin), A.rowRange(begin, end), target, true);
+    }, workers);
+    if (used <= 1) {
+        return;
+    }
+
+    // Each worker adds every partial into its own range of columns
+    pool->run(used, [&](int worker) {
+        int c0 = static_cast<int>(static_cast<long long>(Y.cols) * worker / used);
+        int c1 = static_cast<int>(static_cast<long long>(Y.cols) * (worker + 1) / used);
+        for (int p = 1; p < used; ++p) {
+            if (partials[p].getRows() == 0) {
+                continue;
+            }
+            for (int v = 0; v < Y.rows; ++v) {
+                const Acc* src = partials[p].rowPtr(v);
+                Acc* dst = Y.rowPtr(v);
+                for (int c = c0; c < c1; ++c) {
+                    dst[c] += src[c];
+                }
+            }
+        }
+    });
+}
+
+#define INSTANTIATE_GEMV(T, Acc)                                                               \
+    template void gemv<T, Acc>(const BasicMatrixView<const T>&, const BasicMatrixView<const T>&, \
+                               const BasicMatrixView<Acc>&, bool);                              \
+    template void gevm<T, Acc>(const BasicMatrixView<const T>&, const BasicMatrixView<const T>&, \
+                               const BasicMatrixView<Acc>&, bool);                              \
+    template void matVec<T, Acc>(const BasicMatrixView<const T>&,                               \
+                                 const BasicMatrixView<const T>&, const BasicMatrixView<Acc>&,  \
+                                 ThreadPool*, int);                                             \
+    template void vecMat<T, Acc>(const BasicMatrixView<const T>&,                               \
+                                 const BasicMatrixView<const T>&, const BasicMatrixView<Acc>&,  \
+                                 ThreadPool*, int);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_GEMV)
+#undef INSTANTIATE_GEMV
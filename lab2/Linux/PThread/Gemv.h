@@ -0,0 +1,40 @@
+#ifndef GEMV_H
+#define GEMV_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// Matrix-vector products. Unlike gemm() they do one multiply-add per element
+// of A, so they are bound by the bandwidth of reading A: the kernels stream A
+// exactly once, straight from its rows, and apply every vector of a batch to
+// a block of rows while it is still in L2.
+// Vectors of a batch are the rows of X (and of the result Y), so one vector is
+// a 1 x n view. int32 products use the dispatched SIMD kernels (see
+// SimdKernels.h); other types a portable loop.
+// Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+
+// Row v of Y = A * row v of X, or += when accumulate is set.
+// A is M x K, X is R x K, Y is R x M; Y must not overlap A or X.
+template <typename T, typename Acc>
+void gemv(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& X,
+          const BasicMatrixView<Acc>& Y, bool accumulate = false);
+
+// Row v of Y = row v of X * A, or += when accumulate is set.
+// X is R x M, A is M x K, Y is R x K; Y must not overlap A or X.
+template <typename T, typename Acc>
+void gevm(const BasicMatrixView<const T>& X, const BasicMatrixView<const T>& A,
+          const BasicMatrixView<Acc>& Y, bool accumulate = false);
+
+// The same on up to `workers` pool threads (0: the whole pool), inline without
+// a pool. Both split the rows of A: matVec() gives each chunk its own
+// elements of Y, vecMat() has every worker sum its chunks into a private Y
+// and adds those up at the end. Y is overwritten.
+template <typename T, typename Acc>
+void matVec(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& X,
+            const BasicMatrixView<Acc>& Y, ThreadPool* pool = nullptr, int workers = 0);
+
+template <typename T, typename Acc>
+void vecMat(const BasicMatrixView<const T>& X, const BasicMatrixView<const T>& A,
+            const BasicMatrixView<Acc>& Y, ThreadPool* pool = nullptr, int workers = 0);
+
+#endif // GEMV_H
@@ -1,4 +1,7 @@
 ﻿#include "Matrix.h"
+#include "Gemm.h"
+#include "Strassen.h"
+#include "MatrixUtils.h"
 #include <iostream>
 #include <iomanip>
 #include <random>
@@ -7,61 +10,165 @@
 #include <cstdlib>  
 #include <ctime> 
 
-Matrix::Matrix() : rows(0), cols(0) {}
+template <typename T>
+BasicMatrix<T>::BasicMatrix() : rows(0), cols(0), stride(0) {}
 
-Matrix::Matrix(int r, int c) : rows(r), cols(c) {
+template <typename T>
+BasicMatrix<T>::BasicMatrix(int r, int c) : rows(r), cols(c), stride(0) {
     if (r < 0 || c < 0) {
         throw std::invalid_argument("Matrix dimensions must be non-negative");
     }
-    data.resize(r, std::vector<int>(c, 0));
+    stride = strideFor(c);
+    data.assign(static_cast<size_t>(r) * stride, T(0));
 }
 
-Matrix::Matrix(const std::vector<std::vector<int>>& d) : data(d) {
+template <typename T>
+BasicMatrix<T>::BasicMatrix(const std::vector<std::vector<T>>& d) : rows(0), cols(0), stride(0) {
     rows = d.size();
     if (rows > 0) {
         cols = d[0].size();
-        for (const auto& row : data) {
+        for (const auto& row : d) {
             if (row.size() != cols) {
                 throw std::invalid_argument("All matrix rows must have equal length");
             }
         }
     }
-    else {
-        cols = 0;
+    stride = strideFor(cols);
+    data.assign(static_cast<size_t>(rows) * stride, T(0));
+    for (int i = 0; i < rows; i++) {
+        std::copy(d[i].begin(), d[i].end(), rowPtr(i));
+    }
+}
+
+template <typename T>
+BasicMatrix<T> BasicMatrix<T>::uninitialized(int r, int c) {
+    if (r < 0 || c < 0) {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+    BasicMatrix result;
+    result.rows = r;
+    result.cols = c;
+    result.stride = strideFor(c);
+    result.data.resize(static_cast<size_t>(r) * result.stride);
+    return result;
+}
+
+template <typename T>
+void BasicMatrix<T>::zeroRows(int begin, int end) {
+    if (begin < 0 || end > rows || begin > end) {
+        throw std::out_of_range("Matrix rows out of bounds");
     }
+    std::fill(rowPtr(begin), rowPtr(end), T(0));
 }
 
-int Matrix::getRows() const { return rows; }
+// Rows start on a cache line. Strides that are a multiple of 4 KB get one
+// extra line so that walking down a column does not hit the same cache set every row.
+template <typename T>
+int BasicMatrix<T>::strideFor(int c) {
+    const int lineElems = static_cast<int>(64 / sizeof(T));
+    int s = (c + lineElems - 1) / lineElems * lineElems;
+    if (s > 0 && (static_cast<size_t>(s) * sizeof(T)) % 4096 == 0) {
+        s += lineElems;
+    }
+    return s;
+}
+
+template <typename T>
+int BasicMatrix<T>::getRows() const { return rows; }
+
+template <typename T>
+int BasicMatrix<T>::getCols() const { return cols; }
 
-int Matrix::getCols() const { return cols; }
+template <typename T>
+int BasicMatrix<T>::getStride() const { return stride; }
 
-int& Matrix::operator()(int i, int j) {
+template <typename T>
+T& BasicMatrix<T>::operator()(int i, int j) {
     if (i < 0 || i >= rows || j < 0 || j >= cols) {
         throw std::out_of_range("Matrix index out of bounds");
     }
-    return data[i][j];
+    return rowPtr(i)[j];
 }
 
-const int& Matrix::operator()(int i, int j) const {
+template <typename T>
+const T& BasicMatrix<T>::operator()(int i, int j) const {
     if (i < 0 || i >= rows || j < 0 || j >= cols) {
         throw std::out_of_range("Matrix index out of bounds");
     }
-    return data[i][j];
+    return rowPtr(i)[j];
+}
+
+template <typename T>
+BasicMatrixView<T> BasicMatrix<T>::view() {
+    return BasicMatrixView<T>(data.data(), rows, cols, stride);
+}
+
+template <typename T>
+BasicMatrixView<const T> BasicMatrix<T>::view() const {
+    return BasicMatrixView<const T>(data.data(), rows, cols, stride);
+}
+
+template <typename T>
+BasicMatrixView<T> BasicMatrix<T>::block(int r, int c, int nr, int nc) {
+    if (r < 0 || c < 0 || nr < 0 || nc < 0 || r + nr > rows || c + nc > cols) {
+        throw std::out_of_range("Matrix block out of bounds");
+    }
+    return view().block(r, c, nr, nc);
+}
+
+template <typename T>
+BasicMatrixView<const T> BasicMatrix<T>::block(int r, int c, int nr, int nc) const {
+    if (r < 0 || c < 0 || nr < 0 || nc < 0 || r + nr > rows || c + nc > cols) {
+        throw std::out_of_range("Matrix block out of bounds");
+    }
+    return view().block(r, c, nr, nc);
+}
+
+template <typename T>
+BasicMatrixView<T> BasicMatrix<T>::rowRange(int begin, int end) {
+    return block(begin, 0, end - begin, cols);
+}
+
+template <typename T>
+BasicMatrixView<const T> BasicMatrix<T>::rowRange(int begin, int end) const {
+    return block(begin, 0, end - begin, cols);
 }
 
-void Matrix::randomFill(int min, int max) {
+template <typename T>
+void BasicMatrix<T>::randomFill(T min, T max) {
+    static std::random_device rd;
+    std::uint64_t seed = static_cast<std::uint64_t>(rd()) << 32 | rd();
+    randomFill(min, max, seed);
+}
+
+template <typename T>
+void BasicMatrix<T>::randomFill(T min, T max, std::uint64_t seed, ThreadPool* pool) {
+    ::randomFill<T>(view(), min, max, seed, pool);
+}
+
+template <typename T>
+void BasicMatrix<T>::randomSparseFill(double density, T min, T max) {
+    if (density < 0.0 || density > 1.0) {
+        throw std::invalid_argument("Density must be in [0, 1]");
+    }
+
     static std::random_device rd;
     static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(min, max);
+    std::bernoulli_distribution nonzero(density);
+    typename std::conditional<std::is_integral<T>::value,
+                              std::uniform_int_distribution<long long>,
+                              std::uniform_real_distribution<T>>::type distrib(min, max);
 
     for (int i = 0; i < rows; i++) {
+        T* row = rowPtr(i);
         for (int j = 0; j < cols; j++) {
-            data[i][j] = distrib(gen);
+            row[j] = nonzero(gen) ? static_cast<T>(distrib(gen)) : T(0);
         }
     }
 }
 
-void Matrix::print(const std::string& name, int limit) const {
+template <typename T>
+void BasicMatrix<T>::print(const std::string& name, int limit) const {
     if (!name.empty()) {
         std::cout << name << " (" << rows << "x" << cols << "):\n";
     }
@@ -71,7 +178,8 @@ void Matrix::print(const std::string& name, int limit) const {
 
     for (int i = 0; i < displayRows; i++) {
         for (int j = 0; j < displayCols; j++) {
-            std::cout << std::setw(4) << data[i][j];
+            // Unary + prints int8_t as a number rather than a character
+            std::cout << std::setw(4) << +rowPtr(i)[j];
         }
         if (displayCols < cols) std::cout << " ...";
         std::cout << std::endl;
@@ -79,38 +187,64 @@ void Matrix::print(const std::string& name, int limit) const {
     if (displayRows < rows) std::cout << "...\n";
 }
 
-bool Matrix::equals(const Matrix& other) const {
-    if (rows != other.rows || cols != other.cols) return false;
-
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            if (data[i][j] != other(i, j)) return false;
-        }
-    }
-    return true;
+template <typename T>
+bool BasicMatrix<T>::equals(const BasicMatrix& other, ThreadPool* pool) const {
+    return matricesEqual<T>(view(), other.view(), pool);
 }
 
 // Complexity: O(M × N × K) where M=rows of A, K=cols of A/rows of B, N=cols of B
-Matrix Matrix::sequentialMultiply(const Matrix& A, const Matrix& B) {
+template <typename T>
+template <typename Acc>
+BasicMatrix<Acc> BasicMatrix<T>::sequentialMultiply(const BasicMatrix& A, const BasicMatrix& B) {
     if (A.cols != B.rows) {
         throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
     }
 
-    int M = A.rows;
-    int K = A.cols;  // Must equal B.rows
-    int N = B.cols;
+    BasicMatrix<Acc> result(A.rows, B.cols);
 
-    Matrix result(M, N);
+    // Packed, register-blocked kernel (see Gemm.h)
+    gemm<T, Acc>(A.view(), B.view(), result.view());
 
-    for (int i = 0; i < M; i++) {
-        for (int j = 0; j < N; j++) {
-            int sum = 0;
-            for (int k = 0; k < K; k++) {
-                sum += A(i, k) * B(k, j);
-            }
-            result(i, j) = sum;
-        }
+    return result;
+}
+
+template <typename T>
+template <typename Acc>
+bool BasicMatrix<T>::verifyProduct(const BasicMatrix& A, const BasicMatrix& B,
+                                   const BasicMatrix<Acc>& C, double errorBound, ThreadPool* pool) {
+    if (A.cols != B.rows) {
+        throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
+    }
+
+    static std::random_device rd;
+    std::uint64_t seed = static_cast<std::uint64_t>(rd()) << 32 | rd();
+    return freivaldsVerify<T, Acc>(A.view(), B.view(), C.view(), errorBound, seed, pool).passed;
+}
+
+template <typename T>
+template <typename Acc>
+BasicMatrix<Acc> BasicMatrix<T>::strassenMultiply(const BasicMatrix& A, const BasicMatrix& B,
+                                                  int cutoff) {
+    if (A.cols != B.rows) {
+        throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
     }
 
+    BasicMatrix<Acc> wideA, wideB;
+    BasicMatrix<Acc> result(A.rows, B.cols);
+    ::strassenMultiply<Acc>(widened(A, wideA), widened(B, wideB), result.view(), cutoff);
     return result;
-}
\ No newline at end of file
+}
+
+#define INSTANTIATE_MATRIX(T) template class BasicMatrix<T>;
+MATRIX_ELEMENT_TYPES(INSTANTIATE_MATRIX)
+#undef INSTANTIATE_MATRIX
+
+#define INSTANTIATE_MATRIX_PRODUCT(T, Acc)                                                   \
+    template BasicMatrix<Acc> BasicMatrix<T>::sequentialMultiply<Acc>(const BasicMatrix<T>&, \
+                                                                      const BasicMatrix<T>&); \
+    template BasicMatrix<Acc> BasicMatrix<T>::strassenMultiply<Acc>(const BasicMatrix<T>&,   \
+                                                                    const BasicMatrix<T>&, int); \
+    template bool BasicMatrix<T>::verifyProduct<Acc>(const BasicMatrix<T>&, const BasicMatrix<T>&, \
+                                                     const BasicMatrix<Acc>&, double, ThreadPool*);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_MATRIX_PRODUCT)
+#undef INSTANTIATE_MATRIX_PRODUCT
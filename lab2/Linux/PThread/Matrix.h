@@ -1,33 +1,190 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include "AlignedAllocator.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include <string>
 
-class Matrix {
+class ThreadPool;
+
+// Element types BasicMatrix is compiled for (explicit instantiations in the .cpp files)
+#define MATRIX_ELEMENT_TYPES(X) \
+    X(std::int8_t)              \
+    X(std::int16_t)             \
+    X(std::int32_t)             \
+    X(std::int64_t)             \
+    X(float)                    \
+    X(double)
+
+// (element, accumulator) pairs the multiply routines are compiled for
+#define MATRIX_PRODUCT_TYPES(X)        \
+    X(std::int8_t, std::int32_t)       \
+    X(std::int16_t, std::int32_t)      \
+    X(std::int32_t, std::int32_t)      \
+    X(std::int32_t, std::int64_t)      \
+    X(std::int64_t, std::int64_t)      \
+    X(float, float)                    \
+    X(float, double)                   \
+    X(double, double)
+
+// Strassen sub-problems with any dimension at or below this go straight to
+// gemm(); shared by every Strassen entry point (see Strassen.h)
+const int STRASSEN_DEFAULT_CUTOFF = 512;
+
+// Default accumulator of a product of T. Narrow integers widen to int32;
+// everything else keeps its own type (pass int64_t explicitly for int32 data
+// whose products may overflow).
+template <typename T>
+struct AccumulatorTraits {
+    typedef T type;
+};
+
+template <>
+struct AccumulatorTraits<std::int8_t> {
+    typedef std::int32_t type;
+};
+
+template <>
+struct AccumulatorTraits<std::int16_t> {
+    typedef std::int32_t type;
+};
+
+// Non-owning window into row-major storage: element (i, j) is data[i * stride + j].
+// No bounds checks, meant for inner loops. BasicMatrixView<const T> is the
+// read-only form; a writable view converts to it implicitly.
+template <typename T>
+class BasicMatrixView {
+public:
+    T* data;
+    int rows;
+    int cols;
+    int stride;
+
+    BasicMatrixView() : data(nullptr), rows(0), cols(0), stride(0) {}
+    BasicMatrixView(T* d, int r, int c, int s) : data(d), rows(r), cols(c), stride(s) {}
+
+    template <typename U>
+    BasicMatrixView(const BasicMatrixView<U>& v,
+                    typename std::enable_if<std::is_convertible<U*, T*>::value>::type* = nullptr)
+        : data(v.data), rows(v.rows), cols(v.cols), stride(v.stride) {}
+
+    T* rowPtr(int i) const { return data + static_cast<std::size_t>(i) * stride; }
+    T& operator()(int i, int j) const { return rowPtr(i)[j]; }
+
+    // Sub-matrix of nr x nc elements starting at (r, c)
+    BasicMatrixView block(int r, int c, int nr, int nc) const {
+        return BasicMatrixView(rowPtr(r) + c, nr, nc, stride);
+    }
+
+    // Rows [begin, end)
+    BasicMatrixView rowRange(int begin, int end) const {
+        return BasicMatrixView(rowPtr(begin), end - begin, cols, stride);
+    }
+};
+
+template <typename T>
+class BasicMatrix {
 private:
-    std::vector<std::vector<int>> data;
+    // One contiguous, cache-line aligned row-major buffer of rows * stride elements.
+    // Columns [cols, stride) are padding and always hold zero.
+    std::vector<T, AlignedAllocator<T, 64>> data;
     int rows;
     int cols;
+    int stride;
 
 public:
-    Matrix();
-    Matrix(int r, int c);
-    Matrix(const std::vector<std::vector<int>>& d);
+    typedef T value_type;
+
+    BasicMatrix();
+    BasicMatrix(int r, int c);
+    BasicMatrix(const std::vector<std::vector<T>>& d);
+
+    // r x c matrix whose memory is allocated but not written, padding included.
+    // Every row must go through zeroRows() or be fully overwritten before use;
+    // doing that from the threads that will work on the rows places their pages
+    // on those threads' NUMA nodes (first touch).
+    static BasicMatrix uninitialized(int r, int c);
+
+    // Sets rows [begin, end) to zero, padding included
+    void zeroRows(int begin, int end);
 
     int getRows() const;
     int getCols() const;
 
+    // Distance in elements between the starts of two consecutive rows
+    int getStride() const;
+
+    // Stride a matrix with c columns gets
+    static int strideFor(int c);
+
     // Access element at position (i,j) for modification
-    int& operator()(int i, int j);
+    T& operator()(int i, int j);
 
     // Access element at position (i,j) for reading only
-    const int& operator()(int i, int j) const;
+    const T& operator()(int i, int j) const;
 
-    void randomFill(int min = 1, int max = 10);
+    // Raw pointer to the first element of row i (unchecked)
+    T* rowPtr(int i) { return data.data() + static_cast<std::size_t>(i) * stride; }
+    const T* rowPtr(int i) const { return data.data() + static_cast<std::size_t>(i) * stride; }
+
+    BasicMatrixView<T> view();
+    BasicMatrixView<const T> view() const;
+    BasicMatrixView<T> block(int r, int c, int nr, int nc);
+    BasicMatrixView<const T> block(int r, int c, int nr, int nc) const;
+    BasicMatrixView<T> rowRange(int begin, int end);
+    BasicMatrixView<const T> rowRange(int begin, int end) const;
+
+    // Element-wise conversion to another element type
+    template <typename U>
+    BasicMatrix<U> convert() const {
+        BasicMatrix<U> result(rows, cols);
+        for (int i = 0; i < rows; i++) {
+            const T* src = rowPtr(i);
+            U* dst = result.rowPtr(i);
+            for (int j = 0; j < cols; j++) {
+                dst[j] = static_cast<U>(src[j]);
+            }
+        }
+        return result;
+    }
+
+    // Fresh seed on every call
+    void randomFill(T min = T(1), T max = T(10));
+    
+    // Reproducible: the same seed gives the same matrix for any pool size
+    // (counter-based generator, see MatrixUtils.h)
+    void randomFill(T min, T max, std::uint64_t seed, ThreadPool* pool = nullptr);
+
+    // Each element is nonzero with probability `density`, drawn from [min, max]
+    void randomSparseFill(double density, T min = T(1), T max = T(10));
     void print(const std::string& name = "", int limit = 6) const;
-    bool equals(const Matrix& other) const;
-    static Matrix sequentialMultiply(const Matrix& A, const Matrix& B);
+    // Rows compared in parallel on the pool (if any), stopping at the first difference
+    bool equals(const BasicMatrix& other, ThreadPool* pool = nullptr) const;
+
+    // Products are accumulated (and returned) in Acc, e.g. int8 x int8 -> int32
+    template <typename Acc = typename AccumulatorTraits<T>::type>
+    static BasicMatrix<Acc> sequentialMultiply(const BasicMatrix& A, const BasicMatrix& B);
+
+    // Whether C == A * B, by Freivalds' randomized check with a fresh seed
+    // (see freivaldsVerify in MatrixUtils.h): O(n^2) per round instead of the
+    // O(n^3) of recomputing the product. A wrong C is accepted with probability
+    // at most errorBound.
+    template <typename Acc = typename AccumulatorTraits<T>::type>
+    static bool verifyProduct(const BasicMatrix& A, const BasicMatrix& B, const BasicMatrix<Acc>& C,
+                              double errorBound = 1e-9, ThreadPool* pool = nullptr);
+
+    // Strassen-Winograd recursion down to `cutoff`, single-threaded (see Strassen.h).
+    // Narrow inputs are widened to Acc first, since the recursion adds operands.
+    template <typename Acc = typename AccumulatorTraits<T>::type>
+    static BasicMatrix<Acc> strassenMultiply(const BasicMatrix& A, const BasicMatrix& B,
+                                             int cutoff = STRASSEN_DEFAULT_CUTOFF);
 };
 
-#endif // MATRIX_H
\ No newline at end of file
+typedef BasicMatrix<int> Matrix;
+typedef BasicMatrixView<int> MatrixView;
+typedef BasicMatrixView<const int> ConstMatrixView;
+
+#endif // MATRIX_H
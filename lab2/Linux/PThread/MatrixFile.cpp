@@ -0,0 +1,347 @@
+#include "MatrixFile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+static const char MATRIX_FILE_MAGIC[8] = { 'M', 'A', 'T', 'R', 'I', 'X', 'F', '\0' };
+static const std::uint32_t MATRIX_FILE_ALIGNMENT = 64;
+
+static std::runtime_error fileError(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+}
+
+static bool hostIsLittleEndian() {
+    const std::uint16_t probe = 1;
+    return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+}
+
+static std::uint64_t pageSize() {
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? static_cast<std::uint64_t>(size) : 4096;
+}
+
+const char* matrixDTypeName(MatrixDType dtype) {
+    switch (dtype) {
+        case MatrixDType::Int8: return "int8";
+        case MatrixDType::Int16: return "int16";
+        case MatrixDType::Int32: return "int32";
+        case MatrixDType::Int64: return "int64";
+        case MatrixDType::Float32: return "float32";
+        case MatrixDType::Float64: return "float64";
+    }
+    return "unknown";
+}
+
+template <typename T>
+static MatrixFileHeader makeHeader(int rows, int cols) {
+    MatrixFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC));
+    header.version = MATRIX_FILE_VERSION;
+    header.dtype = static_cast<std::uint32_t>(MatrixDTypeOf<T>::value);
+    header.elementSize = sizeof(T);
+    header.alignment = MATRIX_FILE_ALIGNMENT;
+    header.rows = rows;
+    header.cols = cols;
+    header.stride = BasicMatrix<T>::strideFor(cols);
+    header.dataOffset = pageSize();
+    return header;
+}
+
+template <typename T>
+static void checkDType(const MatrixFileHeader& header, const std::string& path) {
+    if (header.dtype != static_cast<std::uint32_t>(MatrixDTypeOf<T>::value) ||
+        header.elementSize != sizeof(T)) {
+        throw std::runtime_error("Matrix file '" + path + "' holds " +
+                                 matrixDTypeName(static_cast<MatrixDType>(header.dtype)) +
+                                 ", expected " + matrixDTypeName(MatrixDTypeOf<T>::value));
+    }
+}
+
+static void validateHeader(const MatrixFileHeader& h, const std::string& path) {
+    if (std::memcmp(h.magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC)) != 0) {
+        throw std::runtime_error("Not a matrix file: '" + path + "'");
+    }
+    if (h.version != MATRIX_FILE_VERSION) {
+        throw std::runtime_error("Unsupported matrix file version in '" + path + "'");
+    }
+    if (h.rows < 0 || h.cols < 0 || h.stride < h.cols || h.elementSize == 0 ||
+        h.rows > INT32_MAX || h.stride > INT32_MAX || h.dataOffset < sizeof(MatrixFileHeader)) {
+        throw std::runtime_error("Corrupt matrix file header in '" + path + "'");
+    }
+    if (h.dataOffset % pageSize() != 0 || h.alignment == 0 || h.alignment % h.elementSize != 0 ||
+        static_cast<std::uint64_t>(h.stride) * h.elementSize % h.alignment != 0) {
+        throw std::runtime_error("Misaligned matrix file layout in '" + path + "'");
+    }
+}
+
+MatrixFileHeader readMatrixFileHeader(const std::string& path) {
+    if (!hostIsLittleEndian()) {
+        throw std::runtime_error("Matrix files are only supported on little-endian hosts");
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw fileError("Cannot open", path);
+    }
+
+    MatrixFileHeader header;
+    ssize_t got = pread(fd, &header, sizeof(header), 0);
+    ::close(fd);
+    if (got != static_cast<ssize_t>(sizeof(header))) {
+        throw std::runtime_error("Truncated matrix file header in '" + path + "'");
+    }
+
+    validateHeader(header, path);
+    return header;
+}
+
+template <typename T>
+MappedMatrix<T>::MappedMatrix(const std::string& path) : mapping(nullptr), mappingSize(0) {
+    header = readMatrixFileHeader(path);
+    checkDType<T>(header, path);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw fileError("Cannot open", path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw fileError("Cannot stat", path);
+    }
+
+    std::uint64_t dataBytes = static_cast<std::uint64_t>(header.rows) * header.stride * sizeof(T);
+    mappingSize = static_cast<std::size_t>(header.dataOffset + dataBytes);
+    if (static_cast<std::uint64_t>(st.st_size) < mappingSize) {
+        ::close(fd);
+        throw std::runtime_error("Matrix file '" + path + "' is shorter than its header says");
+    }
+
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw fileError("Cannot map", path);
+    }
+}
+
+template <typename T>
+MappedMatrix<T>::~MappedMatrix() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+template <typename T>
+BasicMatrixView<const T> MappedMatrix<T>::view() const {
+    const char* base = static_cast<const char*>(mapping) + header.dataOffset;
+    const T* data = reinterpret_cast<const T*>(base);
+    return BasicMatrixView<const T>(data, getRows(), getCols(), getStride());
+}
+
+template <typename T>
+void MappedMatrix<T>::prefetch() const {
+    madvise(mapping, mappingSize, MADV_WILLNEED);
+}
+
+template <typename T>
+MatrixFileWriter<T>::MatrixFileWriter(const std::string& p, int rows, int cols)
+    : file(nullptr), path(p), rowsWritten(0) {
+    if (rows < 0 || cols < 0) {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+    if (!hostIsLittleEndian()) {
+        throw std::runtime_error("Matrix files are only supported on little-endian hosts");
+    }
+
+    header = makeHeader<T>(rows, cols);
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw fileError("Cannot create", path);
+    }
+
+    std::vector<char> head(header.dataOffset, 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    if (std::fwrite(head.data(), 1, head.size(), file) != head.size()) {
+        std::fclose(file);
+        file = nullptr;
+        std::remove(path.c_str());
+        throw fileError("Cannot write", path);
+    }
+}
+
+template <typename T>
+MatrixFileWriter<T>::~MatrixFileWriter() {
+    if (file) {
+        std::fclose(file);
+        std::remove(path.c_str());
+    }
+}
+
+template <typename T>
+void MatrixFileWriter<T>::writeRows(const BasicMatrixView<const T>& rows) {
+    if (!file) {
+        throw std::logic_error("Matrix file writer is closed");
+    }
+    if (rows.cols != header.cols || rowsWritten + rows.rows > header.rows) {
+        throw std::invalid_argument("Rows do not fit the matrix file shape");
+    }
+
+    std::vector<T> line(static_cast<std::size_t>(header.stride), T(0));
+    for (int i = 0; i < rows.rows; ++i) {
+        std::copy(rows.rowPtr(i), rows.rowPtr(i) + rows.cols, line.begin());
+        if (std::fwrite(line.data(), sizeof(T), line.size(), file) != line.size()) {
+            throw fileError("Cannot write", path);
+        }
+    }
+    rowsWritten += rows.rows;
+}
+
+template <typename T>
+void MatrixFileWriter<T>::close() {
+    if (!file) {
+        return;
+    }
+    if (rowsWritten != header.rows) {
+        throw std::logic_error("Matrix file '" + path + "' closed before all rows were written");
+    }
+
+    int failed = std::fclose(file);
+    file = nullptr;
+    if (failed != 0) {
+        throw fileError("Cannot write", path);
+    }
+}
+
+template <typename T>
+MatrixFileBlocks<T>::MatrixFileBlocks(int f, const std::string& p, const MatrixFileHeader& h)
+    : fd(f), path(p), header(h) {}
+
+template <typename T>
+MatrixFileBlocks<T>::MatrixFileBlocks(MatrixFileBlocks&& other)
+    : fd(other.fd), path(std::move(other.path)), header(other.header) {
+    other.fd = -1;
+}
+
+template <typename T>
+off_t MatrixFileBlocks<T>::offsetOf(int row, int col) const {
+    return static_cast<off_t>(header.dataOffset +
+                              (static_cast<std::uint64_t>(row) * header.stride + col) * sizeof(T));
+}
+
+template <typename T>
+MatrixFileBlocks<T>::~MatrixFileBlocks() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+template <typename T>
+MatrixFileBlocks<T> MatrixFileBlocks<T>::open(const std::string& path, bool writable) {
+    MatrixFileHeader header = readMatrixFileHeader(path);
+    checkDType<T>(header, path);
+
+    int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        throw fileError("Cannot open", path);
+    }
+    return MatrixFileBlocks(fd, path, header);
+}
+
+template <typename T>
+MatrixFileBlocks<T> MatrixFileBlocks<T>::create(const std::string& path, int rows, int cols) {
+    if (rows < 0 || cols < 0) {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+    if (!hostIsLittleEndian()) {
+        throw std::runtime_error("Matrix files are only supported on little-endian hosts");
+    }
+
+    MatrixFileHeader header = makeHeader<T>(rows, cols);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw fileError("Cannot create", path);
+    }
+
+    // ftruncate leaves the data region as a hole that reads back as zeros
+    off_t size = static_cast<off_t>(header.dataOffset +
+                                    static_cast<std::uint64_t>(rows) * header.stride * sizeof(T));
+    if (pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        ftruncate(fd, size) != 0) {
+        std::runtime_error error = fileError("Cannot write", path);
+        ::close(fd);
+        std::remove(path.c_str());
+        throw error;
+    }
+    return MatrixFileBlocks(fd, path, header);
+}
+
+template <typename T>
+void MatrixFileBlocks<T>::readBlock(int row, int col, const BasicMatrixView<T>& dst) const {
+    if (row < 0 || col < 0 || row + dst.rows > header.rows || col + dst.cols > header.cols) {
+        throw std::out_of_range("Matrix file block out of bounds");
+    }
+
+    size_t bytes = static_cast<size_t>(dst.cols) * sizeof(T);
+    for (int i = 0; i < dst.rows; ++i) {
+        if (pread(fd, dst.rowPtr(i), bytes, offsetOf(row + i, col)) != static_cast<ssize_t>(bytes)) {
+            throw fileError("Cannot read", path);
+        }
+    }
+}
+
+template <typename T>
+void MatrixFileBlocks<T>::writeBlock(int row, int col, const BasicMatrixView<const T>& src) {
+    if (row < 0 || col < 0 || row + src.rows > header.rows || col + src.cols > header.cols) {
+        throw std::out_of_range("Matrix file block out of bounds");
+    }
+
+    size_t bytes = static_cast<size_t>(src.cols) * sizeof(T);
+    for (int i = 0; i < src.rows; ++i) {
+        if (pwrite(fd, src.rowPtr(i), bytes, offsetOf(row + i, col)) != static_cast<ssize_t>(bytes)) {
+            throw fileError("Cannot write", path);
+        }
+    }
+}
+
+template <typename T>
+void MatrixFileBlocks<T>::adviseRows(int begin, int end) const {
+    posix_fadvise(fd, offsetOf(begin, 0), offsetOf(end, 0) - offsetOf(begin, 0), POSIX_FADV_WILLNEED);
+}
+
+template <typename T>
+void saveMatrix(const std::string& path, const BasicMatrix<T>& M) {
+    MatrixFileWriter<T> writer(path, M.getRows(), M.getCols());
+    writer.writeRows(M.view());
+    writer.close();
+}
+
+template <typename T>
+BasicMatrix<T> loadMatrix(const std::string& path) {
+    MappedMatrix<T> mapped(path);
+    BasicMatrixView<const T> src = mapped.view();
+    BasicMatrix<T> result(src.rows, src.cols);
+    for (int i = 0; i < src.rows; ++i) {
+        std::copy(src.rowPtr(i), src.rowPtr(i) + src.cols, result.rowPtr(i));
+    }
+    return result;
+}
+
+#define INSTANTIATE_MATRIX_FILE(T)                                                 \
+    template class MappedMatrix<T>;                                                \
+    template class MatrixFileWriter<T>;                                            \
+    template class MatrixFileBlocks<T>;                                            \
+    template void saveMatrix<T>(const std::string&, const BasicMatrix<T>&);        \
+    template BasicMatrix<T> loadMatrix<T>(const std::string&);
+MATRIX_ELEMENT_TYPES(INSTANTIATE_MATRIX_FILE)
+#undef INSTANTIATE_MATRIX_FILE
@@ -0,0 +1,153 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include "Matrix.h"
+#include <cstdint>
+#include <cstdio>
+#include <sys/types.h>
+#include <string>
+
+// Binary matrix file: a fixed header followed, at dataOffset, by rows * stride
+// elements in row-major order. dataOffset is a multiple of the page size and
+// stride * elementSize a multiple of `alignment`; files that break either rule
+// are rejected on open. Files written here use BasicMatrix<T>::strideFor() and
+// a 64-byte alignment, so a mapping of one has the same layout as BasicMatrix
+// and every row starts on a cache line.
+// All fields are little-endian; the padding columns hold zero.
+enum class MatrixDType : std::uint32_t {
+    Int8 = 1,
+    Int16 = 2,
+    Int32 = 3,
+    Int64 = 4,
+    Float32 = 5,
+    Float64 = 6
+};
+
+template <typename T> struct MatrixDTypeOf;
+#define MATRIX_DTYPE_OF(T, code) \
+    template <> struct MatrixDTypeOf<T> { static const MatrixDType value = MatrixDType::code; };
+MATRIX_DTYPE_OF(std::int8_t, Int8)
+MATRIX_DTYPE_OF(std::int16_t, Int16)
+MATRIX_DTYPE_OF(std::int32_t, Int32)
+MATRIX_DTYPE_OF(std::int64_t, Int64)
+MATRIX_DTYPE_OF(float, Float32)
+MATRIX_DTYPE_OF(double, Float64)
+#undef MATRIX_DTYPE_OF
+
+const char* matrixDTypeName(MatrixDType dtype);
+
+struct MatrixFileHeader {
+    char magic[8];              // "MATRIXF\0"
+    std::uint32_t version;      // MATRIX_FILE_VERSION
+    std::uint32_t dtype;        // MatrixDType
+    std::uint32_t elementSize;  // bytes per element
+    std::uint32_t alignment;    // row alignment in bytes
+    std::int64_t rows;
+    std::int64_t cols;
+    std::int64_t stride;        // elements between the starts of two rows
+    std::uint64_t dataOffset;   // byte offset of row 0
+};
+
+const std::uint32_t MATRIX_FILE_VERSION = 1;
+
+// Reads and validates the header of `path`; throws std::runtime_error on failure
+MatrixFileHeader readMatrixFileHeader(const std::string& path);
+
+// Read-only memory mapping of a matrix file. Opening costs one mmap() call;
+// the data is paged in on first touch. The file must hold elements of type T.
+template <typename T>
+class MappedMatrix {
+private:
+    void* mapping;
+    std::size_t mappingSize;
+    MatrixFileHeader header;
+
+public:
+    explicit MappedMatrix(const std::string& path);
+    ~MappedMatrix();
+
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+    int getRows() const { return static_cast<int>(header.rows); }
+    int getCols() const { return static_cast<int>(header.cols); }
+    int getStride() const { return static_cast<int>(header.stride); }
+
+    // Zero-copy view of the mapped elements, valid while this object lives
+    BasicMatrixView<const T> view() const;
+
+    // Hints that the whole matrix will be read front to back soon
+    void prefetch() const;
+};
+
+// Writes a matrix file row by row, so a result can be streamed out while it is
+// produced. close() checks that every row was written; a writer destroyed
+// before that removes its incomplete file.
+template <typename T>
+class MatrixFileWriter {
+private:
+    std::FILE* file;
+    std::string path;
+    MatrixFileHeader header;
+    std::int64_t rowsWritten;
+
+public:
+    MatrixFileWriter(const std::string& path, int rows, int cols);
+    ~MatrixFileWriter();
+
+    MatrixFileWriter(const MatrixFileWriter&) = delete;
+    MatrixFileWriter& operator=(const MatrixFileWriter&) = delete;
+
+    // Appends the rows of `rows` (whose column count must match the file)
+    void writeRows(const BasicMatrixView<const T>& rows);
+    void close();
+};
+
+// Random access to rectangular blocks of a matrix file through pread/pwrite,
+// for files too large to hold (or map) at once. Thread-safe as long as
+// concurrent writes go to disjoint blocks.
+template <typename T>
+class MatrixFileBlocks {
+private:
+    int fd;
+    std::string path;
+    MatrixFileHeader header;
+
+    MatrixFileBlocks(int fd, const std::string& path, const MatrixFileHeader& header);
+
+    // Byte offset of element (row, col)
+    off_t offsetOf(int row, int col) const;
+
+public:
+    // Opens an existing file of element type T
+    static MatrixFileBlocks open(const std::string& path, bool writable = false);
+
+    // Creates (or truncates) a zero-filled rows x cols file
+    static MatrixFileBlocks create(const std::string& path, int rows, int cols);
+
+    MatrixFileBlocks(MatrixFileBlocks&& other);
+    ~MatrixFileBlocks();
+
+    MatrixFileBlocks(const MatrixFileBlocks&) = delete;
+    MatrixFileBlocks& operator=(const MatrixFileBlocks&) = delete;
+
+    int getRows() const { return static_cast<int>(header.rows); }
+    int getCols() const { return static_cast<int>(header.cols); }
+
+    // Copies the dst.rows x dst.cols block starting at (row, col) into dst
+    void readBlock(int row, int col, const BasicMatrixView<T>& dst) const;
+
+    // Stores src at (row, col)
+    void writeBlock(int row, int col, const BasicMatrixView<const T>& src);
+
+    // Hints that rows [begin, end) will be read soon
+    void adviseRows(int begin, int end) const;
+};
+
+// Whole-matrix convenience wrappers
+template <typename T>
+void saveMatrix(const std::string& path, const BasicMatrix<T>& M);
+template <typename T>
+BasicMatrix<T> loadMatrix(const std::string& path);
+
+#endif // MATRIX_FILE_H
@@ -0,0 +1,296 @@
+#include "MatrixGraph.h"
+#include "TaskGraph.h"
+#include "Gemm.h"
+#include <pthread.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+template <typename T>
+BasicMatrixGraph<T>::BasicMatrixGraph(int tile)
+    : tileSize(tile), lastTileSize(0), lastTaskCount(0), lastPeakBytes(0) {
+    if (tile < 0) {
+        throw std::invalid_argument("Tile size must not be negative");
+    }
+}
+
+template <typename T>
+int BasicMatrixGraph<T>::addNode(Op op, int left, int right, const BasicMatrix<T>* input,
+                                 int rows, int cols) {
+    Node n;
+    n.op = op;
+    n.left = left;
+    n.right = right;
+    n.input = input;
+    n.rows = rows;
+    n.cols = cols;
+    nodes.push_back(n);
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+template <typename T>
+const typename BasicMatrixGraph<T>::Node& BasicMatrixGraph<T>::node(int id) const {
+    if (id < 0 || id >= static_cast<int>(nodes.size())) {
+        throw std::out_of_range("No such node in the matrix graph");
+    }
+    return nodes[id];
+}
+
+template <typename T>
+int BasicMatrixGraph<T>::input(const BasicMatrix<T>& M) {
+    return addNode(Op::Input, -1, -1, &M, M.getRows(), M.getCols());
+}
+
+template <typename T>
+int BasicMatrixGraph<T>::multiply(int left, int right) {
+    if (node(left).cols != node(right).rows) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+    return addNode(Op::Multiply, left, right, nullptr, node(left).rows, node(right).cols);
+}
+
+template <typename T>
+int BasicMatrixGraph<T>::add(int left, int right) {
+    if (node(left).rows != node(right).rows || node(left).cols != node(right).cols) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+    return addNode(Op::Add, left, right, nullptr, node(left).rows, node(left).cols);
+}
+
+// Result of one node during evaluate(): the root as one matrix, an
+// intermediate as one matrix per tile row
+template <typename T>
+struct GraphValue {
+    std::vector<BasicMatrix<T>> bands;
+    std::vector<int> bandReaders;   // tasks that still have to read each band
+    int firstTask;                  // task of tile (0, 0); tiles follow row by row
+    int tileRows;
+    int tileCols;
+
+    GraphValue() : firstTask(0), tileRows(0), tileCols(0) {}
+};
+
+template <typename T>
+BasicMatrix<T> BasicMatrixGraph<T>::evaluate(int root, ThreadPool* pool, int workers) {
+    const Node& top = node(root);
+    lastTaskCount = 0;
+    lastPeakBytes = 0;
+    if (top.op == Op::Input) {
+        return *top.input;
+    }
+
+    // Only what the root depends on; operands always precede their users
+    std::vector<bool> needed(root + 1, false);
+    needed[root] = true;
+    long long largest = 0;
+    for (int id = root; id >= 0; --id) {
+        if (needed[id] && nodes[id].op != Op::Input) {
+            needed[nodes[id].left] = true;
+            needed[nodes[id].right] = true;
+            largest = std::max(largest, static_cast<long long>(nodes[id].rows) * nodes[id].cols);
+        }
+    }
+
+    int ts = tileSize;
+    if (ts == 0) {
+        // Same rule as the untuned tiled multiply, on the largest result
+        int threads = pool == nullptr ? 1 : (workers > 0 ? std::min(workers, pool->size()) : pool->size());
+        ts = 256;
+        while (ts > 32 && largest < 4LL * threads * ts * ts) {
+            ts /= 2;
+        }
+    }
+    lastTileSize = ts;
+
+    std::vector<GraphValue<T>> values(root + 1);
+    for (int id = 0; id <= root; ++id) {
+        if (needed[id] && nodes[id].op != Op::Input) {
+            values[id].tileRows = (nodes[id].rows + ts - 1) / ts;
+            values[id].tileCols = (nodes[id].cols + ts - 1) / ts;
+            values[id].bands.resize(id == root ? 1 : values[id].tileRows);
+            values[id].bandReaders.assign(values[id].tileRows, 0);
+        }
+    }
+    // A product tile reads one band of its left operand and every band of its
+    // right one; a sum tile one band of each
+    for (int id = 0; id <= root; ++id) {
+        if (!needed[id] || nodes[id].op == Op::Input) {
+            continue;
+        }
+        GraphValue<T>& v = values[id];
+        int a = nodes[id].left;
+        int b = nodes[id].right;
+        for (int ti = 0; ti < v.tileRows; ++ti) {
+            if (nodes[a].op != Op::Input) {
+                values[a].bandReaders[ti] += v.tileCols;
+            }
+            if (nodes[b].op == Op::Input) {
+                continue;
+            }
+            if (nodes[id].op == Op::Add) {
+                values[b].bandReaders[ti] += v.tileCols;
+            }
+            else {
+                for (int tk = 0; tk < values[b].tileRows; ++tk) {
+                    values[b].bandReaders[tk] += v.tileCols;
+                }
+            }
+        }
+    }
+
+    pthread_mutex_t memoryMutex;
+    pthread_mutex_init(&memoryMutex, nullptr);
+    long long liveBytes = 0;
+    long long peakBytes = 0;
+
+    // Tiles overwrite their block; the last tile column also clears the row
+    // padding. The root is not counted as an intermediate.
+    auto target = [&](int id, int ti) -> BasicMatrix<T>& {
+        GraphValue<T>& v = values[id];
+        int band = id == root ? 0 : ti;
+        pthread_mutex_lock(&memoryMutex);
+        if (v.bands[band].getRows() == 0) {
+            if (id == root) {
+                v.bands[0] = BasicMatrix<T>::uninitialized(nodes[id].rows, nodes[id].cols);
+            }
+            else {
+                int rows = std::min(ts, nodes[id].rows - ti * ts);
+                v.bands[band] = BasicMatrix<T>::uninitialized(rows, nodes[id].cols);
+                liveBytes += static_cast<long long>(rows) * v.bands[band].getStride() * sizeof(T);
+                peakBytes = std::max(peakBytes, liveBytes);
+            }
+        }
+        BasicMatrix<T>& result = v.bands[band];
+        pthread_mutex_unlock(&memoryMutex);
+        return result;
+    };
+    auto release = [&](int id, int band) {
+        if (nodes[id].op == Op::Input) {
+            return;
+        }
+        BasicMatrix<T>& m = values[id].bands[band];
+        pthread_mutex_lock(&memoryMutex);
+        if (--values[id].bandReaders[band] == 0) {
+            liveBytes -= static_cast<long long>(m.getRows()) * m.getStride() * sizeof(T);
+            m = BasicMatrix<T>();
+        }
+        pthread_mutex_unlock(&memoryMutex);
+    };
+    // Block of an operand that lies within tile row r / ts
+    auto operand = [&](int id, int r, int c, int h, int w) -> BasicMatrixView<const T> {
+        if (nodes[id].op == Op::Input) {
+            return nodes[id].input->block(r, c, h, w);
+        }
+        const BasicMatrix<T>& band = values[id].bands[r / ts];
+        return band.block(r % ts, c, h, w);
+    };
+    auto taskOf = [&](int id, int ti, int tj) {
+        return values[id].firstTask + ti * values[id].tileCols + tj;
+    };
+
+    TaskGraph graph;
+    for (int id = 0; id <= root; ++id) {
+        if (!needed[id] || nodes[id].op == Op::Input) {
+            continue;
+        }
+        const Node& n = nodes[id];
+        int a = n.left;
+        int b = n.right;
+        values[id].firstTask = graph.size();
+
+        for (int ti = 0; ti < values[id].tileRows; ++ti) {
+            for (int tj = 0; tj < values[id].tileCols; ++tj) {
+                int task = graph.add([&, id, a, b, ti, tj]() {
+                    const Node& self = nodes[id];
+                    BasicMatrix<T>& result = target(id, ti);
+                    int r0 = ti * ts;
+                    int c0 = tj * ts;
+                    int h = std::min(ts, self.rows - r0);
+                    int w = std::min(ts, self.cols - c0);
+                    int rowBase = id == root ? r0 : 0;
+                    BasicMatrixView<T> C = result.block(rowBase, c0, h, w);
+
+                    if (self.op == Op::Multiply) {
+                        int K = nodes[a].cols;
+                        if (K == 0) {
+                            for (int i = 0; i < h; ++i) {
+                                std::fill(C.rowPtr(i), C.rowPtr(i) + w, T(0));
+                            }
+                        }
+                        else if (nodes[b].op == Op::Input) {
+                            gemm<T, T>(operand(a, r0, 0, h, K), operand(b, 0, c0, K, w), C);
+                        }
+                        else {
+                            // The column strip of B spans its bands, so K goes band by band
+                            for (int k0 = 0; k0 < K; k0 += ts) {
+                                int kh = std::min(ts, K - k0);
+                                gemm<T, T>(operand(a, r0, k0, h, kh), operand(b, k0, c0, kh, w), C, k0 != 0);
+                            }
+                        }
+                    }
+                    else {
+                        BasicMatrixView<const T> L = operand(a, r0, c0, h, w);
+                        BasicMatrixView<const T> R = operand(b, r0, c0, h, w);
+                        for (int i = 0; i < h; ++i) {
+                            const T* l = L.rowPtr(i);
+                            const T* r = R.rowPtr(i);
+                            T* c = C.rowPtr(i);
+                            for (int j = 0; j < w; ++j) {
+                                c[j] = l[j] + r[j];
+                            }
+                        }
+                    }
+                    if (c0 + w == self.cols) {
+                        for (int i = rowBase; i < rowBase + h; ++i) {
+                            std::fill(result.rowPtr(i) + self.cols, result.rowPtr(i) + result.getStride(), T(0));
+                        }
+                    }
+
+                    release(a, ti);
+                    if (self.op == Op::Add) {
+                        release(b, ti);
+                    }
+                    else if (nodes[b].op != Op::Input) {
+                        for (int tk = 0; tk < values[b].tileRows; ++tk) {
+                            release(b, tk);
+                        }
+                    }
+                });
+
+                // Blocks of computed operands this tile reads; inputs are always ready
+                if (n.op == Op::Multiply) {
+                    int kTiles = (nodes[a].cols + ts - 1) / ts;
+                    for (int tk = 0; tk < kTiles; ++tk) {
+                        if (nodes[a].op != Op::Input) graph.depend(task, taskOf(a, ti, tk));
+                        if (nodes[b].op != Op::Input) graph.depend(task, taskOf(b, tk, tj));
+                    }
+                }
+                else {
+                    if (nodes[a].op != Op::Input) graph.depend(task, taskOf(a, ti, tj));
+                    if (nodes[b].op != Op::Input) graph.depend(task, taskOf(b, ti, tj));
+                }
+            }
+        }
+    }
+
+    try {
+        graph.run(pool, workers);
+    }
+    catch (...) {
+        pthread_mutex_destroy(&memoryMutex);
+        throw;
+    }
+    pthread_mutex_destroy(&memoryMutex);
+
+    lastTaskCount = graph.size();
+    lastPeakBytes = peakBytes;
+    if (values[root].tileRows * values[root].tileCols == 0) {
+        // No tiles at all (an empty result)
+        return BasicMatrix<T>(top.rows, top.cols);
+    }
+    return std::move(values[root].bands[0]);
+}
+
+#define INSTANTIATE_MATRIX_GRAPH(T) template class BasicMatrixGraph<T>;
+MATRIX_GRAPH_TYPES(INSTANTIATE_MATRIX_GRAPH)
+#undef INSTANTIATE_MATRIX_GRAPH
@@ -0,0 +1,81 @@
+#ifndef MATRIX_GRAPH_H
+#define MATRIX_GRAPH_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// Element types BasicMatrixGraph is compiled for: products stay in T, so only
+// the types that are their own accumulator
+#define MATRIX_GRAPH_TYPES(X) \
+    X(std::int32_t)           \
+    X(std::int64_t)           \
+    X(float)                  \
+    X(double)
+
+// An expression over matrices, e.g. (A * B) * (C * D) + E, evaluated as one
+// TaskGraph (see TaskGraph.h) instead of one barrier per operation. Every
+// result is cut into tile x tile blocks, each computed by one task that waits
+// only for the blocks it reads: a block of a product needs its row band of the
+// left operand and its column band of the right one, a block of a sum the same
+// block of both operands. Downstream tiles therefore start while upstream
+// products are still running.
+// Intermediates are stored as separate row bands of one tile each, allocated
+// by the first tile written into them and freed after the last task reading
+// them: the left operand of a product and both operands of a sum go band by
+// band, the right operand of a product once the whole product is done.
+template <typename T>
+class BasicMatrixGraph {
+private:
+    enum class Op {
+        Input,
+        Multiply,
+        Add
+    };
+
+    struct Node {
+        Op op;
+        int left;
+        int right;
+        const BasicMatrix<T>* input;   // Input only
+        int rows;
+        int cols;
+    };
+
+    std::vector<Node> nodes;
+    int tileSize;
+    int lastTileSize;
+    int lastTaskCount;
+    long long lastPeakBytes;
+
+    int addNode(Op op, int left, int right, const BasicMatrix<T>* input, int rows, int cols);
+    const Node& node(int id) const;
+
+public:
+    // tileSize 0 picks it per evaluate(): the largest power of two up to 256
+    // that still gives every worker ~4 tiles of the largest result
+    explicit BasicMatrixGraph(int tileSize = 0);
+
+    // Operand used in place: it must stay alive and unchanged until evaluate() returns
+    int input(const BasicMatrix<T>& M);
+    int multiply(int left, int right);
+    int add(int left, int right);
+
+    int getRows(int id) const { return node(id).rows; }
+    int getCols(int id) const { return node(id).cols; }
+
+    // Computes node `root` (and whatever it depends on) on the pool, inline
+    // without one. Intermediates exist only while a task still has to read
+    // them. May be called again, for the same or another root.
+    BasicMatrix<T> evaluate(int root, ThreadPool* pool = nullptr, int workers = 0);
+
+    // Tile side and tile tasks of the last evaluate()
+    int getLastTileSize() const { return lastTileSize; }
+    int getLastTaskCount() const { return lastTaskCount; }
+    // Most bytes held by intermediate results at once during the last evaluate()
+    long long getLastPeakIntermediateBytes() const { return lastPeakBytes; }
+};
+
+typedef BasicMatrixGraph<int> MatrixGraph;
+
+#endif // MATRIX_GRAPH_H
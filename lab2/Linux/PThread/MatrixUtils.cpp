@@ -0,0 +1,478 @@
+#include "MatrixUtils.h"
+#include "Gemm.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+void philox4x32(const std::uint32_t counter[4], const std::uint32_t key[2],
+                std::uint32_t out[4]) {
+    const std::uint32_t M0 = 0xD2511F53u;
+    const std::uint32_t M1 = 0xCD9E8D57u;
+    const std::uint32_t W0 = 0x9E3779B9u;
+    const std::uint32_t W1 = 0xBB67AE85u;
+
+    std::uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    std::uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; ++round) {
+        std::uint64_t p0 = static_cast<std::uint64_t>(M0) * c0;
+        std::uint64_t p1 = static_cast<std::uint64_t>(M1) * c2;
+        std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c1 = static_cast<std::uint32_t>(p1);
+        c3 = static_cast<std::uint32_t>(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += W0;
+        k1 += W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Roughly this many elements per task claimed from the shared cursor
+static const int UTIL_CHUNK_ELEMENTS = 1 << 16;
+
+// Hands out chunks of rows to the pool (or runs inline without one). fn returns
+// false to make every worker skip the chunks still left.
+static void forEachRowChunk(ThreadPool* pool, int rows, int cols,
+                            const std::function<bool(int, int, int)>& fn) {
+    int chunkRows = std::max(1, UTIL_CHUNK_ELEMENTS / std::max(cols, 1));
+    std::atomic<bool> stop(false);
+    ThreadPool::forEachChunk(pool, rows, chunkRows, [&](int begin, int end, int worker) {
+        if (!stop.load(std::memory_order_relaxed) && !fn(begin, end, worker)) {
+            stop.store(true, std::memory_order_relaxed);
+        }
+    });
+}
+
+// Maps 64 random bits onto [min, max]. The modulo bias is below 2^-32 for any
+// range up to 2^32 values.
+template <typename T, bool Integral = std::is_integral<T>::value>
+struct UniformMap {
+    unsigned long long min;
+    unsigned long long range;   // 0: all 2^64 values
+
+    UniformMap(T lo, T hi)
+        : min(static_cast<unsigned long long>(static_cast<long long>(lo))),
+          range(static_cast<unsigned long long>(static_cast<long long>(hi)) - min + 1) {}
+
+    T operator()(std::uint64_t bits) const {
+        return static_cast<T>(static_cast<long long>(min + (range == 0 ? bits : bits % range)));
+    }
+};
+
+template <typename T>
+struct UniformMap<T, false> {
+    double min;
+    double width;
+
+    UniformMap(T lo, T hi) : min(lo), width(static_cast<double>(hi) - lo) {}
+
+    T operator()(std::uint64_t bits) const {
+        // Top 53 bits as a double in [0, 1)
+        double u = static_cast<double>(bits >> 11) * (1.0 / 9007199254740992.0);
+        return static_cast<T>(min + width * u);
+    }
+};
+
+template <typename T>
+void randomFill(const BasicMatrixView<T>& M, T min, T max, std::uint64_t seed,
+                ThreadPool* pool) {
+    if (min > max) {
+        throw std::invalid_argument("randomFill: min must not exceed max");
+    }
+
+    UniformMap<T> map(min, max);
+    const std::uint32_t key[2] = { static_cast<std::uint32_t>(seed),
+                                   static_cast<std::uint32_t>(seed >> 32) };
+
+    forEachRowChunk(pool, M.rows, M.cols, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            T* row = M.rowPtr(i);
+            // One Philox block gives two 64-bit draws: columns 2q and 2q + 1
+            for (int j = 0; j < M.cols; j += 2) {
+                const std::uint32_t counter[4] = { static_cast<std::uint32_t>(j / 2),
+                                                   static_cast<std::uint32_t>(i), 0, 0 };
+                std::uint32_t bits[4];
+                philox4x32(counter, key, bits);
+                row[j] = map(bits[0] | static_cast<std::uint64_t>(bits[1]) << 32);
+                if (j + 1 < M.cols) {
+                    row[j + 1] = map(bits[2] | static_cast<std::uint64_t>(bits[3]) << 32);
+                }
+            }
+        }
+        return true;
+    });
+}
+
+// Integers: memcmp, which the C library vectorizes
+template <typename T>
+static typename std::enable_if<std::is_integral<T>::value, bool>::type
+rowsEqual(const T* a, const T* b, int n) {
+    return std::memcmp(a, b, static_cast<size_t>(n) * sizeof(T)) == 0;
+}
+
+// Floating point: == per element, without a branch so the loop vectorizes
+template <typename T>
+static typename std::enable_if<!std::is_integral<T>::value, bool>::type
+rowsEqual(const T* a, const T* b, int n) {
+    bool same = true;
+    for (int j = 0; j < n; ++j) {
+        same &= a[j] == b[j];
+    }
+    return same;
+}
+
+template <typename T>
+bool matricesEqual(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                   ThreadPool* pool) {
+    if (A.rows != B.rows || A.cols != B.cols) {
+        return false;
+    }
+
+    std::atomic<bool> differ(false);
+    forEachRowChunk(pool, A.rows, A.cols, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            if (!rowsEqual(A.rowPtr(i), B.rowPtr(i), A.cols)) {
+                differ.store(true, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        return true;
+    });
+    return !differ.load();
+}
+
+// Whether `candidate` replaces `current` as the largest difference; NaN wins and stays
+static bool largerDiff(double candidate, double current) {
+    return !std::isnan(current) && !(candidate <= current);
+}
+
+template <typename T>
+MatrixDiff<T> matrixDiff(const BasicMatrixView<const T>& expected,
+                         const BasicMatrixView<const T>& actual, ThreadPool* pool) {
+    MatrixDiff<T> none;
+    none.sameShape = expected.rows == actual.rows && expected.cols == actual.cols;
+    none.mismatches = 0;
+    none.row = -1;
+    none.col = -1;
+    none.expected = T(0);
+    none.actual = T(0);
+    none.maxAbsDiff = 0.0;
+    if (!none.sameShape) {
+        return none;
+    }
+
+    // One partial result per worker, merged at the end
+    std::vector<MatrixDiff<T>> partial(pool != nullptr ? pool->size() : 1, none);
+    forEachRowChunk(pool, expected.rows, expected.cols, [&](int begin, int end, int worker) {
+        MatrixDiff<T>& d = partial[worker];
+        for (int i = begin; i < end; ++i) {
+            const T* e = expected.rowPtr(i);
+            const T* a = actual.rowPtr(i);
+            if (rowsEqual(e, a, expected.cols)) {
+                continue;
+            }
+            for (int j = 0; j < expected.cols; ++j) {
+                if (e[j] == a[j]) continue;
+                ++d.mismatches;
+                if (d.row < 0 || i < d.row || (i == d.row && j < d.col)) {
+                    d.row = i;
+                    d.col = j;
+                    d.expected = e[j];
+                    d.actual = a[j];
+                }
+                double diff = std::fabs(static_cast<double>(e[j]) - static_cast<double>(a[j]));
+                if (largerDiff(diff, d.maxAbsDiff)) {
+                    d.maxAbsDiff = diff;
+                }
+            }
+        }
+        return true;
+    });
+
+    MatrixDiff<T> result = none;
+    for (const MatrixDiff<T>& d : partial) {
+        result.mismatches += d.mismatches;
+        if (largerDiff(d.maxAbsDiff, result.maxAbsDiff)) {
+            result.maxAbsDiff = d.maxAbsDiff;
+        }
+        if (d.row >= 0 && (result.row < 0 || d.row < result.row ||
+                           (d.row == result.row && d.col < result.col))) {
+            result.row = d.row;
+            result.col = d.col;
+            result.expected = d.expected;
+            result.actual = d.actual;
+        }
+    }
+    return result;
+}
+
+// Rows [begin, end) of A times X; A is widened to Acc first when T is narrower,
+// since gemm() takes both operands in one type
+template <typename T, typename Acc>
+static typename std::enable_if<std::is_same<T, Acc>::value>::type
+multiplyRows(const BasicMatrixView<const T>& A, int begin, int end, const BasicMatrix<Acc>& X,
+             BasicMatrix<Acc>& Y) {
+    gemm<Acc, Acc>(A.rowRange(begin, end), X.view(), Y.view());
+}
+
+template <typename T, typename Acc>
+static typename std::enable_if<!std::is_same<T, Acc>::value>::type
+multiplyRows(const BasicMatrixView<const T>& A, int begin, int end, const BasicMatrix<Acc>& X,
+             BasicMatrix<Acc>& Y) {
+    BasicMatrix<Acc> wide = BasicMatrix<Acc>::uninitialized(end - begin, A.cols);
+    for (int i = begin; i < end; ++i) {
+        std::copy(A.rowPtr(i), A.rowPtr(i) + A.cols, wide.rowPtr(i - begin));
+        std::fill(wide.rowPtr(i - begin) + A.cols, wide.rowPtr(i - begin) + wide.getStride(), Acc(0));
+    }
+    gemm<Acc, Acc>(wide.view(), X.view(), Y.view());
+}
+
+template <typename T>
+static double rowNorm(const T* row, int n) {
+    double sum = 0.0;
+    for (int j = 0; j < n; ++j) {
+        sum += static_cast<double>(row[j]) * static_cast<double>(row[j]);
+    }
+    return std::sqrt(sum);
+}
+
+// Size of the rounding noise in (A X - C R)(i, v) for a correct floating point
+// C. Each term is the usual sqrt(n) * epsilon * |x| * |y| estimate of an n-term
+// dot product: C itself (and B R) through A, A X, and C R. Rounding errors
+// vary in sign, and so do the vectors, so this is far below the worst-case
+// bound. An error in C is caught once it exceeds this noise, i.e. roughly
+// sqrt(N) times the rounding of a single element.
+struct FreivaldsNoise {
+    std::vector<double> rowA;     // |A(i, :)|
+    std::vector<double> rowC;     // |C(i, :)|
+    std::vector<double> spreadB;  // per vector: sqrt(sum_j |B(:, j)|^2 r_j^2)
+    std::vector<double> normX;    // per vector: |X(:, v)|
+    std::vector<double> normR;    // per vector: |R(:, v)|
+    double sqrtK;
+    double sqrtN;
+    double scale;                 // safety factor * epsilon of the accumulator
+
+    double at(int i, int v) const {
+        return scale * ((sqrtK + sqrtN) * rowA[i] * spreadB[v] + sqrtK * rowA[i] * normX[v] +
+                        sqrtN * rowC[i] * normR[v]);
+    }
+};
+
+// Noise measured on gemm() and Strassen results stays under 0.2 of the estimate
+static const double FREIVALDS_NOISE_FACTOR = 4.0;
+
+// Dot product of an n-element row with x in the unsigned type U, which wraps by
+// definition; four partial sums keep the adds independent
+template <typename T, typename U>
+static U wrappingDot(const T* a, const U* x, int n) {
+    U s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        s0 += static_cast<U>(a[j]) * x[j];
+        s1 += static_cast<U>(a[j + 1]) * x[j + 1];
+        s2 += static_cast<U>(a[j + 2]) * x[j + 2];
+        s3 += static_cast<U>(a[j + 3]) * x[j + 3];
+    }
+    for (; j < n; ++j) {
+        s0 += static_cast<U>(a[j]) * x[j];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+// Integer rounds: A (B r) against C r modulo 2^bits of Acc, worked out in the
+// unsigned type of the same width, which wraps by definition (the signed one
+// would overflow, which is undefined). C matches when it equals the exact
+// product modulo 2^bits, as a wrapped result does. r is uniform over all 2^bits
+// values, so a wrong row of C passes a round with probability at most 1/2: the
+// term of its difference with the fewest trailing zero bits alone takes at
+// least two values, each equally often.
+template <typename T, typename Acc>
+static typename std::enable_if<std::is_integral<Acc>::value, int>::type
+freivaldsFailedRow(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                   const BasicMatrixView<const Acc>& C, int k, std::uint64_t seed, ThreadPool* pool) {
+    typedef typename std::make_unsigned<Acc>::type U;
+    int M = A.rows;
+    int K = A.cols;
+    int N = B.cols;
+
+    // The k vectors as the rows of R (k x N), so that every product below is a
+    // dot product of two contiguous rows
+    BasicMatrix<Acc> R(k, N);
+    randomFill<Acc>(R.view(), std::numeric_limits<Acc>::min(), std::numeric_limits<Acc>::max(), seed, pool);
+    std::vector<U> wrappedR(static_cast<size_t>(k) * N);
+    for (int v = 0; v < k; ++v) {
+        std::copy(R.rowPtr(v), R.rowPtr(v) + N, wrappedR.data() + static_cast<size_t>(v) * N);
+    }
+
+    // X = (B R^T)^T (k x K, row-major), columns split across the pool
+    std::vector<U> X(static_cast<size_t>(k) * K);
+    forEachRowChunk(pool, K, N * k, [&](int begin, int end, int) {
+        for (int kk = begin; kk < end; ++kk) {
+            for (int v = 0; v < k; ++v) {
+                X[static_cast<size_t>(v) * K + kk] =
+                    wrappingDot(B.rowPtr(kk), wrappedR.data() + static_cast<size_t>(v) * N, N);
+            }
+        }
+        return true;
+    });
+
+    // A X^T against C R^T, row by row; every worker stops at the first failure
+    std::atomic<int> failedRow(-1);
+    forEachRowChunk(pool, M, (K + N) * k, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            for (int v = 0; v < k; ++v) {
+                if (wrappingDot(A.rowPtr(i), X.data() + static_cast<size_t>(v) * K, K) !=
+                    wrappingDot(C.rowPtr(i), wrappedR.data() + static_cast<size_t>(v) * N, N)) {
+                    failedRow.store(i, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+        }
+        return true;
+    });
+    return failedRow.load();
+}
+
+// Floating point rounds: A (B R) against C R through gemm(), allowing for the
+// rounding noise of a correct C
+template <typename T, typename Acc>
+static typename std::enable_if<!std::is_integral<Acc>::value, int>::type
+freivaldsFailedRow(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                   const BasicMatrixView<const Acc>& C, int k, std::uint64_t seed, ThreadPool* pool) {
+    int M = A.rows;
+    int K = A.cols;
+    int N = B.cols;
+
+    // The k vectors as the columns of R (N x k), in [-1, 1]
+    BasicMatrix<T> R(N, k);
+    randomFill<T>(R.view(), T(-1), T(1), seed, pool);
+    BasicMatrix<Acc> wideR = R.template convert<Acc>();
+
+    // X = B R (K x k), rows of B split across the pool
+    BasicMatrix<Acc> X(K, k);
+    int chunkWidth = std::max(1, (K + N) / 4);
+    forEachRowChunk(pool, K, chunkWidth, [&](int begin, int end, int) {
+        gemm<T, Acc>(B.rowRange(begin, end), R.view(), X.rowRange(begin, end));
+        return true;
+    });
+
+    FreivaldsNoise noise;
+    noise.sqrtK = std::sqrt(static_cast<double>(K));
+    noise.sqrtN = std::sqrt(static_cast<double>(N));
+    noise.scale = FREIVALDS_NOISE_FACTOR * std::numeric_limits<Acc>::epsilon();
+    noise.rowA.resize(M);
+    noise.rowC.resize(M);
+    forEachRowChunk(pool, M, K + N, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            noise.rowA[i] = rowNorm(A.rowPtr(i), K);
+            noise.rowC[i] = rowNorm(C.rowPtr(i), N);
+        }
+        return true;
+    });
+    std::vector<double> columnB(N, 0.0);
+    for (int kk = 0; kk < K; ++kk) {
+        const T* b = B.rowPtr(kk);
+        for (int j = 0; j < N; ++j) {
+            columnB[j] += static_cast<double>(b[j]) * static_cast<double>(b[j]);
+        }
+    }
+    noise.spreadB.assign(k, 0.0);
+    noise.normX.assign(k, 0.0);
+    noise.normR.assign(k, 0.0);
+    for (int j = 0; j < N; ++j) {
+        for (int v = 0; v < k; ++v) {
+            double r = static_cast<double>(R(j, v));
+            noise.spreadB[v] += columnB[j] * r * r;
+            noise.normR[v] += r * r;
+        }
+    }
+    for (int kk = 0; kk < K; ++kk) {
+        for (int v = 0; v < k; ++v) {
+            noise.normX[v] += static_cast<double>(X(kk, v)) * static_cast<double>(X(kk, v));
+        }
+    }
+    for (int v = 0; v < k; ++v) {
+        noise.spreadB[v] = std::sqrt(noise.spreadB[v]);
+        noise.normX[v] = std::sqrt(noise.normX[v]);
+        noise.normR[v] = std::sqrt(noise.normR[v]);
+    }
+
+    // A X against C R, chunk by chunk; every worker stops at the first failure
+    std::atomic<int> failedRow(-1);
+    forEachRowChunk(pool, M, chunkWidth, [&](int begin, int end, int) {
+        BasicMatrix<Acc> Y(end - begin, k);
+        BasicMatrix<Acc> Z(end - begin, k);
+        multiplyRows<T, Acc>(A, begin, end, X, Y);
+        gemm<Acc, Acc>(C.rowRange(begin, end), wideR.view(), Z.view());
+
+        for (int i = begin; i < end; ++i) {
+            const Acc* y = Y.rowPtr(i - begin);
+            const Acc* z = Z.rowPtr(i - begin);
+            bool ok = true;
+            for (int v = 0; v < k; ++v) {
+                // Written so that NaN fails
+                ok &= std::fabs(static_cast<double>(y[v]) - static_cast<double>(z[v])) <=
+                      noise.at(i, v);
+            }
+            if (!ok) {
+                failedRow.store(i, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        return true;
+    });
+    return failedRow.load();
+}
+
+template <typename T, typename Acc>
+FreivaldsResult freivaldsVerify(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                                const BasicMatrixView<const Acc>& C, double errorBound,
+                                std::uint64_t seed, ThreadPool* pool) {
+    if (A.cols != B.rows) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+    if (!(errorBound > 0.0 && errorBound < 1.0)) {
+        throw std::invalid_argument("Error bound must be in (0, 1)");
+    }
+
+    FreivaldsResult result;
+    result.passed = false;
+    result.rounds = 0;
+    result.row = -1;
+    if (C.rows != A.rows || C.cols != B.cols) {
+        return result;
+    }
+
+    int k = std::max(1, static_cast<int>(std::ceil(-std::log2(errorBound))));
+    result.rounds = k;
+    result.row = freivaldsFailedRow<T, Acc>(A, B, C, k, seed, pool);
+    result.passed = result.row < 0;
+    return result;
+}
+
+#define INSTANTIATE_MATRIX_UTILS(T)                                                         \
+    template void randomFill<T>(const BasicMatrixView<T>&, T, T, std::uint64_t, ThreadPool*); \
+    template bool matricesEqual<T>(const BasicMatrixView<const T>&,                         \
+                                   const BasicMatrixView<const T>&, ThreadPool*);           \
+    template MatrixDiff<T> matrixDiff<T>(const BasicMatrixView<const T>&,                   \
+                                         const BasicMatrixView<const T>&, ThreadPool*);
+MATRIX_ELEMENT_TYPES(INSTANTIATE_MATRIX_UTILS)
+#undef INSTANTIATE_MATRIX_UTILS
+
+#define INSTANTIATE_FREIVALDS(T, Acc)                                                          \
+    template FreivaldsResult freivaldsVerify<T, Acc>(const BasicMatrixView<const T>&,          \
+                                                     const BasicMatrixView<const T>&,          \
+                                                     const BasicMatrixView<const Acc>&, double, \
+                                                     std::uint64_t, ThreadPool*);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_FREIVALDS)
+#undef INSTANTIATE_FREIVALDS
@@ -0,0 +1,77 @@
+#ifndef MATRIX_UTILS_H
+#define MATRIX_UTILS_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <cstdint>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"):
+// a keyed bijection of a 128-bit counter. Every output depends only on
+// (key, counter), so any element can be generated independently of the others.
+void philox4x32(const std::uint32_t counter[4], const std::uint32_t key[2],
+                std::uint32_t out[4]);
+
+// Fills M with values drawn uniformly from [min, max]. Element (i, j) comes
+// from Philox with counter (j / 2, i) and key `seed`, so the result depends only
+// on the seed and the element's position: the same for any pool size or chunking.
+// Rows are split across the pool (if any). Throws std::invalid_argument if min > max.
+template <typename T>
+void randomFill(const BasicMatrixView<T>& M, T min, T max, std::uint64_t seed,
+                ThreadPool* pool = nullptr);
+
+// Element-wise equality, rows split across the pool. Every worker stops as
+// soon as any of them finds a difference. Integer rows are compared with
+// memcmp (vectorized by the C library); floating point uses ==, so NaN never
+// equals anything.
+template <typename T>
+bool matricesEqual(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                   ThreadPool* pool = nullptr);
+
+// Where and by how much two matrices differ
+template <typename T>
+struct MatrixDiff {
+    bool sameShape;
+    long long mismatches;   // elements that differ
+    int row;                // first mismatch in row-major order, -1 if none
+    int col;
+    T expected;             // values at (row, col)
+    T actual;
+    double maxAbsDiff;      // largest |expected - actual|
+
+    bool equal() const { return sameShape && mismatches == 0; }
+};
+
+// Full comparison of `actual` against `expected`, rows split across the pool.
+// Rows that compare equal as a whole (memcmp for integers) are skipped without
+// an element scan.
+template <typename T>
+MatrixDiff<T> matrixDiff(const BasicMatrixView<const T>& expected,
+                         const BasicMatrixView<const T>& actual, ThreadPool* pool = nullptr);
+
+// Outcome of freivaldsVerify()
+struct FreivaldsResult {
+    bool passed;
+    int rounds;   // random vectors used
+    int row;      // a row of C that failed the check, -1 if none
+};
+
+// Freivalds' randomized check of C == A * B without recomputing the product:
+// for random vectors r, A (B r) is compared with C r, which costs
+// O(rounds * (MK + KN + MN)) instead of O(MKN). A wrong C passes one round with
+// probability at most 1/2, so ceil(log2(1 / errorBound)) rounds bound the
+// chance of accepting it by errorBound. The rounds run as one batch, one
+// column per round, rows split across the pool.
+// Integer products are checked exactly modulo 2^bits of Acc, in the unsigned
+// type of that width, so nothing overflows whatever the values. Floating point
+// allows for an estimate of the rounding noise of a correct product in Acc
+// (from the norms of the rows and columns involved), so only errors above that
+// noise are caught; NaN never passes.
+// A C of the wrong shape fails without any rounds. Throws std::invalid_argument
+// if A and B do not match or errorBound is not in (0, 1).
+// Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+template <typename T, typename Acc>
+FreivaldsResult freivaldsVerify(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                                const BasicMatrixView<const Acc>& C, double errorBound,
+                                std::uint64_t seed, ThreadPool* pool = nullptr);
+
+#endif // MATRIX_UTILS_H
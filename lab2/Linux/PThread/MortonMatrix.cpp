@@ -0,0 +1,211 @@
+#include "MortonMatrix.h"
+#include "Gemm.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+static std::uint64_t spreadBits(std::uint32_t value) {
+    std::uint64_t x = value;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+std::uint64_t mortonIndex(std::uint32_t i, std::uint32_t j) {
+    return (spreadBits(i) << 1) | spreadBits(j);
+}
+
+static const std::size_t MORTON_TILE_ELEMENTS = static_cast<std::size_t>(MORTON_TILE) * MORTON_TILE;
+
+template <typename T>
+BasicMortonMatrix<T>::BasicMortonMatrix() : rows(0), cols(0), tileRows(0), tileCols(0) {}
+
+template <typename T>
+BasicMortonMatrix<T>::BasicMortonMatrix(int r, int c)
+    : rows(r), cols(c),
+      tileRows((r + MORTON_TILE - 1) / MORTON_TILE),
+      tileCols((c + MORTON_TILE - 1) / MORTON_TILE) {
+    if (r < 0 || c < 0) {
+        throw std::invalid_argument("Matrix dimensions must not be negative");
+    }
+
+    // Rank of every tile in Morton order over the tiles that exist
+    std::vector<std::pair<std::uint64_t, int>> order;
+    order.reserve(static_cast<std::size_t>(tileRows) * tileCols);
+    for (int ti = 0; ti < tileRows; ++ti) {
+        for (int tj = 0; tj < tileCols; ++tj) {
+            order.push_back(std::make_pair(mortonIndex(ti, tj), ti * tileCols + tj));
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    tileOffset.resize(order.size());
+    for (std::size_t rank = 0; rank < order.size(); ++rank) {
+        tileOffset[order[rank].second] = rank * MORTON_TILE_ELEMENTS;
+    }
+    data.assign(order.size() * MORTON_TILE_ELEMENTS, T(0));
+}
+
+template <typename T>
+BasicMatrixView<T> BasicMortonMatrix<T>::tile(int ti, int tj) {
+    return BasicMatrixView<T>(tilePtr(ti, tj), std::min(MORTON_TILE, rows - ti * MORTON_TILE),
+                              std::min(MORTON_TILE, cols - tj * MORTON_TILE), MORTON_TILE);
+}
+
+template <typename T>
+BasicMatrixView<const T> BasicMortonMatrix<T>::tile(int ti, int tj) const {
+    return BasicMatrixView<const T>(tilePtr(ti, tj), std::min(MORTON_TILE, rows - ti * MORTON_TILE),
+                                    std::min(MORTON_TILE, cols - tj * MORTON_TILE), MORTON_TILE);
+}
+
+template <typename T>
+BasicMortonMatrix<T> BasicMortonMatrix<T>::fromMatrix(const BasicMatrix<T>& M, ThreadPool* pool) {
+    BasicMortonMatrix<T> result(M.getRows(), M.getCols());
+    ThreadPool::forEachChunk(pool, result.tileRows, 1, [&](int ti, int, int) {
+        for (int tj = 0; tj < result.tileCols; ++tj) {
+            BasicMatrixView<T> target = result.tile(ti, tj);
+            for (int i = 0; i < target.rows; ++i) {
+                const T* source = M.rowPtr(ti * MORTON_TILE + i) + tj * MORTON_TILE;
+                std::copy(source, source + target.cols, target.rowPtr(i));
+            }
+        }
+    });
+    return result;
+}
+
+template <typename T>
+BasicMatrix<T> BasicMortonMatrix<T>::toMatrix(ThreadPool* pool) const {
+    // Every element is overwritten, so no zeroing; padding is cleared per row
+    BasicMatrix<T> result = BasicMatrix<T>::uninitialized(rows, cols);
+    ThreadPool::forEachChunk(pool, tileRows, 1, [&](int ti, int, int) {
+        int rowEnd = std::min(rows, (ti + 1) * MORTON_TILE);
+        for (int i = ti * MORTON_TILE; i < rowEnd; ++i) {
+            std::fill(result.rowPtr(i) + cols, result.rowPtr(i) + result.getStride(), T(0));
+        }
+        for (int tj = 0; tj < tileCols; ++tj) {
+            BasicMatrixView<const T> source = tile(ti, tj);
+            for (int i = 0; i < source.rows; ++i) {
+                std::copy(source.rowPtr(i), source.rowPtr(i) + source.cols,
+                          result.rowPtr(ti * MORTON_TILE + i) + tj * MORTON_TILE);
+            }
+        }
+    });
+    return result;
+}
+
+template <typename T>
+bool BasicMortonMatrix<T>::equals(const BasicMortonMatrix& other) const {
+    // Same shape means the same tile order, and padding is zero on both sides
+    return rows == other.rows && cols == other.cols && data == other.data;
+}
+
+// Tiles [i0, i1) x [j0, j1) of C, accumulated over tiles [k0, k1) of K
+struct MortonRange {
+    int i0, i1;
+    int j0, j1;
+    int k0, k1;
+};
+
+// Largest power of two below n (n >= 2): splitting there keeps both halves on
+// Morton quadrant boundaries, so each stays one contiguous run of tiles
+static int splitPoint(int n) {
+    int half = 1;
+    while (half * 2 < n) half *= 2;
+    return half;
+}
+
+template <typename T, typename Acc>
+static void multiplyRecursive(const BasicMortonMatrix<T>& A, const BasicMortonMatrix<T>& B,
+                              BasicMortonMatrix<Acc>& C, const MortonRange& r) {
+    int m = r.i1 - r.i0;
+    int n = r.j1 - r.j0;
+    int k = r.k1 - r.k0;
+    if (m == 1 && n == 1 && k == 1) {
+        // K is always walked in order, so tile 0 of K is the first to reach C
+        gemm<T, Acc>(A.tile(r.i0, r.k0), B.tile(r.k0, r.j0), C.tile(r.i0, r.j0), r.k0 != 0);
+        return;
+    }
+
+    MortonRange first = r;
+    MortonRange second = r;
+    if (k >= m && k >= n) {
+        first.k1 = second.k0 = r.k0 + splitPoint(k);
+    }
+    else if (m >= n) {
+        first.i1 = second.i0 = r.i0 + splitPoint(m);
+    }
+    else {
+        first.j1 = second.j0 = r.j0 + splitPoint(n);
+    }
+    multiplyRecursive(A, B, C, first);
+    multiplyRecursive(A, B, C, second);
+}
+
+// Independent subproblems per worker before the recursion runs sequentially
+static const int MORTON_TASKS_PER_WORKER = 4;
+
+template <typename T, typename Acc>
+BasicMortonMatrix<Acc> mortonMultiply(const BasicMortonMatrix<T>& A, const BasicMortonMatrix<T>& B,
+                                      ThreadPool* pool) {
+    if (A.getCols() != B.getRows()) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+
+    BasicMortonMatrix<Acc> C(A.getRows(), B.getCols());
+    MortonRange all = { 0, A.getTileRows(), 0, B.getTileCols(), 0, A.getTileCols() };
+    if (all.i1 == 0 || all.j1 == 0 || all.k1 == 0) {
+        return C;
+    }
+    if (pool == nullptr || pool->size() == 1) {
+        multiplyRecursive(A, B, C, all);
+        return C;
+    }
+
+    // Halve M or N (whichever is larger) breadth-first, each task replaced in
+    // place by its halves so the list stays in Z-order
+    std::vector<MortonRange> tasks(1, all);
+    std::size_t wanted = static_cast<std::size_t>(MORTON_TASKS_PER_WORKER) * pool->size();
+    while (tasks.size() < wanted) {
+        std::vector<MortonRange> halves;
+        for (const MortonRange& t : tasks) {
+            int m = t.i1 - t.i0;
+            int n = t.j1 - t.j0;
+            if (m == 1 && n == 1) {
+                halves.push_back(t);
+                continue;
+            }
+            MortonRange first = t;
+            MortonRange second = t;
+            if (m >= n) {
+                first.i1 = second.i0 = t.i0 + splitPoint(m);
+            }
+            else {
+                first.j1 = second.j0 = t.j0 + splitPoint(n);
+            }
+            halves.push_back(first);
+            halves.push_back(second);
+        }
+        if (halves.size() == tasks.size()) {
+            break;
+        }
+        tasks.swap(halves);
+    }
+
+    ThreadPool::forEachChunk(pool, static_cast<int>(tasks.size()), 1, [&](int t, int, int) {
+        multiplyRecursive(A, B, C, tasks[t]);
+    });
+    return C;
+}
+
+#define INSTANTIATE_MORTON_MATRIX(T) template class BasicMortonMatrix<T>;
+MATRIX_ELEMENT_TYPES(INSTANTIATE_MORTON_MATRIX)
+#undef INSTANTIATE_MORTON_MATRIX
+
+#define INSTANTIATE_MORTON_PRODUCT(T, Acc)                                                     \
+    template BasicMortonMatrix<Acc> mortonMultiply<T, Acc>(const BasicMortonMatrix<T>&,        \
+                                                           const BasicMortonMatrix<T>&, ThreadPool*);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_MORTON_PRODUCT)
+#undef INSTANTIATE_MORTON_PRODUCT
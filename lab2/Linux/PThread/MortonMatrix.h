@@ -0,0 +1,83 @@
+#ifndef MORTON_MATRIX_H
+#define MORTON_MATRIX_H
+
+#include "Matrix.h"
+#include "AlignedAllocator.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Side of the square tiles of a BasicMortonMatrix, in elements. Not a tuning
+// knob: it only has to be large enough for gemm() to amortize packing and the
+// reloads of C over a tile (64 loses ~25% to that), while three tiles of 32-bit
+// elements (192 KB) still fit in L2; the recursion above adapts to every level.
+static const int MORTON_TILE = 128;
+
+// Bits of i and j interleaved, j in the even positions: (0,0) (0,1) (1,0) (1,1) ...
+std::uint64_t mortonIndex(std::uint32_t i, std::uint32_t j);
+
+// Blocked Z-order layout: the matrix is cut into MORTON_TILE x MORTON_TILE tiles,
+// each stored contiguously (row-major inside the tile), and the tiles follow
+// each other in Morton order. Any aligned 2^k x 2^k group of tiles is one
+// contiguous range, so a recursive algorithm finds its sub-blocks close together
+// at every size. Grids that are not square powers of two keep the same order
+// with the missing tiles skipped. Edge tiles are padded with zeros.
+template <typename T>
+class BasicMortonMatrix {
+private:
+    std::vector<T, AlignedAllocator<T, 64>> data;
+    int rows;
+    int cols;
+    int tileRows;
+    int tileCols;
+    std::vector<std::size_t> tileOffset;   // [ti * tileCols + tj], in elements
+
+public:
+    typedef T value_type;
+
+    BasicMortonMatrix();
+    // Zero-filled r x c matrix
+    BasicMortonMatrix(int r, int c);
+
+    // Tiles are copied in parallel on the pool (inline without one)
+    static BasicMortonMatrix fromMatrix(const BasicMatrix<T>& M, ThreadPool* pool = nullptr);
+    BasicMatrix<T> toMatrix(ThreadPool* pool = nullptr) const;
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    int getTileRows() const { return tileRows; }
+    int getTileCols() const { return tileCols; }
+
+    // Element (i, j) through the tile table; for bulk work use the tiles
+    T& operator()(int i, int j) {
+        return tilePtr(i / MORTON_TILE, j / MORTON_TILE)[(i % MORTON_TILE) * MORTON_TILE + j % MORTON_TILE];
+    }
+    const T& operator()(int i, int j) const {
+        return tilePtr(i / MORTON_TILE, j / MORTON_TILE)[(i % MORTON_TILE) * MORTON_TILE + j % MORTON_TILE];
+    }
+
+    T* tilePtr(int ti, int tj) { return data.data() + tileOffset[ti * tileCols + tj]; }
+    const T* tilePtr(int ti, int tj) const { return data.data() + tileOffset[ti * tileCols + tj]; }
+
+    // The part of tile (ti, tj) inside the matrix (smaller at the right and bottom edges)
+    BasicMatrixView<T> tile(int ti, int tj);
+    BasicMatrixView<const T> tile(int ti, int tj) const;
+
+    bool equals(const BasicMortonMatrix& other) const;
+};
+
+typedef BasicMortonMatrix<int> MortonMatrix;
+
+// C = A * B on Morton matrices, cache-oblivious: the largest of the three
+// dimensions (in tiles) is halved until a single tile product remains, which
+// runs through gemm(). Halving M or N gives independent halves; these are cut
+// until there are a few tasks per worker, which workers claim in Z-order from a
+// shared cursor. Each task then recurses on its own, halving K in order so a
+// tile of C is accumulated without synchronization.
+// Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+BasicMortonMatrix<Acc> mortonMultiply(const BasicMortonMatrix<T>& A, const BasicMortonMatrix<T>& B,
+                                      ThreadPool* pool = nullptr);
+
+#endif // MORTON_MATRIX_H
@@ -0,0 +1,106 @@
+#include "Numa.h"
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+NumaTopology NumaTopology::detect() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    auto isAllowed = [&](int cpu) {
+        return !haveMask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+    };
+
+    NumaTopology topology;
+    if (DIR* dir = opendir("/sys/devices/system/node")) {
+        std::vector<int> ids;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") == 0 && name.size() > 4 &&
+                name.find_first_not_of("0123456789", 4) == std::string::npos) {
+                ids.push_back(std::atoi(name.c_str() + 4));
+            }
+        }
+        closedir(dir);
+        std::sort(ids.begin(), ids.end());
+
+        for (int id : ids) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string list;
+            std::getline(in, list);
+
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(list)) {
+                if (isAllowed(cpu)) cpus.push_back(cpu);
+            }
+            // Memory-only nodes and nodes outside our cpuset cannot host workers
+            if (!cpus.empty()) {
+                topology.nodeIds.push_back(id);
+                topology.nodeCpus.push_back(cpus);
+            }
+        }
+    }
+
+    if (topology.nodeCpus.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (haveMask && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        }
+        if (cpus.empty()) cpus.push_back(0);
+        topology.nodeIds.push_back(0);
+        topology.nodeCpus.push_back(cpus);
+    }
+    return topology;
+}
+
+WorkerPlacement WorkerPlacement::spread(const NumaTopology& topology, int workers) {
+    size_t totalCpus = 0;
+    for (const std::vector<int>& cpus : topology.nodeCpus) {
+        totalCpus += cpus.size();
+    }
+
+    WorkerPlacement placement;
+    int assigned = 0;
+    size_t cpusBefore = 0;
+    for (int n = 0; n < topology.nodeCount(); ++n) {
+        const std::vector<int>& cpus = topology.nodeCpus[n];
+        cpusBefore += cpus.size();
+        // Workers [assigned, end) land on node n
+        int end = static_cast<int>(static_cast<long long>(workers) * cpusBefore / totalCpus);
+        for (int w = assigned; w < end; ++w) {
+            placement.node.push_back(n);
+            placement.cpu.push_back(cpus[(w - assigned) % cpus.size()]);
+        }
+        assigned = end;
+    }
+    return placement;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
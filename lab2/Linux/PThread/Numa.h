@@ -0,0 +1,35 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <string>
+#include <vector>
+
+// NUMA nodes and the CPUs this process may run on in each of them, read from
+// /sys/devices/system/node. Machines (or containers) without that information
+// are reported as a single node holding every allowed CPU.
+struct NumaTopology {
+    std::vector<int> nodeIds;                 // kernel node numbers
+    std::vector<std::vector<int>> nodeCpus;   // allowed CPUs of each node
+
+    static NumaTopology detect();
+
+    int nodeCount() const { return static_cast<int>(nodeCpus.size()); }
+};
+
+// Where each pool worker runs: workers are spread over the nodes in proportion
+// to their CPU counts, contiguously, and take distinct CPUs inside a node
+// (wrapping around when there are more workers than CPUs)
+struct WorkerPlacement {
+    std::vector<int> node;   // index into NumaTopology::nodeCpus
+    std::vector<int> cpu;
+
+    static WorkerPlacement spread(const NumaTopology& topology, int workers);
+};
+
+// Restricts the calling thread to `cpus`; false if the kernel refused
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+// Parses a kernel CPU list such as "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string& list);
+
+#endif // NUMA_H
@@ -0,0 +1,272 @@
+#include "OutOfCore.h"
+#include "Gemm.h"
+#include "MatrixFile.h"
+#include <pthread.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+// Tiles are never shrunk below this (unless the matrix itself is smaller)
+static const int MIN_TILE = 64;
+
+OutOfCoreMultiplier::OutOfCoreMultiplier(std::size_t budget, int poolSize)
+    : memoryBudget(budget), executionTime(0), ioWaitTime(0), pool(poolSize) {
+    tiling.mc = tiling.nc = tiling.kc = 0;
+}
+
+static std::size_t tilingBytes(const OutOfCoreTiling& t, std::size_t elementSize,
+                               std::size_t accumulatorSize) {
+    std::size_t mc = t.mc, nc = t.nc, kc = t.kc;
+    return accumulatorSize * mc * nc + 2 * elementSize * (mc * kc + kc * nc);
+}
+
+OutOfCoreTiling OutOfCoreMultiplier::chooseTiling(int M, int K, int N, std::size_t elementSize,
+                                                  std::size_t accumulatorSize,
+                                                  std::size_t memoryBudget) {
+    OutOfCoreTiling t;
+    t.mc = std::max(M, 1);
+    t.nc = std::max(N, 1);
+    t.kc = std::max(K, 1);
+
+    // Halve the largest dimension until everything fits
+    while (tilingBytes(t, elementSize, accumulatorSize) > memoryBudget) {
+        int* largest = &t.mc;
+        if (t.nc > *largest) largest = &t.nc;
+        if (t.kc > *largest) largest = &t.kc;
+        if (*largest <= MIN_TILE) {
+            throw std::invalid_argument("Memory budget too small for out-of-core tiles");
+        }
+        *largest = std::max(MIN_TILE, (*largest + 1) / 2);
+    }
+    return t;
+}
+
+// A and B k-panels of one step, filled by the loader and consumed by the pool
+template <typename T>
+struct PanelSlot {
+    BasicMatrix<T> a;
+    BasicMatrix<T> b;
+    bool full;
+};
+
+// Steps run tile by tile, k-panel by k-panel; both threads walk the same order
+struct OutOfCoreStep {
+    int row, col, k;
+    int rows, cols, depth;
+};
+
+static OutOfCoreStep stepAt(long long s, int M, int K, int N, const OutOfCoreTiling& t) {
+    long long panels = (K + t.kc - 1) / t.kc;
+    long long colTiles = (N + t.nc - 1) / t.nc;
+    long long tile = s / panels;
+
+    OutOfCoreStep step;
+    step.row = static_cast<int>(tile / colTiles) * t.mc;
+    step.col = static_cast<int>(tile % colTiles) * t.nc;
+    step.k = static_cast<int>(s % panels) * t.kc;
+    step.rows = std::min(t.mc, M - step.row);
+    step.cols = std::min(t.nc, N - step.col);
+    step.depth = std::min(t.kc, K - step.k);
+    return step;
+}
+
+// Double buffer shared between the loader thread and the compute side
+template <typename T>
+struct PanelPipeline {
+    const MatrixFileBlocks<T>* fileA;
+    const MatrixFileBlocks<T>* fileB;
+    OutOfCoreTiling tiling;
+    long long steps;
+
+    PanelSlot<T> slots[2];
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    bool aborted;
+    std::exception_ptr error;
+
+    static void* loaderMain(void* arg);
+    void load();
+};
+
+template <typename T>
+void* PanelPipeline<T>::loaderMain(void* arg) {
+    static_cast<PanelPipeline<T>*>(arg)->load();
+    return nullptr;
+}
+
+template <typename T>
+void PanelPipeline<T>::load() {
+    int M = fileA->getRows();
+    int K = fileA->getCols();
+    int N = fileB->getCols();
+
+    try {
+        for (long long s = 0; s < steps; ++s) {
+            PanelSlot<T>& slot = slots[s % 2];
+
+            pthread_mutex_lock(&mutex);
+            while (slot.full && !aborted) {
+                pthread_cond_wait(&changed, &mutex);
+            }
+            bool stop = aborted;
+            pthread_mutex_unlock(&mutex);
+            if (stop) {
+                return;
+            }
+
+            // The slot is ours until it is marked full
+            OutOfCoreStep step = stepAt(s, M, K, N, tiling);
+            fileA->readBlock(step.row, step.k, slot.a.block(0, 0, step.rows, step.depth));
+            fileB->readBlock(step.k, step.col, slot.b.block(0, 0, step.depth, step.cols));
+            if (s + 1 < steps) {
+                OutOfCoreStep next = stepAt(s + 1, M, K, N, tiling);
+                fileB->adviseRows(next.k, next.k + next.depth);
+            }
+
+            pthread_mutex_lock(&mutex);
+            slot.full = true;
+            pthread_cond_broadcast(&changed);
+            pthread_mutex_unlock(&mutex);
+        }
+    }
+    catch (...) {
+        pthread_mutex_lock(&mutex);
+        error = std::current_exception();
+        aborted = true;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+template <typename T, typename Acc>
+void OutOfCoreMultiplier::multiply(const std::string& pathA, const std::string& pathB,
+                                   const std::string& pathC) {
+    MatrixFileBlocks<T> fileA = MatrixFileBlocks<T>::open(pathA);
+    MatrixFileBlocks<T> fileB = MatrixFileBlocks<T>::open(pathB);
+    if (fileA.getCols() != fileB.getRows()) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+
+    int M = fileA.getRows();
+    int K = fileA.getCols();
+    int N = fileB.getCols();
+    tiling = chooseTiling(M, K, N, sizeof(T), sizeof(Acc), memoryBudget);
+    MatrixFileBlocks<Acc> fileC = MatrixFileBlocks<Acc>::create(pathC, M, N);
+
+    executionTime = 0;
+    ioWaitTime = 0;
+    if (M == 0 || N == 0 || K == 0) {
+        // C was created zero-filled
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    long long panels = (K + tiling.kc - 1) / tiling.kc;
+    long long tiles = static_cast<long long>((M + tiling.mc - 1) / tiling.mc) *
+                      ((N + tiling.nc - 1) / tiling.nc);
+
+    PanelPipeline<T> pipeline;
+    pipeline.fileA = &fileA;
+    pipeline.fileB = &fileB;
+    pipeline.tiling = tiling;
+    pipeline.steps = tiles * panels;
+    pipeline.aborted = false;
+    for (PanelSlot<T>& slot : pipeline.slots) {
+        slot.a = BasicMatrix<T>(tiling.mc, tiling.kc);
+        slot.b = BasicMatrix<T>(tiling.kc, tiling.nc);
+        slot.full = false;
+    }
+    BasicMatrix<Acc> tileC(tiling.mc, tiling.nc);
+
+    pthread_mutex_init(&pipeline.mutex, nullptr);
+    pthread_cond_init(&pipeline.changed, nullptr);
+
+    pthread_t loader;
+    if (pthread_create(&loader, nullptr, PanelPipeline<T>::loaderMain, &pipeline) != 0) {
+        pthread_cond_destroy(&pipeline.changed);
+        pthread_mutex_destroy(&pipeline.mutex);
+        throw std::runtime_error("Failed to create thread");
+    }
+
+    std::exception_ptr thrown;
+    try {
+        for (long long s = 0; s < pipeline.steps; ++s) {
+            PanelSlot<T>& slot = pipeline.slots[s % 2];
+
+            auto waitStart = std::chrono::high_resolution_clock::now();
+            pthread_mutex_lock(&pipeline.mutex);
+            while (!slot.full && !pipeline.aborted) {
+                pthread_cond_wait(&pipeline.changed, &pipeline.mutex);
+            }
+            std::exception_ptr loadError = pipeline.error;
+            pthread_mutex_unlock(&pipeline.mutex);
+            auto waitEnd = std::chrono::high_resolution_clock::now();
+            ioWaitTime +=
+                std::chrono::duration_cast<std::chrono::microseconds>(waitEnd - waitStart).count();
+            if (loadError) {
+                std::rethrow_exception(loadError);
+            }
+
+            OutOfCoreStep step = stepAt(s, M, K, N, tiling);
+            BasicMatrixView<const T> a = slot.a.block(0, 0, step.rows, step.depth);
+            BasicMatrixView<const T> b = slot.b.block(0, 0, step.depth, step.cols);
+            BasicMatrixView<Acc> c = tileC.block(0, 0, step.rows, step.cols);
+            bool accumulate = step.k > 0;
+
+            // Rows of the tile are split across the pool
+            int workers = std::min(pool.size(), (step.rows + 15) / 16);
+            pool.run(workers, [&](int worker) {
+                int begin = static_cast<int>(static_cast<long long>(step.rows) * worker / workers);
+                int end = static_cast<int>(static_cast<long long>(step.rows) * (worker + 1) / workers);
+                gemm<T, Acc>(a.rowRange(begin, end), b, c.rowRange(begin, end), accumulate);
+            });
+
+            // Hand the slot back so the loader can refill it
+            pthread_mutex_lock(&pipeline.mutex);
+            slot.full = false;
+            pthread_cond_broadcast(&pipeline.changed);
+            pthread_mutex_unlock(&pipeline.mutex);
+
+            if (step.k + step.depth == K) {
+                fileC.writeBlock(step.row, step.col, BasicMatrixView<const Acc>(c));
+            }
+        }
+    }
+    catch (...) {
+        thrown = std::current_exception();
+        pthread_mutex_lock(&pipeline.mutex);
+        pipeline.aborted = true;
+        pthread_cond_broadcast(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.mutex);
+    }
+
+    pthread_join(loader, nullptr);
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.mutex);
+    if (thrown) {
+        std::rethrow_exception(thrown);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+long long OutOfCoreMultiplier::getLastExecutionTime() const {
+    return executionTime;
+}
+
+long long OutOfCoreMultiplier::getLastIoWaitTime() const {
+    return ioWaitTime;
+}
+
+OutOfCoreTiling OutOfCoreMultiplier::getLastTiling() const {
+    return tiling;
+}
+
+#define INSTANTIATE_OUT_OF_CORE(T, Acc)                                                     \
+    template void OutOfCoreMultiplier::multiply<T, Acc>(const std::string&, const std::string&, \
+                                                        const std::string&);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_OUT_OF_CORE)
+#undef INSTANTIATE_OUT_OF_CORE
@@ -0,0 +1,54 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <string>
+
+// Shape of the in-memory tiles of an out-of-core multiply:
+// C is produced in mc x nc tiles, each accumulated over kc-wide panels of A and B.
+struct OutOfCoreTiling {
+    int mc;
+    int nc;
+    int kc;
+};
+
+// C = A * B for matrix files (see MatrixFile.h) that need not fit in memory.
+// C is computed one tile at a time. For each tile a loader thread reads the
+// next A and B k-panels from disk into the spare half of a double buffer
+// while the pool multiplies the current ones, so that I/O overlaps compute.
+// A finished tile is written straight back to the C file.
+// All buffers together stay within the memory budget.
+class OutOfCoreMultiplier {
+private:
+    std::size_t memoryBudget;
+    long long executionTime;
+    long long ioWaitTime;
+    OutOfCoreTiling tiling;
+
+    ThreadPool pool;
+
+public:
+    // memoryBudget in bytes; poolSize <= 0 means one worker per hardware thread
+    explicit OutOfCoreMultiplier(std::size_t memoryBudget, int poolSize = 0);
+
+    // Largest tiles (mc x nc of Acc plus two A and two B panels of T) that fit the
+    // budget; throws std::invalid_argument if not even 64 x 64 x 64 tiles fit
+    static OutOfCoreTiling chooseTiling(int M, int K, int N, std::size_t elementSize,
+                                        std::size_t accumulatorSize, std::size_t memoryBudget);
+
+    // Reads A (M x K of T) and B (K x N of T) and writes C (M x N of Acc), replacing
+    // any existing file. Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    void multiply(const std::string& pathA, const std::string& pathB, const std::string& pathC);
+
+    long long getLastExecutionTime() const;
+
+    // Time the compute side spent waiting for panels during the last multiply
+    long long getLastIoWaitTime() const;
+
+    OutOfCoreTiling getLastTiling() const;
+};
+
+#endif // OUT_OF_CORE_H
@@ -1,153 +1,826 @@
 #include "PThreadMultiplier.h"
+#include "Gemm.h"
+#include "Strassen.h"
+#include "Autotuner.h"
 #include <iostream>
+#include <sstream>
 #include <chrono>
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <cstring>
 #include <thread>
 
-PThreadMultiplier::PThreadMultiplier() : executionTime(0), threadCount(0) {}
+// Holds a mutex for the lifetime of a scope
+class MutexLock {
+private:
+    pthread_mutex_t* mutex;
 
-PThreadMultiplier::~PThreadMultiplier() {}
+public:
+    explicit MutexLock(pthread_mutex_t& m) : mutex(&m) { pthread_mutex_lock(mutex); }
+    ~MutexLock() { pthread_mutex_unlock(mutex); }
 
-void PThreadMultiplier::computeBlock(const Matrix& A, const Matrix& B, Matrix& C,
-                                     int rowBlock, int colBlock, int blockSize, int N,
-                                     pthread_mutex_t* writeMutex) {
+    MutexLock(const MutexLock&) = delete;
+    MutexLock& operator=(const MutexLock&) = delete;
+};
+
+PThreadMultiplier::PThreadMultiplier(int poolSize)
+    : executionTime(0), threadCount(0), kSplits(1), blockSizeUsed(0), maxThreads(0),
+      pool(poolSize), lastReplicatedB(false), activeToken(nullptr),
+      asyncStarted(false), asyncStopping(false) {
+    // Recursive: a background job holds it and then calls multiply()
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&jobMutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&asyncMutex, nullptr);
+    pthread_cond_init(&asyncCond, nullptr);
+}
+
+PThreadMultiplier::~PThreadMultiplier() {
+    if (asyncStarted) {
+        pthread_mutex_lock(&asyncMutex);
+        asyncStopping = true;
+        for (AsyncEntry& entry : asyncQueue) {
+            entry.state->token.cancel();
+        }
+        if (asyncRunning) {
+            asyncRunning->token.cancel();
+        }
+        pthread_cond_signal(&asyncCond);
+        pthread_mutex_unlock(&asyncMutex);
+        pthread_join(asyncThread, nullptr);
+    }
+    pthread_cond_destroy(&asyncCond);
+    pthread_mutex_destroy(&asyncMutex);
+    pthread_mutex_destroy(&jobMutex);
+}
+
+template <typename T, typename Acc>
+void PThreadMultiplier::computeBlock(MatrixOp opA, const BasicMatrixView<const T>& A,
+                                     MatrixOp opB, const BasicMatrixView<const T>& B,
+                                     const BasicMatrixView<Acc>& C,
+                                     int rowBlock, int colBlock, int blockSize,
+                                     int kBegin, int kEnd,
+                                     Acc alpha, Acc beta, const GemmEpilogue<Acc>* epilogue) {
     int rowStart = rowBlock * blockSize;
     int colStart = colBlock * blockSize;
-    int rowEnd = std::min(rowStart + blockSize, N);
-    int colEnd = std::min(colStart + blockSize, N);
+    int rows = std::min(rowStart + blockSize, C.rows) - rowStart;
+    int cols = std::min(colStart + blockSize, C.cols) - colStart;
+    int depth = kEnd - kBegin;
     
-    int numBlocks = (N + blockSize - 1) / blockSize;
+    // Tiles of C are disjoint, so each worker writes its own tile in place
+    // without any lock. The packed kernel does its own cache-sized k-blocking
+    // and reads transposed operands along their stored rows.
+    gemm<T, Acc>(opA, opA == MatrixOp::Normal ? A.block(rowStart, kBegin, rows, depth)
+                                              : A.block(kBegin, rowStart, depth, rows),
+                 opB, opB == MatrixOp::Normal ? B.block(kBegin, colStart, depth, cols)
+                                              : B.block(colStart, kBegin, cols, depth),
+                 C.block(rowStart, colStart, rows, cols),
+                 alpha, beta,
+                 epilogue != nullptr ? epilogue->shifted(rowStart, colStart) : GemmEpilogue<Acc>());
+}
+
+template <typename T, typename Acc>
+void PThreadMultiplier::threadFunction(ThreadData<T, Acc>* data, int worker) {
+    const BasicMatrixView<const T>& A = data->A;
+    int blockSize = data->blockSize;
+    int colBlocks = data->colBlocks;
+    int K = data->opA == MatrixOp::Normal ? A.cols : A.rows;
     
-    std::vector<std::vector<int>> tempBlock(rowEnd - rowStart, 
-                                            std::vector<int>(colEnd - colStart, 0));
+    // Own node's band first, then help the other nodes
+    std::vector<TileBand>& bands = *data->bands;
+    int nodes = static_cast<int>(bands.size());
+    int home = nodes > 1 ? (*data->workerNode)[worker] : 0;
+    const BasicMatrixView<const T>& B = data->B[home];
     
-    for (int kBlock = 0; kBlock < numBlocks; ++kBlock) {
-        int kStart = kBlock * blockSize;
-        int kEnd = std::min(kStart + blockSize, N);
+    for (int b = 0; b < nodes; ++b) {
+        TileBand& band = bands[(home + b) % nodes];
+        int tiles = (band.rowBlockEnd - band.rowBlockBegin) * colBlocks;
+        int totalTasks = tiles * data->kSplits;
         
-        for (int i = rowStart; i < rowEnd; ++i) {
-            for (int k = kStart; k < kEnd; ++k) {
-                int aik = A(i, k);
-                for (int j = colStart; j < colEnd; ++j) {
-                    tempBlock[i - rowStart][j - colStart] += aik * B(k, j);
-                }
+        while (true) {
+            // A stopped job leaves its remaining tiles to nobody
+            if (data->token != nullptr && data->token->stopRequested()) {
+                data->stopped.store(true, std::memory_order_relaxed);
+                return;
+            }
+            
+            // Claiming a task is a single atomic increment; no lock is taken
+            int taskIdx = band.next.fetch_add(1, std::memory_order_relaxed);
+            if (taskIdx >= totalTasks) {
+                break;
+            }
+            
+            int kSlice = taskIdx / tiles;
+            int blockIdx = taskIdx % tiles;
+            int rowBlock = band.rowBlockBegin + blockIdx / colBlocks;
+            int colBlock = blockIdx % colBlocks;
+            int kBegin = std::min(kSlice * data->kChunk, K);
+            int kEnd = std::min(kBegin + data->kChunk, K);
+            
+            // Slice 0 goes straight to the result and applies beta, the others to
+            // their partial sums; the epilogue waits for the reduction if K is split
+            if (kSlice == 0) {
+                computeBlock(data->opA, A, data->opB, B, data->C, rowBlock, colBlock, blockSize, kBegin, kEnd,
+                             data->alpha, data->beta,
+                             data->kSplits == 1 ? data->epilogue : nullptr);
+            }
+            else {
+                computeBlock(data->opA, A, data->opB, B, (*data->partials)[kSlice - 1].view(),
+                             rowBlock, colBlock,
+                             blockSize, kBegin, kEnd, data->alpha, Acc(0),
+                             static_cast<const GemmEpilogue<Acc>*>(nullptr));
             }
         }
     }
+}
+
+// Adds the partial products of K-slices 1..n-1 into C, rows split across
+// workers, and applies the epilogue to each row once it is complete
+template <typename Acc>
+void PThreadMultiplier::reducePartials(const BasicMatrixView<Acc>& C,
+                                       const std::vector<BasicMatrix<Acc>>& partials,
+                                       const GemmEpilogue<Acc>* epilogue,
+                                       int worker, int workers) {
+    int M = C.rows;
+    int N = C.cols;
+    int rowBegin = static_cast<int>(static_cast<long long>(M) * worker / workers);
+    int rowEnd = static_cast<int>(static_cast<long long>(M) * (worker + 1) / workers);
     
-    pthread_mutex_lock(writeMutex);
-    for (int i = rowStart; i < rowEnd; ++i) {
-        for (int j = colStart; j < colEnd; ++j) {
-            C(i, j) = tempBlock[i - rowStart][j - colStart];
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        Acc* c = C.rowPtr(i);
+        for (const BasicMatrix<Acc>& P : partials) {
+            const Acc* p = P.rowPtr(i);
+            for (int j = 0; j < N; ++j) {
+                c[j] += p[j];
+            }
+        }
+        if (epilogue != nullptr) {
+            epilogue->apply(C.block(i, 0, 1, N), i, 0);
         }
     }
-    pthread_mutex_unlock(writeMutex);
 }
 
-void* PThreadMultiplier::threadFunction(void* arg) {
-    ThreadData* data = static_cast<ThreadData*>(arg);
-    const Matrix& A = *(data->A);
-    const Matrix& B = *(data->B);
-    Matrix& C = *(data->C);
-    int blockSize = data->blockSize;
-    int N = data->N;
-    int numBlocks = data->numBlocks;
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiply(const BasicMatrix<T>& A, const BasicMatrix<T>& B,
+                                             int blockSize) {
+    return multiply<T, Acc>(A.view(), B.view(), blockSize);
+}
+
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiply(const BasicMatrixView<const T>& A,
+                                             const BasicMatrixView<const T>& B, int blockSize) {
+    return multiply<T, Acc>(MatrixOp::Normal, A, MatrixOp::Normal, B, blockSize);
+}
+
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiply(MatrixOp opA, const BasicMatrix<T>& A,
+                                             MatrixOp opB, const BasicMatrix<T>& B,
+                                             int blockSize) {
+    return multiply<T, Acc>(opA, A.view(), opB, B.view(), blockSize);
+}
+
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiply(MatrixOp opA, const BasicMatrixView<const T>& A,
+                                             MatrixOp opB, const BasicMatrixView<const T>& B,
+                                             int blockSize) {
+    MutexLock lock(jobMutex);
+    int M = opA == MatrixOp::Normal ? A.rows : A.cols;
+    int K = opA == MatrixOp::Normal ? A.cols : A.rows;
+    int N = opB == MatrixOp::Normal ? B.cols : B.rows;
+    if ((opB == MatrixOp::Normal ? B.rows : B.cols) != K) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+
+    if (blockSize < 0) {
+        throw std::invalid_argument("Block size must not be negative");
+    }
+
+    // With numaTiles, C is left untouched at allocation and first written by the
+    // workers of the node that owns each band
+    BasicMatrix<Acc> result = placement.numaTiles ? BasicMatrix<Acc>::uninitialized(M, N)
+                                                  : BasicMatrix<Acc>(M, N);
+    multiplyTiles<T, Acc>(opA, A, opB, B, result.view(), Acc(1), Acc(0), nullptr, blockSize,
+                          placement.numaTiles);
+    return result;
+}
+
+template <typename T, typename Acc>
+void PThreadMultiplier::multiplyInto(const BasicMatrixView<const T>& A,
+                                     const BasicMatrixView<const T>& B,
+                                     const BasicMatrixView<Acc>& C, Acc alpha, Acc beta,
+                                     const GemmEpilogue<Acc>& epilogue, int blockSize) {
+    if (A.cols != B.rows || C.rows != A.rows || C.cols != B.cols) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+
+    if (blockSize < 0) {
+        throw std::invalid_argument("Block size must not be negative");
+    }
+
+    multiplyTiles<T, Acc>(MatrixOp::Normal, A, MatrixOp::Normal, B, C, alpha, beta, epilogue.empty() ? nullptr : &epilogue,
+                          blockSize, false);
+}
+
+template <typename T, typename Acc>
+void PThreadMultiplier::multiplyTiles(MatrixOp opA, const BasicMatrixView<const T>& A,
+                                      MatrixOp opB, const BasicMatrixView<const T>& B,
+                                      const BasicMatrixView<Acc>& result, Acc alpha, Acc beta,
+                                      const GemmEpilogue<Acc>* epilogue, int blockSize,
+                                      bool firstTouch) {
+    MutexLock lock(jobMutex);
+    int M = result.rows;
+    int K = opA == MatrixOp::Normal ? A.cols : A.rows;
+    int N = result.cols;
+    int workers = maxThreads > 0 ? std::min(maxThreads, pool.size()) : pool.size();
+
+    if (blockSize == 0) {
+        TuningEntry tuned;
+        if (TuningProfile::defaultProfile().find(tuningDTypeName<T, Acc>(), M, K, N, tuned)) {
+            blockSize = tuned.blockSize;
+            if (maxThreads <= 0) {
+                workers = std::max(1, std::min(tuned.threads, pool.size()));
+            }
+        }
+        else {
+            // Untuned: the largest power of two that still gives each worker ~4 tiles
+            blockSize = 256;
+            while (blockSize > 32 &&
+                   static_cast<long long>((M + blockSize - 1) / blockSize) *
+                       ((N + blockSize - 1) / blockSize) < 4LL * workers) {
+                blockSize /= 2;
+            }
+        }
+    }
+    blockSizeUsed = blockSize;
+
+    int rowBlocks = (M + blockSize - 1) / blockSize;
+    int colBlocks = (N + blockSize - 1) / blockSize;
+    int tiles = rowBlocks * colBlocks;
     
-    int blockIdx;
-    while (true) {
-        pthread_mutex_lock(data->mutex);
-        blockIdx = *(data->nextBlock);
-        *(data->nextBlock) = blockIdx + 1;
-        pthread_mutex_unlock(data->mutex);
-        
-        if (blockIdx >= numBlocks * numBlocks) {
-            break;
+    if (tiles == 0) {
+        threadCount = 0;
+        kSplits = 1;
+        executionTime = 0;
+        lastCounters = PerfStats();
+        return;
+    }
+    
+    // 2D (M, N) tiling while there are enough tiles to feed every worker.
+    // Otherwise (tall-skinny / short-wide results) K is split as well and the
+    // slices are summed afterwards; a slice is never shorter than one KC panel.
+    kSplits = 1;
+    if (tiles < workers) {
+        int wanted = (workers + tiles - 1) / tiles;
+        kSplits = std::max(1, std::min(wanted, K / GemmBlocking::KC));
+    }
+    int kChunk = std::max(1, (K + kSplits - 1) / kSplits);
+    
+    int totalTasks = tiles * kSplits;
+    
+    // Never wake more workers than there are tasks
+    threadCount = std::min(totalTasks, workers);
+    
+    // Tile rows are split over the nodes in proportion to the workers each one
+    // contributes; without numaTiles there is one band covering everything
+    int nodes = placement.numaTiles ? topology.nodeCount() : 1;
+    std::vector<int> nodeWorkers(nodes, 0);
+    for (int w = 0; w < threadCount; ++w) {
+        ++nodeWorkers[nodes > 1 ? workerPlacement.node[w] : 0];
+    }
+    std::vector<TileBand> bands(nodes);
+    int assignedWorkers = 0;
+    for (int n = 0; n < nodes; ++n) {
+        bands[n].rowBlockBegin = rowBlocks * assignedWorkers / threadCount;
+        assignedWorkers += nodeWorkers[n];
+        bands[n].rowBlockEnd = rowBlocks * assignedWorkers / threadCount;
+        bands[n].next.store(0, std::memory_order_relaxed);
+    }
+    bool replicate = placement.replicateB && nodes > 1;
+    
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    std::vector<BasicMatrix<Acc>> partials;
+    for (int s = 1; s < kSplits; ++s) {
+        partials.push_back(BasicMatrix<Acc>(M, N));
+    }
+    
+    // Every worker shares the same job description and pulls tasks from the bands
+    ThreadData<T, Acc> threadData;
+    threadData.opA = opA;
+    threadData.opB = opB;
+    threadData.A = A;
+    threadData.B.assign(nodes, B);
+    threadData.C = result;
+    threadData.partials = &partials;
+    threadData.alpha = alpha;
+    threadData.beta = beta;
+    threadData.epilogue = epilogue;
+    threadData.blockSize = blockSize;
+    threadData.rowBlocks = rowBlocks;
+    threadData.colBlocks = colBlocks;
+    threadData.kSplits = kSplits;
+    threadData.kChunk = kChunk;
+    threadData.bands = &bands;
+    threadData.workerNode = &workerPlacement.node;
+    threadData.token = activeToken;
+    threadData.stopped.store(false, std::memory_order_relaxed);
+    
+    std::vector<BasicMatrix<T>> replicas;
+    if (placement.numaTiles) {
+        // First touch of C's bands (when C is new) and of the copies of B, on
+        // their own nodes
+        if (replicate) {
+            for (int n = 0; n < nodes; ++n) {
+                replicas.push_back(BasicMatrix<T>::uninitialized(B.rows, B.cols));
+                threadData.B[n] = replicas[n].view();
+            }
         }
         
-        int rowBlock = blockIdx / numBlocks;
-        int colBlock = blockIdx % numBlocks;
-        
-        computeBlock(A, B, C, rowBlock, colBlock, blockSize, N, data->mutex);
+        pool.run(threadCount, [&](int worker) {
+            int node = nodes > 1 ? workerPlacement.node[worker] : 0;
+            int rank = 0;
+            for (int w = 0; w < worker; ++w) {
+                if ((nodes > 1 ? workerPlacement.node[w] : 0) == node) ++rank;
+            }
+            int count = nodeWorkers[node];
+            
+            int rowBegin = std::min(M, bands[node].rowBlockBegin * blockSize);
+            int rowEnd = std::min(M, bands[node].rowBlockEnd * blockSize);
+            if (firstTouch) {
+                int touchBegin = rowBegin + (rowEnd - rowBegin) * rank / count;
+                int touchEnd = rowBegin + (rowEnd - rowBegin) * (rank + 1) / count;
+                // A fresh matrix is contiguous, padding included (see zeroRows)
+                std::fill(result.rowPtr(touchBegin), result.rowPtr(touchEnd), Acc(0));
+            }
+            
+            if (replicate) {
+                BasicMatrix<T>& copy = replicas[node];
+                int copyBegin = static_cast<int>(static_cast<long long>(B.rows) * rank / count);
+                int copyEnd = static_cast<int>(static_cast<long long>(B.rows) * (rank + 1) / count);
+                copy.zeroRows(copyBegin, copyEnd);
+                for (int k = copyBegin; k < copyEnd; ++k) {
+                    std::copy(B.rowPtr(k), B.rowPtr(k) + B.cols, copy.rowPtr(k));
+                }
+            }
+        });
     }
     
-    return nullptr;
+    lastBandRows.assign(nodes, 0);
+    for (int n = 0; n < nodes; ++n) {
+        lastBandRows[n] = std::min(M, bands[n].rowBlockEnd * blockSize) -
+                          std::min(M, bands[n].rowBlockBegin * blockSize);
+    }
+    lastReplicatedB = replicate;
+    
+    pool.run(threadCount, [&threadData](int worker) { threadFunction<T, Acc>(&threadData, worker); });
+    
+    if (threadData.stopped.load(std::memory_order_relaxed)) {
+        // Tiles are missing, so the result is useless; partials go with the stack
+        auto end = std::chrono::high_resolution_clock::now();
+        stopCounters();
+        executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        throw JobAborted(activeToken->check() == JobStatus::DeadlineExceeded
+                             ? JobStatus::DeadlineExceeded : JobStatus::Cancelled);
+    }
+    
+    if (!partials.empty()) {
+        int reducers = std::min(M, workers);
+        pool.run(reducers, [&](int worker) {
+            reducePartials(result, partials, epilogue, worker, reducers);
+        });
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 }
 
-Matrix PThreadMultiplier::multiply(const Matrix& A, const Matrix& B, int blockSize) {
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiplyStrassen(const BasicMatrix<T>& A,
+                                                     const BasicMatrix<T>& B, int cutoff) {
+    MutexLock lock(jobMutex);
     if (A.getCols() != B.getRows()) {
         throw std::invalid_argument("Incompatible matrix sizes");
     }
+    
+    BasicMatrix<Acc> result(A.getRows(), B.getCols());
+    
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    BasicMatrix<Acc> wideA, wideB;
+    strassenMultiply<Acc>(widened(A, wideA), widened(B, wideB), result.view(), cutoff, &pool);
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = pool.size();
+    kSplits = 1;
+    
+    return result;
+}
 
-    if (blockSize <= 0) {
-        throw std::invalid_argument("Block size must be positive");
-    }
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiplySparse(const BasicSparseMatrix<T>& A,
+                                                   const BasicMatrix<T>& B) {
+    MutexLock lock(jobMutex);
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    BasicMatrix<Acc> result = sparseDenseMultiply<T, Acc>(A, B, &pool);
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = pool.size();
+    kSplits = 1;
+    
+    return result;
+}
+
+template <typename T, typename Acc>
+BasicSparseMatrix<Acc> PThreadMultiplier::multiplySparse(const BasicSparseMatrix<T>& A,
+                                                         const BasicSparseMatrix<T>& B) {
+    MutexLock lock(jobMutex);
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    BasicSparseMatrix<Acc> result = sparseSparseMultiply<T, Acc>(A, B, &pool);
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = pool.size();
+    kSplits = 1;
+    
+    return result;
+}
 
-    int N = A.getRows();
-    if (B.getCols() != N || A.getCols() != N) {
-        throw std::invalid_argument("Matrices must be square");
+// One vector as a 1 x n view of its elements
+template <typename T>
+static BasicMatrixView<const T> vectorView(const std::vector<T>& v) {
+    int n = static_cast<int>(v.size());
+    return BasicMatrixView<const T>(v.data(), 1, n, n);
+}
+
+template <typename T, typename Acc>
+std::vector<Acc> PThreadMultiplier::multiplyVector(const BasicMatrix<T>& A,
+                                                   const std::vector<T>& x) {
+    MutexLock lock(jobMutex);
+    if (x.size() != static_cast<size_t>(A.getCols())) {
+        throw std::invalid_argument("Incompatible matrix and vector sizes");
     }
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    std::vector<Acc> y(A.getRows());
+    matVec<T, Acc>(A.view(), vectorView(x), BasicMatrixView<Acc>(y.data(), 1, A.getRows(), A.getRows()),
+                   &pool, maxThreads);
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = maxThreads > 0 ? std::min(maxThreads, pool.size()) : pool.size();
+    kSplits = 1;
+    
+    return y;
+}
 
-    int numBlocks = (N + blockSize - 1) / blockSize;
-    int totalBlocks = numBlocks * numBlocks;
+template <typename T, typename Acc>
+std::vector<Acc> PThreadMultiplier::multiplyVector(const std::vector<T>& x,
+                                                   const BasicMatrix<T>& A) {
+    MutexLock lock(jobMutex);
+    if (x.size() != static_cast<size_t>(A.getRows())) {
+        throw std::invalid_argument("Incompatible matrix and vector sizes");
+    }
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    std::vector<Acc> y(A.getCols());
+    vecMat<T, Acc>(vectorView(x), A.view(), BasicMatrixView<Acc>(y.data(), 1, A.getCols(), A.getCols()),
+                   &pool, maxThreads);
     
-    Matrix result(N, N);
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = maxThreads > 0 ? std::min(maxThreads, pool.size()) : pool.size();
+    kSplits = 1;
+    
+    return y;
+}
+
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiplyVectors(const BasicMatrix<T>& A,
+                                                    const BasicMatrix<T>& X) {
+    MutexLock lock(jobMutex);
+    if (X.getCols() != A.getCols()) {
+        throw std::invalid_argument("Incompatible matrix and vector sizes");
+    }
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
     
-    threadCount = totalBlocks;  
+    BasicMatrix<Acc> Y(X.getRows(), A.getRows());
+    matVec<T, Acc>(A.view(), X.view(), Y.view(), &pool, maxThreads);
     
-    unsigned int maxThreads = std::thread::hardware_concurrency() * 2;
-    if (maxThreads == 0) maxThreads = 8;
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = maxThreads > 0 ? std::min(maxThreads, pool.size()) : pool.size();
+    kSplits = 1;
     
-    if (threadCount > maxThreads) {
-        threadCount = maxThreads;
+    return Y;
+}
+
+template <typename T, typename Acc>
+BasicMatrix<Acc> PThreadMultiplier::multiplyVectorsLeft(const BasicMatrix<T>& X,
+                                                        const BasicMatrix<T>& A) {
+    MutexLock lock(jobMutex);
+    if (X.getCols() != A.getRows()) {
+        throw std::invalid_argument("Incompatible matrix and vector sizes");
     }
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    BasicMatrix<Acc> Y(X.getRows(), A.getCols());
+    vecMat<T, Acc>(X.view(), A.view(), Y.view(), &pool, maxThreads);
     
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = maxThreads > 0 ? std::min(maxThreads, pool.size()) : pool.size();
+    kSplits = 1;
+    
+    return Y;
+}
+
+template <typename T, typename Acc>
+void PThreadMultiplier::multiplyBatched(const StridedBatch<const T>& A,
+                                        const StridedBatch<const T>& B, const StridedBatch<Acc>& C) {
+    MutexLock lock(jobMutex);
+    startCounters();
     auto start = std::chrono::high_resolution_clock::now();
     
-    pthread_mutex_t mutex;
-    if (pthread_mutex_init(&mutex, nullptr) != 0) {
-        throw std::runtime_error("Failed to initialize mutex");
+    batchedMultiply<T, Acc>(A, B, C, &pool);
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = pool.size();
+    kSplits = 1;
+}
+
+template <typename T, typename Acc>
+BasicMortonMatrix<Acc> PThreadMultiplier::multiplyMorton(const BasicMortonMatrix<T>& A,
+                                                         const BasicMortonMatrix<T>& B) {
+    MutexLock lock(jobMutex);
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    BasicMortonMatrix<Acc> result = mortonMultiply<T, Acc>(A, B, &pool);
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = pool.size();
+    kSplits = 1;
+    blockSizeUsed = MORTON_TILE;
+    
+    return result;
+}
+
+template <typename T>
+BasicMatrix<T> PThreadMultiplier::evaluate(BasicMatrixGraph<T>& graph, int root) {
+    MutexLock lock(jobMutex);
+    int workers = maxThreads > 0 ? std::min(maxThreads, pool.size()) : pool.size();
+    startCounters();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    BasicMatrix<T> result = graph.evaluate(root, &pool, workers);
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stopCounters();
+    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    threadCount = std::min(workers, graph.getLastTaskCount());
+    kSplits = 1;
+    blockSizeUsed = graph.getLastTileSize();
+    
+    return result;
+}
+
+template <typename T, typename Acc>
+MultiplyHandle<Acc> PThreadMultiplier::multiplyAsync(BasicMatrix<T> A, BasicMatrix<T> B,
+                                                     int blockSize, long long timeoutMs) {
+    if (A.getCols() != B.getRows()) {
+        throw std::invalid_argument("Incompatible matrix sizes");
+    }
+    if (blockSize < 0) {
+        throw std::invalid_argument("Block size must not be negative");
     }
     
-    int nextBlock = 0;
+    std::shared_ptr<AsyncMultiplyJob<Acc>> job = std::make_shared<AsyncMultiplyJob<Acc>>();
+    if (timeoutMs > 0) {
+        job->token.setDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs));
+    }
     
-    std::vector<ThreadData> threadData(threadCount);
-    std::vector<pthread_t> threads(threadCount);
+    // The operands live exactly as long as the job does; std::function needs a
+    // copyable callable, hence the shared_ptr
+    std::shared_ptr<std::pair<BasicMatrix<T>, BasicMatrix<T>>> operands =
+        std::make_shared<std::pair<BasicMatrix<T>, BasicMatrix<T>>>(std::move(A), std::move(B));
     
-    try {
-        for (int i = 0; i < threadCount; i++) {
-            threadData[i].A = &A;
-            threadData[i].B = &B;
-            threadData[i].C = &result;
-            threadData[i].blockSize = blockSize;
-            threadData[i].N = N;
-            threadData[i].numBlocks = numBlocks;
-            threadData[i].mutex = &mutex;
-            threadData[i].nextBlock = &nextBlock;
-            
-            if (pthread_create(&threads[i], nullptr, threadFunction, &threadData[i]) != 0) {
-                throw std::runtime_error("Failed to create thread");
-            }
+    AsyncMultiplyJob<Acc>* state = job.get();
+    submitAsync(job, [this, state, operands, blockSize]() {
+        JobStatus early = state->token.check();
+        if (early != JobStatus::Running) {
+            state->finish(early, 0);
+            return;
         }
+        state->markRunning();
         
-        for (int i = 0; i < threadCount; i++) {
-            if (pthread_join(threads[i], nullptr) != 0) {
-                throw std::runtime_error("Failed to join thread");
-            }
+        MutexLock lock(jobMutex);
+        activeToken = &state->token;
+        try {
+            BasicMatrix<Acc> result = multiply<T, Acc>(operands->first, operands->second, blockSize);
+            activeToken = nullptr;
+            state->result = std::move(result);
+            state->finish(JobStatus::Finished, executionTime);
         }
+        catch (const JobAborted& aborted) {
+            activeToken = nullptr;
+            state->finish(aborted.getReason(), executionTime);
+        }
+        catch (...) {
+            activeToken = nullptr;
+            state->finish(JobStatus::Failed, 0, std::current_exception());
+        }
+    });
+    return MultiplyHandle<Acc>(job);
+}
+
+void* PThreadMultiplier::asyncMain(void* arg) {
+    static_cast<PThreadMultiplier*>(arg)->asyncLoop();
+    return nullptr;
+}
+
+void PThreadMultiplier::asyncLoop() {
+    pthread_mutex_lock(&asyncMutex);
+    while (true) {
+        while (asyncQueue.empty() && !asyncStopping) {
+            pthread_cond_wait(&asyncCond, &asyncMutex);
+        }
+        if (asyncQueue.empty()) {
+            break;
+        }
+        
+        // Jobs still queued at shutdown were cancelled and finish at once
+        AsyncEntry entry = std::move(asyncQueue.front());
+        asyncQueue.pop_front();
+        asyncRunning = entry.state;
+        pthread_mutex_unlock(&asyncMutex);
+        
+        entry.run();
+        
+        pthread_mutex_lock(&asyncMutex);
+        asyncRunning.reset();
     }
-    catch (...) {
-        pthread_mutex_destroy(&mutex);
-        throw;
+    pthread_mutex_unlock(&asyncMutex);
+}
+
+void PThreadMultiplier::submitAsync(const std::shared_ptr<JobState>& state,
+                                    const std::function<void()>& run) {
+    MutexLock lock(asyncMutex);
+    if (!asyncStarted) {
+        if (pthread_create(&asyncThread, nullptr, asyncMain, this) != 0) {
+            throw std::runtime_error("Failed to start the background multiply thread");
+        }
+        asyncStarted = true;
     }
+    AsyncEntry entry;
+    entry.state = state;
+    entry.run = run;
+    asyncQueue.push_back(std::move(entry));
+    pthread_cond_signal(&asyncCond);
+}
+
+void PThreadMultiplier::startCounters() {
+    if (workerCounters.empty()) {
+        return;
+    }
+    pool.run(pool.size(), [this](int worker) { workerCounters[worker]->start(); });
+}
+
+void PThreadMultiplier::stopCounters() {
+    lastCounters = PerfStats();
+    if (workerCounters.empty()) {
+        return;
+    }
+    lastCounters.perThread.resize(pool.size());
+    pool.run(pool.size(), [this](int worker) {
+        lastCounters.perThread[worker] = workerCounters[worker]->stop();
+    });
+    for (const PerfCounts& counts : lastCounters.perThread) {
+        lastCounters.total += counts;
+    }
+}
+
+void PThreadMultiplier::setPlacement(const PlacementOptions& options) {
+    MutexLock lock(jobMutex);
+    topology = NumaTopology::detect();
+    workerPlacement = WorkerPlacement::spread(topology, pool.size());
     
-    pthread_mutex_destroy(&mutex);
+    // Pinned workers get one CPU each; unpinned ones may run on any allowed CPU
+    std::vector<int> allCpus;
+    for (const std::vector<int>& cpus : topology.nodeCpus) {
+        allCpus.insert(allCpus.end(), cpus.begin(), cpus.end());
+    }
+    std::vector<char> pinned(pool.size(), 0);
+    pool.run(pool.size(), [&](int worker) {
+        if (options.pinThreads) {
+            pinned[worker] = pinCurrentThread(std::vector<int>(1, workerPlacement.cpu[worker]));
+        }
+        else {
+            pinCurrentThread(allCpus);
+        }
+    });
+    workerPinned.assign(pinned.begin(), pinned.end());
     
-    auto end = std::chrono::high_resolution_clock::now();
-    executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    placement = options;
+    lastBandRows.clear();
+}
+
+std::string PThreadMultiplier::getPlacementReport() const {
+    std::ostringstream out;
+    if (topology.nodeCpus.empty()) {
+        out << "Default placement (setPlacement() not called)\n";
+        return out.str();
+    }
     
-    return result;
+    out << topology.nodeCount() << " NUMA node(s):";
+    for (int n = 0; n < topology.nodeCount(); ++n) {
+        out << " node" << topology.nodeIds[n] << "=" << topology.nodeCpus[n].size() << " CPUs";
+    }
+    out << "\n";
+    
+    for (int w = 0; w < pool.size(); ++w) {
+        out << "  worker " << w << ": node" << topology.nodeIds[workerPlacement.node[w]];
+        if (placement.pinThreads) {
+            out << (workerPinned[w] ? ", pinned to CPU " : ", pinning to CPU failed: ")
+                << workerPlacement.cpu[w];
+        }
+        else {
+            out << ", not pinned";
+        }
+        out << "\n";
+    }
+    
+    out << "Tiles split by node: " << (placement.numaTiles ? "yes" : "no") << "\n";
+    if (placement.numaTiles) {
+        for (size_t n = 0; n < lastBandRows.size(); ++n) {
+            out << "  node" << topology.nodeIds[n] << ": " << lastBandRows[n]
+                << " rows of C first-touched locally\n";
+        }
+    }
+    out << "B replicated per node: "
+        << (lastReplicatedB ? "yes" : placement.replicateB ? "no (needs numaTiles and 2+ nodes)" : "no")
+        << "\n";
+    out << "Packed panels: thread-local, first-touched by the worker that uses them\n";
+    return out.str();
+}
+
+void PThreadMultiplier::setCollectCounters(bool enable) {
+    MutexLock lock(jobMutex);
+    lastCounters = PerfStats();
+    if (!enable) {
+        workerCounters.clear();
+        return;
+    }
+    if (!workerCounters.empty()) {
+        return;
+    }
+    // Counters follow the thread that opens them, so each worker opens its own
+    workerCounters.resize(pool.size());
+    pool.run(pool.size(), [this](int worker) {
+        workerCounters[worker].reset(new ThreadCounters());
+    });
+}
+
+bool PThreadMultiplier::isCollectingCounters() const {
+    return !workerCounters.empty();
+}
+
+const PerfStats& PThreadMultiplier::getLastCounters() const {
+    return lastCounters;
+}
+
+void PThreadMultiplier::setMaxThreads(int threads) {
+    maxThreads = threads;
+}
+
+int PThreadMultiplier::getPoolSize() const {
+    return pool.size();
 }
 
 long long PThreadMultiplier::getLastExecutionTime() const {
@@ -157,3 +830,51 @@ long long PThreadMultiplier::getLastExecutionTime() const {
 int PThreadMultiplier::getThreadCount() const {
     return threadCount;
 }
+
+int PThreadMultiplier::getBlockSize() const {
+    return blockSizeUsed;
+}
+
+int PThreadMultiplier::getKSplitCount() const {
+    return kSplits;
+}
+
+#define INSTANTIATE_PTHREAD_MULTIPLY(T, Acc)                                                  \
+    template BasicMatrix<Acc> PThreadMultiplier::multiply<T, Acc>(const BasicMatrix<T>&,     \
+                                                                  const BasicMatrix<T>&, int); \
+    template BasicMatrix<Acc> PThreadMultiplier::multiply<T, Acc>(                            \
+        const BasicMatrixView<const T>&, const BasicMatrixView<const T>&, int);                \
+    template BasicMatrix<Acc> PThreadMultiplier::multiply<T, Acc>(                            \
+        MatrixOp, const BasicMatrix<T>&, MatrixOp, const BasicMatrix<T>&, int);                \
+    template BasicMatrix<Acc> PThreadMultiplier::multiply<T, Acc>(                            \
+        MatrixOp, const BasicMatrixView<const T>&, MatrixOp, const BasicMatrixView<const T>&, int); \
+    template BasicMatrix<Acc> PThreadMultiplier::multiplyStrassen<T, Acc>(                    \
+        const BasicMatrix<T>&, const BasicMatrix<T>&, int);                                    \
+    template BasicMatrix<Acc> PThreadMultiplier::multiplySparse<T, Acc>(                      \
+        const BasicSparseMatrix<T>&, const BasicMatrix<T>&);                                   \
+    template BasicSparseMatrix<Acc> PThreadMultiplier::multiplySparse<T, Acc>(                \
+        const BasicSparseMatrix<T>&, const BasicSparseMatrix<T>&);                             \
+    template std::vector<Acc> PThreadMultiplier::multiplyVector<T, Acc>(                     \
+        const BasicMatrix<T>&, const std::vector<T>&);                                         \
+    template std::vector<Acc> PThreadMultiplier::multiplyVector<T, Acc>(                     \
+        const std::vector<T>&, const BasicMatrix<T>&);                                         \
+    template BasicMatrix<Acc> PThreadMultiplier::multiplyVectors<T, Acc>(                     \
+        const BasicMatrix<T>&, const BasicMatrix<T>&);                                         \
+    template BasicMatrix<Acc> PThreadMultiplier::multiplyVectorsLeft<T, Acc>(                 \
+        const BasicMatrix<T>&, const BasicMatrix<T>&);                                         \
+    template void PThreadMultiplier::multiplyBatched<T, Acc>(                                 \
+        const StridedBatch<const T>&, const StridedBatch<const T>&, const StridedBatch<Acc>&); \
+    template BasicMortonMatrix<Acc> PThreadMultiplier::multiplyMorton<T, Acc>(                \
+        const BasicMortonMatrix<T>&, const BasicMortonMatrix<T>&);                             \
+    template MultiplyHandle<Acc> PThreadMultiplier::multiplyAsync<T, Acc>(                    \
+        BasicMatrix<T>, BasicMatrix<T>, int, long long);                                        \
+    template void PThreadMultiplier::multiplyInto<T, Acc>(                                    \
+        const BasicMatrixView<const T>&, const BasicMatrixView<const T>&,                      \
+        const BasicMatrixView<Acc>&, Acc, Acc, const GemmEpilogue<Acc>&, int);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_PTHREAD_MULTIPLY)
+#undef INSTANTIATE_PTHREAD_MULTIPLY
+
+#define INSTANTIATE_PTHREAD_EVALUATE(T) \
+    template BasicMatrix<T> PThreadMultiplier::evaluate<T>(BasicMatrixGraph<T>&, int);
+MATRIX_GRAPH_TYPES(INSTANTIATE_PTHREAD_EVALUATE)
+#undef INSTANTIATE_PTHREAD_EVALUATE
@@ -2,38 +2,275 @@
 #define PTHREAD_MULTIPLIER_H
 
 #include "Matrix.h"
+#include "ThreadPool.h"
+#include "Strassen.h"
+#include "SparseMatrix.h"
+#include "Numa.h"
+#include "BatchedGemm.h"
+#include "MortonMatrix.h"
+#include "AsyncMultiply.h"
+#include "MatrixGraph.h"
+#include "Gemm.h"
+#include "Gemv.h"
+#include "PerfCounters.h"
 #include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
+// NUMA placement of multiply(); everything is off by default
+struct PlacementOptions {
+    // Pin pool worker i to one CPU (pthread_setaffinity_np), workers spread over
+    // the nodes in proportion to their CPU counts
+    bool pinThreads;
+    // Give each node a contiguous band of C's tile rows. Its workers first-touch
+    // that band, then take its tiles before stealing from other nodes.
+    bool numaTiles;
+    // Give each node its own copy of B, written by that node's workers
+    // (only together with numaTiles, and only on machines with several nodes)
+    bool replicateB;
+
+    PlacementOptions() : pinThreads(false), numaTiles(false), replicateB(false) {}
+};
+
 class PThreadMultiplier {
 private:
     long long executionTime;
     int threadCount;
+    int kSplits;
+    int blockSizeUsed;
+    int maxThreads;
+    
+    // Workers live as long as the multiplier and are reused by every multiply()
+    ThreadPool pool;
+    
+    PlacementOptions placement;
+    NumaTopology topology;
+    WorkerPlacement workerPlacement;
+    std::vector<bool> workerPinned;
+    std::vector<int> lastBandRows;   // rows of C per node in the last multiply
+    bool lastReplicatedB;
+    
+    // One set of counters per pool worker, opened by that worker while enabled
+    std::vector<std::unique_ptr<ThreadCounters>> workerCounters;
+    PerfStats lastCounters;
+    
+    // One job at a time: held (recursively) by every multiply, so background
+    // jobs and calls from other threads never interleave on the pool or stats
+    pthread_mutex_t jobMutex;
+    // Stop request of the background job being run (under jobMutex), else null
+    const CancellationToken* activeToken;
+    
+    // Background thread of multiplyAsync(), started on first use
+    struct AsyncEntry {
+        std::shared_ptr<JobState> state;
+        std::function<void()> run;
+    };
+    pthread_t asyncThread;
+    bool asyncStarted;
+    bool asyncStopping;
+    pthread_mutex_t asyncMutex;
+    pthread_cond_t asyncCond;
+    std::deque<AsyncEntry> asyncQueue;
+    std::shared_ptr<JobState> asyncRunning;
+    
+    static void* asyncMain(void* arg);
+    void asyncLoop();
+    void submitAsync(const std::shared_ptr<JobState>& state, const std::function<void()>& run);
+    
+    // Tile rows [rowBlockBegin, rowBlockEnd) of C owned by one NUMA node
+    struct TileBand {
+        int rowBlockBegin;
+        int rowBlockEnd;
+        std::atomic<int> next;
+    };
     
+    template <typename T, typename Acc>
     struct ThreadData {
-        const Matrix* A;
-        const Matrix* B;
-        Matrix* C;
+        MatrixOp opA;
+        MatrixOp opB;
+        BasicMatrixView<const T> A;
+        std::vector<BasicMatrixView<const T>> B;   // per node (all the same unless replicated)
+        BasicMatrixView<Acc> C;
+        std::vector<BasicMatrix<Acc>>* partials;   // results of K-slices 1..kSplits-1
+        Acc alpha;
+        Acc beta;
+        const GemmEpilogue<Acc>* epilogue;   // null: none
         int blockSize;
-        int N;
-        int numBlocks;
-        pthread_mutex_t* mutex;
-        int* nextBlock;
+        int rowBlocks;
+        int colBlocks;
+        int kSplits;
+        int kChunk;
+        std::vector<TileBand>* bands;   // one per node, a single band without numaTiles
+        const std::vector<int>* workerNode;
+        const CancellationToken* token;   // polled before every task; null: none
+        std::atomic<bool> stopped;        // some worker left tasks undone
     };
     
-    static void* threadFunction(void* arg);
-    static void computeBlock(const Matrix& A, const Matrix& B, Matrix& C,
-                            int rowBlock, int colBlock, int blockSize, int N,
-                            pthread_mutex_t* writeMutex); 
+    template <typename T, typename Acc>
+    static void threadFunction(ThreadData<T, Acc>* data, int worker);
+    template <typename T, typename Acc>
+    static void computeBlock(MatrixOp opA, const BasicMatrixView<const T>& A,
+                            MatrixOp opB, const BasicMatrixView<const T>& B,
+                            const BasicMatrixView<Acc>& C,
+                            int rowBlock, int colBlock, int blockSize,
+                            int kBegin, int kEnd,
+                            Acc alpha, Acc beta, const GemmEpilogue<Acc>* epilogue);
+    template <typename Acc>
+    static void reducePartials(const BasicMatrixView<Acc>& C,
+                               const std::vector<BasicMatrix<Acc>>& partials,
+                               const GemmEpilogue<Acc>* epilogue, int worker, int workers);
+    
+    // Shared body of multiply() and multiplyInto(). firstTouch: C is freshly
+    // allocated and not yet written, so numaTiles may zero it band by band.
+    template <typename T, typename Acc>
+    void multiplyTiles(MatrixOp opA, const BasicMatrixView<const T>& A,
+                       MatrixOp opB, const BasicMatrixView<const T>& B,
+                       const BasicMatrixView<Acc>& C, Acc alpha, Acc beta,
+                       const GemmEpilogue<Acc>* epilogue, int blockSize, bool firstTouch);
+    
+    // Bracket the timed part of a multiply when counters are enabled
+    void startCounters();
+    void stopCounters();
 
 public:
-    PThreadMultiplier();
+    // poolSize <= 0 means one worker per hardware thread
+    explicit PThreadMultiplier(int poolSize = 0);
+    // Cancels background jobs still queued or running and waits for them
     ~PThreadMultiplier();
     
-    Matrix multiply(const Matrix& A, const Matrix& B, int blockSize);
+    PThreadMultiplier(const PThreadMultiplier&) = delete;
+    PThreadMultiplier& operator=(const PThreadMultiplier&) = delete;
+    
+    // A is M x K, B is K x N. C is cut into blockSize x blockSize tiles; when
+    // that gives fewer tiles than workers, K is split too and reduced at the end.
+    // blockSize 0 takes block size and thread count from the tuning profile
+    // (see Autotuner.h), or a size that gives every worker a few tiles when the
+    // profile has nothing close to this shape.
+    // Products are accumulated (and returned) in Acc, e.g. int8 x int8 -> int32;
+    // instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiply(const BasicMatrix<T>& A, const BasicMatrix<T>& B, int blockSize = 0);
+    
+    // Same, for operands that live outside a BasicMatrix (e.g. a mapped file)
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiply(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                              int blockSize = 0);
     
+    // op(A) * op(B) for operands stored transposed: A^T B, A B^T or A^T B^T
+    // without an explicit transpose, since the packing reads each operand
+    // along its stored rows (see gemm() in Gemm.h)
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiply(MatrixOp opA, const BasicMatrix<T>& A,
+                              MatrixOp opB, const BasicMatrix<T>& B, int blockSize = 0);
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiply(MatrixOp opA, const BasicMatrixView<const T>& A,
+                              MatrixOp opB, const BasicMatrixView<const T>& B, int blockSize = 0);
+    
+    // C = alpha * A * B + beta * C, then the epilogue (bias, activation, custom
+    // callback; see Gemm.h), written straight into the caller's C. Each tile is
+    // scaled and post-processed while it is still in cache and no result matrix
+    // is allocated. beta 0 never reads C. When K is split, the epilogue runs
+    // after the slices are summed, on each row as it is reduced.
+    template <typename T, typename Acc>
+    void multiplyInto(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                      const BasicMatrixView<Acc>& C, Acc alpha = Acc(1), Acc beta = Acc(0),
+                      const GemmEpilogue<Acc>& epilogue = GemmEpilogue<Acc>(),
+                      int blockSize = 0);
+    
+    // Strassen-Winograd down to `cutoff` with the seven top-level products run
+    // concurrently on the pool (see Strassen.h). Worth it for N >= ~2048.
+    // Narrow inputs are widened to Acc first, since the recursion adds operands.
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiplyStrassen(const BasicMatrix<T>& A, const BasicMatrix<T>& B,
+                                      int cutoff = STRASSEN_DEFAULT_CUTOFF);
+    
+    // Row-parallel sparse products on the pool (see SparseMatrix.h)
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiplySparse(const BasicSparseMatrix<T>& A, const BasicMatrix<T>& B);
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicSparseMatrix<Acc> multiplySparse(const BasicSparseMatrix<T>& A,
+                                          const BasicSparseMatrix<T>& B);
+    
+    // Matrix-vector products with A's rows split across the pool (see Gemv.h):
+    // A * x and x^T * A, then the same for a batch of vectors stored one per
+    // row of X, which streams A once for all of them
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    std::vector<Acc> multiplyVector(const BasicMatrix<T>& A, const std::vector<T>& x);
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    std::vector<Acc> multiplyVector(const std::vector<T>& x, const BasicMatrix<T>& A);
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiplyVectors(const BasicMatrix<T>& A, const BasicMatrix<T>& X);
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMatrix<Acc> multiplyVectorsLeft(const BasicMatrix<T>& X, const BasicMatrix<T>& A);
+    
+    // C[i] = A[i] * B[i] for a whole batch of small products, the batch split
+    // across the pool (see BatchedGemm.h)
+    template <typename T, typename Acc>
+    void multiplyBatched(const StridedBatch<const T>& A, const StridedBatch<const T>& B,
+                         const StridedBatch<Acc>& C);
+    
+    // multiply(A, B, blockSize) on a background thread; returns at once with a
+    // handle to poll, wait on (with a timeout), cancel or get the result from.
+    // The operands are moved (or copied) into the job. Jobs run one after the
+    // other in submission order, between the multiplier's other calls.
+    // timeoutMs > 0 sets a deadline that many milliseconds after submission,
+    // queueing included. A cancelled or late job stops at the next tile,
+    // frees its buffers and reports Cancelled / DeadlineExceeded.
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    MultiplyHandle<Acc> multiplyAsync(BasicMatrix<T> A, BasicMatrix<T> B, int blockSize = 0,
+                                      long long timeoutMs = 0);
+    
+    // Cache-oblivious recursive product on Morton-ordered operands (see
+    // MortonMatrix.h): no block size to tune, subproblems run as pool tasks
+    template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+    BasicMortonMatrix<Acc> multiplyMorton(const BasicMortonMatrix<T>& A,
+                                          const BasicMortonMatrix<T>& B);
+    
+    // Evaluates a whole expression (see MatrixGraph.h) on the pool as one tile
+    // task graph, with no barrier between its operations. The statistics cover
+    // the whole expression; the block size reported is the tile size it used.
+    template <typename T>
+    BasicMatrix<T> evaluate(BasicMatrixGraph<T>& graph, int root);
+    
+    // Applies NUMA options for the following multiply() calls. Pinning happens
+    // here and stays in effect until it is turned off again.
+    void setPlacement(const PlacementOptions& options);
+    
+    // Human-readable topology, worker placement and, after a multiply(), how
+    // C and B were distributed over the nodes
+    std::string getPlacementReport() const;
+    
+    // Caps the workers multiply() wakes; 0 (the default) allows the whole pool
+    // and lets blockSize 0 use the tuned thread count
+    void setMaxThreads(int threads);
+    int getPoolSize() const;
+    
+    // Hardware counters (cycles, instructions, L1D / LLC / dTLB misses; see
+    // PerfCounters.h) for every following multiply, per pool worker. Costs two
+    // extra pool wakeups per call, outside the timed region. Work done on the
+    // calling thread (allocating the result) is not counted.
+    void setCollectCounters(bool enable);
+    bool isCollectingCounters() const;
+    
+    // Counters of the last multiply: the sum over workers and each worker on
+    // its own. Events that could not be counted are -1 (e.g. everywhere when
+    // the kernel does not allow perf_event_open, or collection is off).
+    const PerfStats& getLastCounters() const;
+    
+    // Statistics of the last job to finish on this multiplier, background ones
+    // included
     long long getLastExecutionTime() const;
     int getThreadCount() const;
+    
+    // Block size the last multiply used (the tuned one when 0 was passed)
+    int getBlockSize() const;
+    
+    // Number of K-slices the last multiply used (1 = plain 2D tiling)
+    int getKSplitCount() const;
 };
 
 #endif // PTHREAD_MULTIPLIER_H
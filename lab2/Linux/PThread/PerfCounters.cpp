@@ -0,0 +1,183 @@
+#include "PerfCounters.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+const char* perfEventName(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::Cycles: return "cycles";
+        case PerfEvent::Instructions: return "instructions";
+        case PerfEvent::L1DMisses: return "l1dMisses";
+        case PerfEvent::LLCMisses: return "llcMisses";
+        case PerfEvent::DTLBMisses: return "dtlbMisses";
+    }
+    return "unknown";
+}
+
+PerfCounts::PerfCounts() {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) values[e] = -1;
+}
+
+bool PerfCounts::any() const {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (values[e] >= 0) return true;
+    }
+    return false;
+}
+
+PerfCounts& PerfCounts::operator+=(const PerfCounts& other) {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (other.values[e] < 0) continue;
+        values[e] = values[e] < 0 ? other.values[e] : values[e] + other.values[e];
+    }
+    return *this;
+}
+
+PerfCounts PerfCounts::averaged(int runs) const {
+    PerfCounts result = *this;
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (result.values[e] >= 0 && runs > 0) result.values[e] /= runs;
+    }
+    return result;
+}
+
+double PerfCounts::ipc() const {
+    long long cycles = (*this)[PerfEvent::Cycles];
+    long long instructions = (*this)[PerfEvent::Instructions];
+    if (cycles <= 0 || instructions < 0) return -1.0;
+    return static_cast<double>(instructions) / cycles;
+}
+
+double PerfCounts::perKiloInstruction(PerfEvent event) const {
+    long long instructions = (*this)[PerfEvent::Instructions];
+    if (instructions <= 0 || !available(event)) return -1.0;
+    return 1000.0 * (*this)[event] / instructions;
+}
+
+std::string PerfCounts::summary() const {
+    if (!any()) return "unavailable";
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    const char* separator = "";
+    if (ipc() >= 0.0) {
+        out << "IPC " << ipc();
+        separator = ", ";
+    }
+    out << std::setprecision(1);
+    static const PerfEvent misses[] = { PerfEvent::L1DMisses, PerfEvent::LLCMisses,
+                                        PerfEvent::DTLBMisses };
+    static const char* const labels[] = { "L1D", "LLC", "dTLB" };
+    for (int i = 0; i < 3; ++i) {
+        double rate = perKiloInstruction(misses[i]);
+        if (rate >= 0.0) {
+            out << separator << labels[i] << " " << rate << "/ki";
+            separator = ", ";
+        }
+    }
+    // Without instructions there are no rates; print the raw counts instead
+    if (*separator == '\0') {
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            if (values[e] < 0) continue;
+            out << separator << perfEventName(static_cast<PerfEvent>(e)) << " " << values[e];
+            separator = ", ";
+        }
+    }
+    return out.str();
+}
+
+static std::uint64_t cacheEvent(std::uint64_t cache, std::uint64_t result) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+static void describeEvent(PerfEvent event, perf_event_attr& attr) {
+    switch (event) {
+        case PerfEvent::Cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::Instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::L1DMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        case PerfEvent::LLCMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        case PerfEvent::DTLBMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+    }
+}
+
+ThreadCounters::ThreadCounters(bool inherit) {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        describeEvent(static_cast<PerfEvent>(e), attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = inherit ? 1 : 0;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // pid 0, cpu -1: the calling thread on whatever CPU it runs
+        fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+}
+
+ThreadCounters::~ThreadCounters() {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (fds[e] >= 0) close(fds[e]);
+    }
+}
+
+bool ThreadCounters::anyOpen() const {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (fds[e] >= 0) return true;
+    }
+    return false;
+}
+
+void ThreadCounters::start() {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (fds[e] < 0) continue;
+        ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+PerfCounts ThreadCounters::stop() {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (fds[e] >= 0) ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    PerfCounts counts;
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (fds[e] < 0) continue;
+        std::uint64_t data[3];   // value, time enabled, time running
+        if (read(fds[e], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) continue;
+        if (data[2] == 0) {
+            // Never scheduled on the PMU: nothing known rather than zero
+            counts.values[e] = data[1] == 0 ? 0 : -1;
+        }
+        else if (data[2] < data[1]) {
+            counts.values[e] = static_cast<long long>(
+                static_cast<double>(data[0]) * data[1] / data[2]);
+        }
+        else {
+            counts.values[e] = static_cast<long long>(data[0]);
+        }
+    }
+    return counts;
+}
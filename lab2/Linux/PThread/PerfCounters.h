@@ -0,0 +1,82 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+#include <vector>
+
+// Hardware events counted for a multiply
+enum class PerfEvent {
+    Cycles,
+    Instructions,
+    L1DMisses,    // L1 data cache read misses
+    LLCMisses,    // last level cache read misses
+    DTLBMisses    // data TLB read misses
+};
+
+static const int PERF_EVENT_COUNT = 5;
+
+// Short name used in tables, JSON and CSV ("cycles", "l1dMisses", ...)
+const char* perfEventName(PerfEvent event);
+
+// Counts of one thread, or the sum over several. -1 marks an event that could
+// not be counted (no PMU, not permitted, counters not enabled).
+struct PerfCounts {
+    long long values[PERF_EVENT_COUNT];
+
+    PerfCounts();
+
+    long long operator[](PerfEvent event) const { return values[static_cast<int>(event)]; }
+    long long& operator[](PerfEvent event) { return values[static_cast<int>(event)]; }
+
+    bool available(PerfEvent event) const { return (*this)[event] >= 0; }
+    // True if at least one event was counted
+    bool any() const;
+
+    // Adds the events counted in `other`; an event nobody counted stays -1
+    PerfCounts& operator+=(const PerfCounts& other);
+    // Every counted event divided by `runs`
+    PerfCounts averaged(int runs) const;
+
+    // Instructions per cycle, -1 if either is missing
+    double ipc() const;
+    // Events per thousand instructions, -1 if either is missing
+    double perKiloInstruction(PerfEvent event) const;
+
+    // "IPC 2.31, L1D 12.0/ki, LLC 0.4/ki, dTLB 0.1/ki" or "unavailable"
+    std::string summary() const;
+};
+
+// Counters of one multiply: the sum and every pool worker on its own
+struct PerfStats {
+    PerfCounts total;
+    std::vector<PerfCounts> perThread;
+};
+
+// The events of the calling thread, counted in user space only (so the default
+// perf_event_paranoid of 2 suffices) through perf_event_open. Each event is its
+// own counter, so the PMU may multiplex them; reads are scaled by the time the
+// counter was actually running. Events the kernel refuses (no permission, a VM
+// or container without PMU access) are left closed and read as -1 - nothing
+// throws. With inherit, threads the calling thread creates after construction
+// are counted too (their counts are added when they exit).
+class ThreadCounters {
+private:
+    int fds[PERF_EVENT_COUNT];
+
+public:
+    explicit ThreadCounters(bool inherit = false);
+    ~ThreadCounters();
+
+    ThreadCounters(const ThreadCounters&) = delete;
+    ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+    // False if not a single event could be opened
+    bool anyOpen() const;
+
+    // Zeroes and enables the counters
+    void start();
+    // Disables the counters and reads them
+    PerfCounts stop();
+};
+
+#endif // PERF_COUNTERS_H
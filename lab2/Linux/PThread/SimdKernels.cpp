@@ -0,0 +1,500 @@
+#include "SimdKernels.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX instructions inside functions marked for that ISA;
+// MSVC accepts the intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// Writes the top-left m x n corner of a row-major tile with nr columns to c
+static void storeTile(const int* tile, int nr, int* c, int ldc, int m, int n, bool accumulate) {
+    for (int i = 0; i < m; ++i) {
+        const int* src = tile + i * nr;
+        int* row = c + static_cast<size_t>(i) * ldc;
+        if (accumulate) {
+            for (int j = 0; j < n; ++j) row[j] += src[j];
+        }
+        else {
+            for (int j = 0; j < n; ++j) row[j] = src[j];
+        }
+    }
+}
+
+// ---------------------------------------------------------------- scalar
+
+static void microKernelScalar(int kc, const int* a, const int* b, int* c, int ldc,
+                              int m, int n, bool accumulate) {
+    const int MR = 4;
+    const int NR = 8;
+    int acc[MR * NR] = {0};
+
+    for (int p = 0; p < kc; ++p) {
+        int a0 = a[0];
+        int a1 = a[1];
+        int a2 = a[2];
+        int a3 = a[3];
+        for (int j = 0; j < NR; ++j) {
+            int bj = b[j];
+            acc[0 * NR + j] += a0 * bj;
+            acc[1 * NR + j] += a1 * bj;
+            acc[2 * NR + j] += a2 * bj;
+            acc[3 * NR + j] += a3 * bj;
+        }
+        a += MR;
+        b += NR;
+    }
+
+    storeTile(acc, NR, c, ldc, m, n, accumulate);
+}
+
+static void axpyScalar(int n, int alpha, const int* x, int* y) {
+    for (int j = 0; j < n; ++j) {
+        y[j] += alpha * x[j];
+    }
+}
+
+// Unsigned, so the sum wraps without undefined behaviour
+static int dotScalar(int n, const int* x, const int* y) {
+    unsigned int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        s0 += static_cast<unsigned int>(x[j]) * static_cast<unsigned int>(y[j]);
+        s1 += static_cast<unsigned int>(x[j + 1]) * static_cast<unsigned int>(y[j + 1]);
+        s2 += static_cast<unsigned int>(x[j + 2]) * static_cast<unsigned int>(y[j + 2]);
+        s3 += static_cast<unsigned int>(x[j + 3]) * static_cast<unsigned int>(y[j + 3]);
+    }
+    for (; j < n; ++j) {
+        s0 += static_cast<unsigned int>(x[j]) * static_cast<unsigned int>(y[j]);
+    }
+    return static_cast<int>(s0 + s1 + s2 + s3);
+}
+
+#ifdef SIMD_X86
+
+// ---------------------------------------------------------------- SSE4.1
+
+// 4 x 8 tile: 8 xmm accumulators (pmulld is SSE4.1)
+SIMD_TARGET("sse4.1")
+static void microKernelSse41(int kc, const int* a, const int* b, int* c, int ldc,
+                             int m, int n, bool accumulate) {
+    __m128i c00 = _mm_setzero_si128(), c01 = _mm_setzero_si128();
+    __m128i c10 = _mm_setzero_si128(), c11 = _mm_setzero_si128();
+    __m128i c20 = _mm_setzero_si128(), c21 = _mm_setzero_si128();
+    __m128i c30 = _mm_setzero_si128(), c31 = _mm_setzero_si128();
+
+    for (int p = 0; p < kc; ++p) {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 4));
+        __m128i ai;
+
+        ai = _mm_set1_epi32(a[0]);
+        c00 = _mm_add_epi32(c00, _mm_mullo_epi32(ai, b0));
+        c01 = _mm_add_epi32(c01, _mm_mullo_epi32(ai, b1));
+        ai = _mm_set1_epi32(a[1]);
+        c10 = _mm_add_epi32(c10, _mm_mullo_epi32(ai, b0));
+        c11 = _mm_add_epi32(c11, _mm_mullo_epi32(ai, b1));
+        ai = _mm_set1_epi32(a[2]);
+        c20 = _mm_add_epi32(c20, _mm_mullo_epi32(ai, b0));
+        c21 = _mm_add_epi32(c21, _mm_mullo_epi32(ai, b1));
+        ai = _mm_set1_epi32(a[3]);
+        c30 = _mm_add_epi32(c30, _mm_mullo_epi32(ai, b0));
+        c31 = _mm_add_epi32(c31, _mm_mullo_epi32(ai, b1));
+
+        a += 4;
+        b += 8;
+    }
+
+    alignas(16) int tile[4 * 8];
+    __m128i* t = reinterpret_cast<__m128i*>(tile);
+    _mm_store_si128(t + 0, c00); _mm_store_si128(t + 1, c01);
+    _mm_store_si128(t + 2, c10); _mm_store_si128(t + 3, c11);
+    _mm_store_si128(t + 4, c20); _mm_store_si128(t + 5, c21);
+    _mm_store_si128(t + 6, c30); _mm_store_si128(t + 7, c31);
+    storeTile(tile, 8, c, ldc, m, n, accumulate);
+}
+
+SIMD_TARGET("sse4.1")
+static void axpySse41(int n, int alpha, const int* x, int* y) {
+    __m128i va = _mm_set1_epi32(alpha);
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m128i vx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + j));
+        __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + j));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + j),
+                         _mm_add_epi32(vy, _mm_mullo_epi32(va, vx)));
+    }
+    for (; j < n; ++j) {
+        y[j] += alpha * x[j];
+    }
+}
+
+// Two accumulators hide the latency of pmulld
+SIMD_TARGET("sse4.1")
+static int dotSse41(int n, const int* x, const int* y) {
+    __m128i s0 = _mm_setzero_si128(), s1 = _mm_setzero_si128();
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + j));
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + j + 4));
+        __m128i y0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + j));
+        __m128i y1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + j + 4));
+        s0 = _mm_add_epi32(s0, _mm_mullo_epi32(x0, y0));
+        s1 = _mm_add_epi32(s1, _mm_mullo_epi32(x1, y1));
+    }
+    __m128i s = _mm_add_epi32(s0, s1);
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    unsigned int sum = static_cast<unsigned int>(_mm_cvtsi128_si32(s));
+    for (; j < n; ++j) {
+        sum += static_cast<unsigned int>(x[j]) * static_cast<unsigned int>(y[j]);
+    }
+    return static_cast<int>(sum);
+}
+
+// ---------------------------------------------------------------- AVX2
+
+// 6 x 16 tile: 12 ymm accumulators, 2 for B, 1 broadcast
+SIMD_TARGET("avx2")
+static void microKernelAvx2(int kc, const int* a, const int* b, int* c, int ldc,
+                            int m, int n, bool accumulate) {
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    __m256i c40 = _mm256_setzero_si256(), c41 = _mm256_setzero_si256();
+    __m256i c50 = _mm256_setzero_si256(), c51 = _mm256_setzero_si256();
+
+    for (int p = 0; p < kc; ++p) {
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 8));
+        __m256i ai;
+
+        ai = _mm256_set1_epi32(a[0]);
+        c00 = _mm256_add_epi32(c00, _mm256_mullo_epi32(ai, b0));
+        c01 = _mm256_add_epi32(c01, _mm256_mullo_epi32(ai, b1));
+        ai = _mm256_set1_epi32(a[1]);
+        c10 = _mm256_add_epi32(c10, _mm256_mullo_epi32(ai, b0));
+        c11 = _mm256_add_epi32(c11, _mm256_mullo_epi32(ai, b1));
+        ai = _mm256_set1_epi32(a[2]);
+        c20 = _mm256_add_epi32(c20, _mm256_mullo_epi32(ai, b0));
+        c21 = _mm256_add_epi32(c21, _mm256_mullo_epi32(ai, b1));
+        ai = _mm256_set1_epi32(a[3]);
+        c30 = _mm256_add_epi32(c30, _mm256_mullo_epi32(ai, b0));
+        c31 = _mm256_add_epi32(c31, _mm256_mullo_epi32(ai, b1));
+        ai = _mm256_set1_epi32(a[4]);
+        c40 = _mm256_add_epi32(c40, _mm256_mullo_epi32(ai, b0));
+        c41 = _mm256_add_epi32(c41, _mm256_mullo_epi32(ai, b1));
+        ai = _mm256_set1_epi32(a[5]);
+        c50 = _mm256_add_epi32(c50, _mm256_mullo_epi32(ai, b0));
+        c51 = _mm256_add_epi32(c51, _mm256_mullo_epi32(ai, b1));
+
+        a += 6;
+        b += 16;
+    }
+
+    alignas(32) int tile[6 * 16];
+    __m256i* t = reinterpret_cast<__m256i*>(tile);
+    _mm256_store_si256(t + 0, c00); _mm256_store_si256(t + 1, c01);
+    _mm256_store_si256(t + 2, c10); _mm256_store_si256(t + 3, c11);
+    _mm256_store_si256(t + 4, c20); _mm256_store_si256(t + 5, c21);
+    _mm256_store_si256(t + 6, c30); _mm256_store_si256(t + 7, c31);
+    _mm256_store_si256(t + 8, c40); _mm256_store_si256(t + 9, c41);
+    _mm256_store_si256(t + 10, c50); _mm256_store_si256(t + 11, c51);
+    storeTile(tile, 16, c, ldc, m, n, accumulate);
+}
+
+SIMD_TARGET("avx2")
+static void axpyAvx2(int n, int alpha, const int* x, int* y) {
+    __m256i va = _mm256_set1_epi32(alpha);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256i vx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + j));
+        __m256i vy = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + j),
+                            _mm256_add_epi32(vy, _mm256_mullo_epi32(va, vx)));
+    }
+    for (; j < n; ++j) {
+        y[j] += alpha * x[j];
+    }
+}
+
+SIMD_TARGET("avx2")
+static int dotAvx2(int n, const int* x, const int* y) {
+    __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + j));
+        __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + j + 8));
+        __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + j));
+        __m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + j + 8));
+        s0 = _mm256_add_epi32(s0, _mm256_mullo_epi32(x0, y0));
+        s1 = _mm256_add_epi32(s1, _mm256_mullo_epi32(x1, y1));
+    }
+    __m256i s8 = _mm256_add_epi32(s0, s1);
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(s8), _mm256_extracti128_si256(s8, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    unsigned int sum = static_cast<unsigned int>(_mm_cvtsi128_si32(s));
+    for (; j < n; ++j) {
+        sum += static_cast<unsigned int>(x[j]) * static_cast<unsigned int>(y[j]);
+    }
+    return static_cast<int>(sum);
+}
+
+// ---------------------------------------------------------------- AVX-512
+
+// 6 x 32 tile: 12 zmm accumulators
+SIMD_TARGET("avx512f")
+static void microKernelAvx512(int kc, const int* a, const int* b, int* c, int ldc,
+                              int m, int n, bool accumulate) {
+    __m512i c00 = _mm512_setzero_si512(), c01 = _mm512_setzero_si512();
+    __m512i c10 = _mm512_setzero_si512(), c11 = _mm512_setzero_si512();
+    __m512i c20 = _mm512_setzero_si512(), c21 = _mm512_setzero_si512();
+    __m512i c30 = _mm512_setzero_si512(), c31 = _mm512_setzero_si512();
+    __m512i c40 = _mm512_setzero_si512(), c41 = _mm512_setzero_si512();
+    __m512i c50 = _mm512_setzero_si512(), c51 = _mm512_setzero_si512();
+
+    for (int p = 0; p < kc; ++p) {
+        __m512i b0 = _mm512_loadu_si512(b);
+        __m512i b1 = _mm512_loadu_si512(b + 16);
+        __m512i ai;
+
+        ai = _mm512_set1_epi32(a[0]);
+        c00 = _mm512_add_epi32(c00, _mm512_mullo_epi32(ai, b0));
+        c01 = _mm512_add_epi32(c01, _mm512_mullo_epi32(ai, b1));
+        ai = _mm512_set1_epi32(a[1]);
+        c10 = _mm512_add_epi32(c10, _mm512_mullo_epi32(ai, b0));
+        c11 = _mm512_add_epi32(c11, _mm512_mullo_epi32(ai, b1));
+        ai = _mm512_set1_epi32(a[2]);
+        c20 = _mm512_add_epi32(c20, _mm512_mullo_epi32(ai, b0));
+        c21 = _mm512_add_epi32(c21, _mm512_mullo_epi32(ai, b1));
+        ai = _mm512_set1_epi32(a[3]);
+        c30 = _mm512_add_epi32(c30, _mm512_mullo_epi32(ai, b0));
+        c31 = _mm512_add_epi32(c31, _mm512_mullo_epi32(ai, b1));
+        ai = _mm512_set1_epi32(a[4]);
+        c40 = _mm512_add_epi32(c40, _mm512_mullo_epi32(ai, b0));
+        c41 = _mm512_add_epi32(c41, _mm512_mullo_epi32(ai, b1));
+        ai = _mm512_set1_epi32(a[5]);
+        c50 = _mm512_add_epi32(c50, _mm512_mullo_epi32(ai, b0));
+        c51 = _mm512_add_epi32(c51, _mm512_mullo_epi32(ai, b1));
+
+        a += 6;
+        b += 32;
+    }
+
+    alignas(64) int tile[6 * 32];
+    _mm512_store_si512(tile + 0, c00); _mm512_store_si512(tile + 16, c01);
+    _mm512_store_si512(tile + 32, c10); _mm512_store_si512(tile + 48, c11);
+    _mm512_store_si512(tile + 64, c20); _mm512_store_si512(tile + 80, c21);
+    _mm512_store_si512(tile + 96, c30); _mm512_store_si512(tile + 112, c31);
+    _mm512_store_si512(tile + 128, c40); _mm512_store_si512(tile + 144, c41);
+    _mm512_store_si512(tile + 160, c50); _mm512_store_si512(tile + 176, c51);
+    storeTile(tile, 32, c, ldc, m, n, accumulate);
+}
+
+SIMD_TARGET("avx512f")
+static void axpyAvx512(int n, int alpha, const int* x, int* y) {
+    __m512i va = _mm512_set1_epi32(alpha);
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m512i vx = _mm512_loadu_si512(x + j);
+        __m512i vy = _mm512_loadu_si512(y + j);
+        _mm512_storeu_si512(y + j, _mm512_add_epi32(vy, _mm512_mullo_epi32(va, vx)));
+    }
+    for (; j < n; ++j) {
+        y[j] += alpha * x[j];
+    }
+}
+
+SIMD_TARGET("avx512f")
+static int dotAvx512(int n, const int* x, const int* y) {
+    __m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512();
+    int j = 0;
+    for (; j + 32 <= n; j += 32) {
+        s0 = _mm512_add_epi32(s0, _mm512_mullo_epi32(_mm512_loadu_si512(x + j),
+                                                     _mm512_loadu_si512(y + j)));
+        s1 = _mm512_add_epi32(s1, _mm512_mullo_epi32(_mm512_loadu_si512(x + j + 16),
+                                                     _mm512_loadu_si512(y + j + 16)));
+    }
+    // Through memory: GCC's _mm512_reduce_add_epi32 trips -Wuninitialized
+    int lanes[16];
+    _mm512_storeu_si512(lanes, _mm512_add_epi32(s0, s1));
+    unsigned int sum = 0;
+    for (int l = 0; l < 16; ++l) {
+        sum += static_cast<unsigned int>(lanes[l]);
+    }
+    for (; j < n; ++j) {
+        sum += static_cast<unsigned int>(x[j]) * static_cast<unsigned int>(y[j]);
+    }
+    return static_cast<int>(sum);
+}
+
+static void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, subleaf);
+    for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned int>(r[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switch (XCR0)
+static unsigned long long xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+
+#endif // SIMD_X86
+
+SimdIsa detectSimdIsa() {
+#ifdef SIMD_X86
+    unsigned int r[4];
+    cpuid(0, 0, r);
+    unsigned int maxLeaf = r[0];
+    if (maxLeaf < 1) return SimdIsa::Scalar;
+
+    cpuid(1, 0, r);
+    bool sse41 = (r[2] & (1u << 19)) != 0;
+    bool osxsave = (r[2] & (1u << 27)) != 0;
+    if (!sse41) return SimdIsa::Scalar;
+    if (!osxsave || maxLeaf < 7) return SimdIsa::Sse41;
+
+    unsigned long long xcr0 = xgetbv0();
+    bool ymmState = (xcr0 & 0x6) == 0x6;
+    bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+    cpuid(7, 0, r);
+    bool avx2 = (r[1] & (1u << 5)) != 0;
+    bool avx512f = (r[1] & (1u << 16)) != 0;
+
+    if (avx512f && zmmState) return SimdIsa::Avx512;
+    if (avx2 && ymmState) return SimdIsa::Avx2;
+    return SimdIsa::Sse41;
+#else
+    return SimdIsa::Scalar;
+#endif
+}
+
+static const GemmMicroKernel microKernels[] = {
+    { SimdIsa::Scalar, 4, 8, microKernelScalar },
+#ifdef SIMD_X86
+    { SimdIsa::Sse41, 4, 8, microKernelSse41 },
+    { SimdIsa::Avx2, 6, 16, microKernelAvx2 },
+    { SimdIsa::Avx512, 6, 32, microKernelAvx512 },
+#endif
+};
+
+static const AxpyKernelFn axpyKernels[] = {
+    axpyScalar,
+#ifdef SIMD_X86
+    axpySse41,
+    axpyAvx2,
+    axpyAvx512,
+#endif
+};
+
+static const DotKernelFn dotKernels[] = {
+    dotScalar,
+#ifdef SIMD_X86
+    dotSse41,
+    dotAvx2,
+    dotAvx512,
+#endif
+};
+
+// -1 means "not forced"
+static std::atomic<int> forcedIsa(-1);
+
+static SimdIsa defaultSimdIsa() {
+    static const SimdIsa isa = []() -> SimdIsa {
+        SimdIsa detected = detectSimdIsa();
+        const char* env = std::getenv("MATRIX_SIMD");
+        if (env == nullptr || *env == '\0') return detected;
+        try {
+            SimdIsa requested = parseSimdIsa(env);
+            if (static_cast<int>(requested) > static_cast<int>(detected)) {
+                std::cerr << "MATRIX_SIMD=" << env << " is not supported on this CPU, using "
+                          << simdIsaName(detected) << std::endl;
+                return detected;
+            }
+            return requested;
+        }
+        catch (const std::invalid_argument& e) {
+            std::cerr << e.what() << ", using " << simdIsaName(detected) << std::endl;
+            return detected;
+        }
+    }();
+    return isa;
+}
+
+SimdIsa activeSimdIsa() {
+    int forced = forcedIsa.load(std::memory_order_relaxed);
+    return forced >= 0 ? static_cast<SimdIsa>(forced) : defaultSimdIsa();
+}
+
+void setSimdIsa(SimdIsa isa) {
+    if (static_cast<int>(isa) > static_cast<int>(detectSimdIsa())) {
+        throw std::invalid_argument(std::string("SIMD ISA not supported on this CPU: ") +
+                                    simdIsaName(isa));
+    }
+    forcedIsa.store(static_cast<int>(isa), std::memory_order_relaxed);
+}
+
+void resetSimdIsa() {
+    forcedIsa.store(-1, std::memory_order_relaxed);
+}
+
+const char* simdIsaName(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::Scalar: return "scalar";
+    case SimdIsa::Sse41: return "sse4.1";
+    case SimdIsa::Avx2: return "avx2";
+    case SimdIsa::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+SimdIsa parseSimdIsa(const char* name) {
+    if (std::strcmp(name, "scalar") == 0) return SimdIsa::Scalar;
+    if (std::strcmp(name, "sse4.1") == 0 || std::strcmp(name, "sse41") == 0) return SimdIsa::Sse41;
+    if (std::strcmp(name, "avx2") == 0) return SimdIsa::Avx2;
+    if (std::strcmp(name, "avx512") == 0 || std::strcmp(name, "avx512f") == 0) return SimdIsa::Avx512;
+    throw std::invalid_argument(std::string("Unknown SIMD ISA: ") + name);
+}
+
+const GemmMicroKernel& gemmMicroKernel() {
+    return microKernels[static_cast<int>(activeSimdIsa())];
+}
+
+AxpyKernelFn axpyKernel() {
+    return axpyKernels[static_cast<int>(activeSimdIsa())];
+}
+
+DotKernelFn dotKernel() {
+    return dotKernels[static_cast<int>(activeSimdIsa())];
+}
@@ -0,0 +1,390 @@
+#include "SparseMatrix.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+template <typename T>
+BasicSparseMatrix<T>::BasicSparseMatrix()
+    : layout(SparseLayout::CSR), rows(0), cols(0), offsets(1, 0) {}
+
+template <typename T>
+BasicSparseMatrix<T>::BasicSparseMatrix(int r, int c, SparseLayout l)
+    : layout(l), rows(r), cols(c) {
+    if (r < 0 || c < 0) {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+    offsets.assign(static_cast<size_t>(majorCount()) + 1, 0);
+}
+
+template <typename T>
+BasicSparseMatrix<T>::BasicSparseMatrix(int r, int c, SparseLayout l, std::vector<size_t> o,
+                                        std::vector<int> idx, std::vector<T> v)
+    : layout(l), rows(r), cols(c), offsets(std::move(o)), indices(std::move(idx)),
+      values(std::move(v)) {
+    if (r < 0 || c < 0) {
+        throw std::invalid_argument("Matrix dimensions must be non-negative");
+    }
+    int major = majorCount();
+    int minor = layout == SparseLayout::CSR ? cols : rows;
+    if (offsets.size() != static_cast<size_t>(major) + 1 || offsets[0] != 0 ||
+        offsets[major] != values.size() || indices.size() != values.size()) {
+        throw std::invalid_argument("Inconsistent sparse matrix arrays");
+    }
+    for (int l = 0; l < major; ++l) {
+        if (offsets[l] > offsets[l + 1]) {
+            throw std::invalid_argument("Sparse matrix offsets must be non-decreasing");
+        }
+        for (size_t p = offsets[l]; p < offsets[l + 1]; ++p) {
+            if (indices[p] < 0 || indices[p] >= minor ||
+                (p > offsets[l] && indices[p] <= indices[p - 1])) {
+                throw std::invalid_argument("Sparse matrix indices out of range or not ascending");
+            }
+        }
+    }
+}
+
+template <typename T>
+BasicSparseMatrix<T> BasicSparseMatrix<T>::fromDense(const BasicMatrix<T>& M, SparseLayout layout) {
+    BasicSparseMatrix result(M.getRows(), M.getCols(), layout);
+    int major = result.majorCount();
+    int minor = layout == SparseLayout::CSR ? M.getCols() : M.getRows();
+
+    for (int l = 0; l < major; ++l) {
+        for (int m = 0; m < minor; ++m) {
+            T value = layout == SparseLayout::CSR ? M.rowPtr(l)[m] : M.rowPtr(m)[l];
+            if (value != T(0)) {
+                result.indices.push_back(m);
+                result.values.push_back(value);
+            }
+        }
+        result.offsets[l + 1] = result.values.size();
+    }
+    return result;
+}
+
+template <typename T>
+BasicMatrix<T> BasicSparseMatrix<T>::toDense() const {
+    BasicMatrix<T> result(rows, cols);
+    for (int l = 0; l < majorCount(); ++l) {
+        for (size_t p = offsets[l]; p < offsets[l + 1]; ++p) {
+            if (layout == SparseLayout::CSR) {
+                result.rowPtr(l)[indices[p]] = values[p];
+            }
+            else {
+                result.rowPtr(indices[p])[l] = values[p];
+            }
+        }
+    }
+    return result;
+}
+
+template <typename T>
+BasicSparseMatrix<T> BasicSparseMatrix<T>::toLayout(SparseLayout target) const {
+    if (target == layout) {
+        return *this;
+    }
+
+    BasicSparseMatrix result(rows, cols, target);
+    int newMajor = result.majorCount();
+
+    // Count the elements of every new line, then scatter in old-major order,
+    // which leaves each new line sorted by its minor index
+    for (int idx : indices) {
+        ++result.offsets[idx + 1];
+    }
+    for (int l = 0; l < newMajor; ++l) {
+        result.offsets[l + 1] += result.offsets[l];
+    }
+
+    result.indices.resize(values.size());
+    result.values.resize(values.size());
+    std::vector<size_t> next(result.offsets.begin(), result.offsets.end() - 1);
+    for (int l = 0; l < majorCount(); ++l) {
+        for (size_t p = offsets[l]; p < offsets[l + 1]; ++p) {
+            size_t q = next[indices[p]]++;
+            result.indices[q] = l;
+            result.values[q] = values[p];
+        }
+    }
+    return result;
+}
+
+template <typename T>
+double BasicSparseMatrix<T>::density() const {
+    if (rows == 0 || cols == 0) return 0.0;
+    return static_cast<double>(values.size()) / (static_cast<double>(rows) * cols);
+}
+
+template <typename T>
+void BasicSparseMatrix<T>::print(const std::string& name, int limit) const {
+    if (!name.empty()) {
+        std::cout << name << " (" << rows << "x" << cols << ", " << values.size() << " nonzeros, "
+                  << (layout == SparseLayout::CSR ? "CSR" : "CSC") << "):\n";
+    }
+
+    int displayLines = std::min(majorCount(), limit);
+    for (int l = 0; l < displayLines; l++) {
+        std::cout << (layout == SparseLayout::CSR ? "row " : "col ") << std::setw(4) << l << ":";
+        size_t end = std::min(offsets[l + 1], offsets[l] + static_cast<size_t>(limit));
+        for (size_t p = offsets[l]; p < end; ++p) {
+            // Unary + prints int8_t as a number rather than a character
+            std::cout << " " << indices[p] << "=" << +values[p];
+        }
+        if (end < offsets[l + 1]) std::cout << " ...";
+        std::cout << std::endl;
+    }
+    if (displayLines < majorCount()) std::cout << "...\n";
+}
+
+template <typename T>
+bool BasicSparseMatrix<T>::equals(const BasicSparseMatrix& other) const {
+    if (rows != other.rows || cols != other.cols) return false;
+    if (layout != other.layout) return equals(other.toLayout(layout));
+    return offsets == other.offsets && indices == other.indices && values == other.values;
+}
+
+// Rows per task: small enough to balance skewed rows, big enough to keep the
+// atomic cursor off the profile
+static const int SPARSE_ROW_CHUNK = 32;
+
+template <typename T>
+static const BasicSparseMatrix<T>& asCsr(const BasicSparseMatrix<T>& M,
+                                         BasicSparseMatrix<T>& storage) {
+    if (M.getLayout() == SparseLayout::CSR) {
+        return M;
+    }
+    storage = M.toLayout(SparseLayout::CSR);
+    return storage;
+}
+
+// y[0..n) += alpha * x[0..n)
+template <typename T, typename Acc>
+static void axpyRow(int n, Acc alpha, const T* x, Acc* y) {
+    for (int j = 0; j < n; ++j) {
+        y[j] += alpha * static_cast<Acc>(x[j]);
+    }
+}
+
+// int32 rows use the run-time dispatched SIMD kernel
+template <>
+void axpyRow<std::int32_t, std::int32_t>(int n, std::int32_t alpha, const std::int32_t* x,
+                                         std::int32_t* y) {
+    axpyKernel()(n, alpha, x, y);
+}
+
+template <typename T, typename Acc>
+std::vector<Acc> sparseMatVec(const BasicSparseMatrix<T>& A, const std::vector<T>& x,
+                              ThreadPool* pool) {
+    if (x.size() != static_cast<size_t>(A.getCols())) {
+        throw std::invalid_argument("Incompatible matrix and vector sizes");
+    }
+
+    BasicSparseMatrix<T> csrStorage;
+    const BasicSparseMatrix<T>& csr = asCsr(A, csrStorage);
+    const std::vector<size_t>& offsets = csr.getOffsets();
+    const std::vector<int>& indices = csr.getIndices();
+    const std::vector<T>& values = csr.getValues();
+
+    std::vector<Acc> y(A.getRows(), Acc(0));
+    ThreadPool::forEachChunk(pool, A.getRows(), SPARSE_ROW_CHUNK, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            Acc sum = 0;
+            for (size_t p = offsets[i]; p < offsets[i + 1]; ++p) {
+                sum += static_cast<Acc>(values[p]) * static_cast<Acc>(x[indices[p]]);
+            }
+            y[i] = sum;
+        }
+    });
+    return y;
+}
+
+template <typename T, typename Acc>
+BasicMatrix<Acc> sparseDenseMultiply(const BasicSparseMatrix<T>& A, const BasicMatrix<T>& B,
+                                     ThreadPool* pool) {
+    if (A.getCols() != B.getRows()) {
+        throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
+    }
+
+    BasicSparseMatrix<T> csrStorage;
+    const BasicSparseMatrix<T>& csr = asCsr(A, csrStorage);
+    const std::vector<size_t>& offsets = csr.getOffsets();
+    const std::vector<int>& indices = csr.getIndices();
+    const std::vector<T>& values = csr.getValues();
+
+    int N = B.getCols();
+    BasicMatrix<Acc> result(A.getRows(), N);
+
+    // Rows of the result are disjoint, so workers write them in place
+    ThreadPool::forEachChunk(pool, A.getRows(), SPARSE_ROW_CHUNK, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            Acc* c = result.rowPtr(i);
+            for (size_t p = offsets[i]; p < offsets[i + 1]; ++p) {
+                axpyRow<T, Acc>(N, static_cast<Acc>(values[p]), B.rowPtr(indices[p]), c);
+            }
+        }
+    });
+    return result;
+}
+
+// Row accumulator of one worker for sparseSparseMultiply
+template <typename Acc>
+struct SpgemmAccumulator {
+    // Dense mode: value per column, plus the last row that touched it
+    std::vector<Acc> dense;
+    std::vector<int> stamp;
+    // Hash mode: open addressing on column index, -1 marks an empty slot
+    std::vector<int> keys;
+    std::vector<Acc> hashed;
+
+    std::vector<int> touched;
+};
+
+// Results of one row chunk, spliced into the final arrays at the end
+template <typename Acc>
+struct SpgemmChunk {
+    std::vector<size_t> rowCounts;
+    std::vector<int> indices;
+    std::vector<Acc> values;
+};
+
+template <typename T, typename Acc>
+BasicSparseMatrix<Acc> sparseSparseMultiply(const BasicSparseMatrix<T>& A,
+                                            const BasicSparseMatrix<T>& B, ThreadPool* pool) {
+    if (A.getCols() != B.getRows()) {
+        throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
+    }
+
+    BasicSparseMatrix<T> aStorage, bStorage;
+    const BasicSparseMatrix<T>& a = asCsr(A, aStorage);
+    const BasicSparseMatrix<T>& b = asCsr(B, bStorage);
+    const std::vector<size_t>& aOffsets = a.getOffsets();
+    const std::vector<int>& aIndices = a.getIndices();
+    const std::vector<T>& aValues = a.getValues();
+    const std::vector<size_t>& bOffsets = b.getOffsets();
+    const std::vector<int>& bIndices = b.getIndices();
+    const std::vector<T>& bValues = b.getValues();
+
+    int M = A.getRows();
+    int N = B.getCols();
+    int chunks = (M + SPARSE_ROW_CHUNK - 1) / SPARSE_ROW_CHUNK;
+    int workers = pool ? std::max(1, pool->size()) : 1;
+
+    std::vector<SpgemmAccumulator<Acc>> accumulators(workers);
+    std::vector<SpgemmChunk<Acc>> results(chunks);
+
+    ThreadPool::forEachChunk(pool, M, SPARSE_ROW_CHUNK, [&](int begin, int end, int worker) {
+        SpgemmAccumulator<Acc>& acc = accumulators[worker];
+        SpgemmChunk<Acc>& out = results[begin / SPARSE_ROW_CHUNK];
+        out.rowCounts.reserve(end - begin);
+
+        for (int i = begin; i < end; ++i) {
+            // Upper bound on the nonzeros of row i
+            size_t bound = 0;
+            for (size_t p = aOffsets[i]; p < aOffsets[i + 1]; ++p) {
+                bound += bOffsets[aIndices[p] + 1] - bOffsets[aIndices[p]];
+            }
+
+            acc.touched.clear();
+            if (bound * 16 >= static_cast<size_t>(N)) {
+                if (acc.dense.empty()) {
+                    acc.dense.assign(N, Acc(0));
+                    acc.stamp.assign(N, -1);
+                }
+                for (size_t p = aOffsets[i]; p < aOffsets[i + 1]; ++p) {
+                    Acc alpha = static_cast<Acc>(aValues[p]);
+                    int k = aIndices[p];
+                    for (size_t q = bOffsets[k]; q < bOffsets[k + 1]; ++q) {
+                        int j = bIndices[q];
+                        if (acc.stamp[j] != i) {
+                            acc.stamp[j] = i;
+                            acc.dense[j] = 0;
+                            acc.touched.push_back(j);
+                        }
+                        acc.dense[j] += alpha * static_cast<Acc>(bValues[q]);
+                    }
+                }
+                std::sort(acc.touched.begin(), acc.touched.end());
+                for (int j : acc.touched) {
+                    out.indices.push_back(j);
+                    out.values.push_back(acc.dense[j]);
+                }
+            }
+            else if (bound > 0) {
+                size_t capacity = 1;
+                while (capacity < bound * 2) capacity <<= 1;
+                size_t mask = capacity - 1;
+                acc.keys.assign(capacity, -1);
+                acc.hashed.resize(std::max(acc.hashed.size(), capacity));
+
+                for (size_t p = aOffsets[i]; p < aOffsets[i + 1]; ++p) {
+                    Acc alpha = static_cast<Acc>(aValues[p]);
+                    int k = aIndices[p];
+                    for (size_t q = bOffsets[k]; q < bOffsets[k + 1]; ++q) {
+                        int j = bIndices[q];
+                        size_t slot = (static_cast<size_t>(j) * 2654435761u) & mask;
+                        while (acc.keys[slot] != j && acc.keys[slot] != -1) {
+                            slot = (slot + 1) & mask;
+                        }
+                        if (acc.keys[slot] == -1) {
+                            acc.keys[slot] = j;
+                            acc.hashed[slot] = 0;
+                            acc.touched.push_back(static_cast<int>(slot));
+                        }
+                        acc.hashed[slot] += alpha * static_cast<Acc>(bValues[q]);
+                    }
+                }
+                std::sort(acc.touched.begin(), acc.touched.end(),
+                          [&acc](int x, int y) { return acc.keys[x] < acc.keys[y]; });
+                for (int slot : acc.touched) {
+                    out.indices.push_back(acc.keys[slot]);
+                    out.values.push_back(acc.hashed[slot]);
+                }
+            }
+            out.rowCounts.push_back(acc.touched.size());
+        }
+    });
+
+    // Splice the chunks together in row order
+    std::vector<size_t> offsets(static_cast<size_t>(M) + 1, 0);
+    std::vector<size_t> chunkStart(chunks + 1, 0);
+    for (int c = 0; c < chunks; ++c) {
+        int firstRow = c * SPARSE_ROW_CHUNK;
+        for (size_t r = 0; r < results[c].rowCounts.size(); ++r) {
+            offsets[firstRow + r + 1] = offsets[firstRow + r] + results[c].rowCounts[r];
+        }
+        chunkStart[c + 1] = chunkStart[c] + results[c].values.size();
+    }
+
+    std::vector<int> indices(offsets[M]);
+    std::vector<Acc> values(offsets[M]);
+    ThreadPool::forEachChunk(pool, M, SPARSE_ROW_CHUNK, [&](int begin, int, int) {
+        int c = begin / SPARSE_ROW_CHUNK;
+        std::copy(results[c].indices.begin(), results[c].indices.end(),
+                  indices.begin() + chunkStart[c]);
+        std::copy(results[c].values.begin(), results[c].values.end(),
+                  values.begin() + chunkStart[c]);
+        std::vector<int>().swap(results[c].indices);
+        std::vector<Acc>().swap(results[c].values);
+    });
+
+    return BasicSparseMatrix<Acc>(M, N, SparseLayout::CSR, std::move(offsets), std::move(indices),
+                                  std::move(values));
+}
+
+#define INSTANTIATE_SPARSE_MATRIX(T) template class BasicSparseMatrix<T>;
+MATRIX_ELEMENT_TYPES(INSTANTIATE_SPARSE_MATRIX)
+#undef INSTANTIATE_SPARSE_MATRIX
+
+#define INSTANTIATE_SPARSE_PRODUCT(T, Acc)                                                      \
+    template std::vector<Acc> sparseMatVec<T, Acc>(const BasicSparseMatrix<T>&,                \
+                                                   const std::vector<T>&, ThreadPool*);        \
+    template BasicMatrix<Acc> sparseDenseMultiply<T, Acc>(const BasicSparseMatrix<T>&,         \
+                                                          const BasicMatrix<T>&, ThreadPool*); \
+    template BasicSparseMatrix<Acc> sparseSparseMultiply<T, Acc>(const BasicSparseMatrix<T>&,  \
+                                                                 const BasicSparseMatrix<T>&,  \
+                                                                 ThreadPool*);
+MATRIX_PRODUCT_TYPES(INSTANTIATE_SPARSE_PRODUCT)
+#undef INSTANTIATE_SPARSE_PRODUCT
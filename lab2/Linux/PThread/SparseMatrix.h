@@ -0,0 +1,98 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Which dimension is compressed: CSR stores one index list per row,
+// CSC one per column.
+enum class SparseLayout {
+    CSR,
+    CSC
+};
+
+// Compressed sparse matrix. For line l (a row in CSR, a column in CSC) the
+// stored elements are values[offsets[l] .. offsets[l + 1]) at minor positions
+// indices[...] in strictly ascending order.
+template <typename T>
+class BasicSparseMatrix {
+private:
+    SparseLayout layout;
+    int rows;
+    int cols;
+    std::vector<std::size_t> offsets;   // majorCount() + 1 entries
+    std::vector<int> indices;
+    std::vector<T> values;
+
+public:
+    typedef T value_type;
+
+    BasicSparseMatrix();
+
+    // All-zero r x c matrix
+    BasicSparseMatrix(int r, int c, SparseLayout layout = SparseLayout::CSR);
+
+    // Takes ownership of ready-made compressed arrays; throws std::invalid_argument
+    // if they are inconsistent or the indices of a line are not strictly ascending
+    BasicSparseMatrix(int r, int c, SparseLayout layout, std::vector<std::size_t> offsets,
+                      std::vector<int> indices, std::vector<T> values);
+
+    // Keeps the nonzero elements of M
+    static BasicSparseMatrix fromDense(const BasicMatrix<T>& M,
+                                       SparseLayout layout = SparseLayout::CSR);
+    BasicMatrix<T> toDense() const;
+
+    // Same matrix in the other layout (a counting-sort transpose of the index arrays)
+    BasicSparseMatrix toLayout(SparseLayout target) const;
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    SparseLayout getLayout() const { return layout; }
+
+    // Number of compressed lines: rows for CSR, columns for CSC
+    int majorCount() const { return layout == SparseLayout::CSR ? rows : cols; }
+
+    std::size_t nonZeros() const { return values.size(); }
+    double density() const;
+
+    const std::vector<std::size_t>& getOffsets() const { return offsets; }
+    const std::vector<int>& getIndices() const { return indices; }
+    const std::vector<T>& getValues() const { return values; }
+
+    void print(const std::string& name = "", int limit = 6) const;
+
+    // Same shape and the same stored elements (layout-independent)
+    bool equals(const BasicSparseMatrix& other) const;
+};
+
+typedef BasicSparseMatrix<int> SparseMatrix;
+
+// The products below run row-parallel on `pool` (inline when it is null), with
+// rows handed out in small chunks through an atomic cursor so that skewed row
+// lengths do not stall a worker. CSC operands are converted to CSR first.
+// Instantiated for the pairs in MATRIX_PRODUCT_TYPES.
+
+// y = A * x
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+std::vector<Acc> sparseMatVec(const BasicSparseMatrix<T>& A, const std::vector<T>& x,
+                              ThreadPool* pool = nullptr);
+
+// Sparse A (M x K) times dense B (K x N): every stored a(i, k) adds a(i, k) * row k
+// of B into row i of the dense result.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+BasicMatrix<Acc> sparseDenseMultiply(const BasicSparseMatrix<T>& A, const BasicMatrix<T>& B,
+                                     ThreadPool* pool = nullptr);
+
+// Sparse A times sparse B (Gustavson's row-by-row algorithm), result in CSR.
+// Each worker merges a row with its own accumulator: a dense array indexed by
+// column when the row may touch a sizeable part of N, an open-addressing hash
+// table otherwise. Entries that cancel to zero are kept.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+BasicSparseMatrix<Acc> sparseSparseMultiply(const BasicSparseMatrix<T>& A,
+                                            const BasicSparseMatrix<T>& B,
+                                            ThreadPool* pool = nullptr);
+
+#endif // SPARSE_MATRIX_H
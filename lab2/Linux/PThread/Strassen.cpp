@@ -0,0 +1,289 @@
+#include "Strassen.h"
+#include "Gemm.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+// c = a + b (c may be a or b)
+template <typename T>
+static void add(const BasicMatrixView<const T>& a, const BasicMatrixView<const T>& b,
+                const BasicMatrixView<T>& c) {
+    for (int i = 0; i < c.rows; ++i) {
+        const T* x = a.rowPtr(i);
+        const T* y = b.rowPtr(i);
+        T* z = c.rowPtr(i);
+        for (int j = 0; j < c.cols; ++j) z[j] = x[j] + y[j];
+    }
+}
+
+// c = a - b (c may be a or b)
+template <typename T>
+static void sub(const BasicMatrixView<const T>& a, const BasicMatrixView<const T>& b,
+                const BasicMatrixView<T>& c) {
+    for (int i = 0; i < c.rows; ++i) {
+        const T* x = a.rowPtr(i);
+        const T* y = b.rowPtr(i);
+        T* z = c.rowPtr(i);
+        for (int j = 0; j < c.cols; ++j) z[j] = x[j] - y[j];
+    }
+}
+
+// Temporaries of one recursion level. Each thread keeps three buffers per depth
+// (A-quadrant, B-quadrant and C-quadrant sized) and reuses them for every call,
+// growing them only when a larger shape shows up.
+template <typename T>
+static BasicMatrixView<T> scratch(int depth, int slot, int rows, int cols) {
+    static thread_local std::vector<BasicMatrix<T>> buffers;
+
+    size_t index = static_cast<size_t>(depth) * 3 + slot;
+    if (buffers.size() <= index) {
+        buffers.resize(index + 1);
+    }
+    BasicMatrix<T>& buffer = buffers[index];
+    if (buffer.getRows() < rows || buffer.getCols() < cols) {
+        buffer = BasicMatrix<T>(std::max(rows, buffer.getRows()), std::max(cols, buffer.getCols()));
+    }
+    return buffer.block(0, 0, rows, cols);
+}
+
+template <typename T>
+static bool atCutoff(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                     int cutoff) {
+    return A.rows <= cutoff || A.cols <= cutoff || B.cols <= cutoff;
+}
+
+// Splits rows [0, rows) into one contiguous band per worker
+static void parallelRows(ThreadPool* pool, int rows, const std::function<void(int, int)>& fn) {
+    int workers = std::min(rows, pool->size());
+    pool->run(workers, [&](int worker) {
+        int begin = static_cast<int>(static_cast<long long>(rows) * worker / workers);
+        int end = static_cast<int>(static_cast<long long>(rows) * (worker + 1) / workers);
+        fn(begin, end);
+    });
+}
+
+template <typename T>
+static void parallelGemm(ThreadPool* pool, const BasicMatrixView<const T>& A,
+                         const BasicMatrixView<const T>& B, const BasicMatrixView<T>& C,
+                         bool accumulate) {
+    if (pool == nullptr) {
+        gemm<T, T>(A, B, C, accumulate);
+        return;
+    }
+    parallelRows(pool, C.rows, [&](int begin, int end) {
+        gemm<T, T>(A.rowRange(begin, end), B, C.rowRange(begin, end), accumulate);
+    });
+}
+
+// Multiplies the even-sized leading part with `even` and patches the last
+// row / column / k-slice in with gemm()
+template <typename T>
+static void peelOdd(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                    const BasicMatrixView<T>& C, ThreadPool* pool,
+                    const std::function<void(const BasicMatrixView<const T>&, const BasicMatrixView<const T>&,
+                                             const BasicMatrixView<T>&)>& even) {
+    int M = A.rows, K = A.cols, N = B.cols;
+    int m = M & ~1, k = K & ~1, n = N & ~1;
+
+    even(A.block(0, 0, m, k), B.block(0, 0, k, n), C.block(0, 0, m, n));
+    if (k < K) {
+        parallelGemm<T>(pool, A.block(0, k, m, K - k), B.block(k, 0, K - k, n), C.block(0, 0, m, n), true);
+    }
+    if (n < N) {
+        parallelGemm<T>(pool, A.block(0, 0, m, K), B.block(0, n, K, N - n), C.block(0, n, m, N - n), false);
+    }
+    if (m < M) {
+        parallelGemm<T>(pool, A.block(m, 0, M - m, K), B, C.block(m, 0, M - m, N), false);
+    }
+}
+
+// Sequential Strassen-Winograd with three temporaries per level, following the
+// schedule of Douglas et al.: the seven products are written into the quadrants
+// of C and the temporaries so that U1..U7 can be formed in place.
+template <typename T>
+static void winograd(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                     const BasicMatrixView<T>& C, int cutoff, int depth) {
+    if (atCutoff(A, B, cutoff)) {
+        gemm<T, T>(A, B, C);
+        return;
+    }
+    if ((A.rows | A.cols | B.cols) & 1) {
+        peelOdd<T>(A, B, C, nullptr,
+                [&](const BasicMatrixView<const T>& a, const BasicMatrixView<const T>& b,
+                    const BasicMatrixView<T>& c) {
+                    winograd<T>(a, b, c, cutoff, depth);
+                });
+        return;
+    }
+
+    int m = A.rows / 2, k = A.cols / 2, n = B.cols / 2;
+
+    BasicMatrixView<const T> A11 = A.block(0, 0, m, k), A12 = A.block(0, k, m, k);
+    BasicMatrixView<const T> A21 = A.block(m, 0, m, k), A22 = A.block(m, k, m, k);
+    BasicMatrixView<const T> B11 = B.block(0, 0, k, n), B12 = B.block(0, n, k, n);
+    BasicMatrixView<const T> B21 = B.block(k, 0, k, n), B22 = B.block(k, n, k, n);
+    BasicMatrixView<T> C11 = C.block(0, 0, m, n), C12 = C.block(0, n, m, n);
+    BasicMatrixView<T> C21 = C.block(m, 0, m, n), C22 = C.block(m, n, m, n);
+
+    BasicMatrixView<T> X = scratch<T>(depth, 0, m, k);
+    BasicMatrixView<T> Y = scratch<T>(depth, 1, k, n);
+    BasicMatrixView<T> Z = scratch<T>(depth, 2, m, n);
+
+    sub<T>(A11, A21, X);                               // S3
+    sub<T>(B22, B12, Y);                               // T3
+    winograd<T>(X, Y, C21, cutoff, depth + 1);         // P7
+    add<T>(A21, A22, X);                               // S1
+    sub<T>(B12, B11, Y);                               // T1
+    winograd<T>(X, Y, C22, cutoff, depth + 1);         // P5
+    sub<T>(X, A11, X);                                 // S2
+    sub<T>(B22, Y, Y);                                 // T2
+    winograd<T>(X, Y, C12, cutoff, depth + 1);         // P6
+    sub<T>(A12, X, X);                                 // S4
+    winograd<T>(X, B22, C11, cutoff, depth + 1);       // P3
+    winograd<T>(A11, B11, Z, cutoff, depth + 1);       // P1
+    add<T>(Z, C12, C12);                               // U2 = P1 + P6
+    add<T>(C12, C21, C21);                             // U3 = U2 + P7
+    add<T>(C12, C22, C12);                             // U4 = U2 + P5
+    add<T>(C21, C22, C22);                             // U7 = U3 + P5  -> C22
+    add<T>(C12, C11, C12);                             // U5 = U4 + P3  -> C12
+    sub<T>(Y, B21, Y);                                 // T4
+    winograd<T>(A22, Y, C11, cutoff, depth + 1);       // P4
+    sub<T>(C21, C11, C21);                             // U6 = U3 - P4  -> C21
+    winograd<T>(A12, B21, C11, cutoff, depth + 1);     // P2
+    add<T>(C11, Z, C11);                               // U1 = P1 + P2  -> C11
+}
+
+// Top level with a pool: all eight sums are formed up front so the seven
+// products are independent and can run at the same time.
+template <typename T>
+static void parallelTopLevel(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                             const BasicMatrixView<T>& C, int cutoff, ThreadPool* pool) {
+    int m = A.rows / 2, k = A.cols / 2, n = B.cols / 2;
+
+    BasicMatrixView<const T> A11 = A.block(0, 0, m, k), A12 = A.block(0, k, m, k);
+    BasicMatrixView<const T> A21 = A.block(m, 0, m, k), A22 = A.block(m, k, m, k);
+    BasicMatrixView<const T> B11 = B.block(0, 0, k, n), B12 = B.block(0, n, k, n);
+    BasicMatrixView<const T> B21 = B.block(k, 0, k, n), B22 = B.block(k, n, k, n);
+    BasicMatrixView<T> C11 = C.block(0, 0, m, n), C12 = C.block(0, n, m, n);
+    BasicMatrixView<T> C21 = C.block(m, 0, m, n), C22 = C.block(m, n, m, n);
+
+    BasicMatrix<T> S1(m, k), S2(m, k), S3(m, k), S4(m, k);
+    BasicMatrix<T> T1(k, n), T2(k, n), T3(k, n), T4(k, n);
+    BasicMatrix<T> P1(m, n), P6(m, n), P7(m, n);
+
+    parallelRows(pool, std::max(m, k), [&](int begin, int end) {
+        for (int i = begin; i < std::min(end, m); ++i) {
+            const T* a11 = A11.rowPtr(i); const T* a12 = A12.rowPtr(i);
+            const T* a21 = A21.rowPtr(i); const T* a22 = A22.rowPtr(i);
+            T* s1 = S1.rowPtr(i); T* s2 = S2.rowPtr(i);
+            T* s3 = S3.rowPtr(i); T* s4 = S4.rowPtr(i);
+            for (int j = 0; j < k; ++j) {
+                s1[j] = a21[j] + a22[j];
+                s2[j] = s1[j] - a11[j];
+                s3[j] = a11[j] - a21[j];
+                s4[j] = a12[j] - s2[j];
+            }
+        }
+        for (int i = begin; i < std::min(end, k); ++i) {
+            const T* b11 = B11.rowPtr(i); const T* b12 = B12.rowPtr(i);
+            const T* b21 = B21.rowPtr(i); const T* b22 = B22.rowPtr(i);
+            T* t1 = T1.rowPtr(i); T* t2 = T2.rowPtr(i);
+            T* t3 = T3.rowPtr(i); T* t4 = T4.rowPtr(i);
+            for (int j = 0; j < n; ++j) {
+                t1[j] = b12[j] - b11[j];
+                t2[j] = b22[j] - t1[j];
+                t3[j] = b22[j] - b12[j];
+                t4[j] = t2[j] - b21[j];
+            }
+        }
+    });
+
+    // P2..P5 go straight into the C quadrants they end up in
+    struct Product {
+        BasicMatrixView<const T> left;
+        BasicMatrixView<const T> right;
+        BasicMatrixView<T> out;
+    };
+    const Product products[7] = {
+        { A11, B11, P1.view() },
+        { A12, B21, C11 },
+        { S4.view(), B22, C12 },
+        { A22, T4.view(), C21 },
+        { S1.view(), T1.view(), C22 },
+        { S2.view(), T2.view(), P6.view() },
+        { S3.view(), T3.view(), P7.view() },
+    };
+
+    std::atomic<int> next(0);
+    pool->run(7, [&](int) {
+        int p;
+        while ((p = next.fetch_add(1)) < 7) {
+            winograd<T>(products[p].left, products[p].right, products[p].out, cutoff, 1);
+        }
+    });
+
+    parallelRows(pool, m, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const T* p1 = P1.rowPtr(i);
+            const T* p6 = P6.rowPtr(i);
+            const T* p7 = P7.rowPtr(i);
+            T* c11 = C11.rowPtr(i);   // P2
+            T* c12 = C12.rowPtr(i);   // P3
+            T* c21 = C21.rowPtr(i);   // P4
+            T* c22 = C22.rowPtr(i);   // P5
+            for (int j = 0; j < n; ++j) {
+                T u2 = p1[j] + p6[j];
+                T u3 = u2 + p7[j];
+                c11[j] = p1[j] + c11[j];
+                c12[j] = u2 + c22[j] + c12[j];
+                c22[j] = u3 + c22[j];
+                c21[j] = u3 - c21[j];
+            }
+        }
+    });
+}
+
+template <typename T>
+void strassenMultiply(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                      const BasicMatrixView<T>& C, int cutoff, ThreadPool* pool) {
+    if (A.cols != B.rows || C.rows != A.rows || C.cols != B.cols) {
+        throw std::invalid_argument("Incompatible matrix dimensions for multiplication");
+    }
+    if (cutoff < 1) {
+        throw std::invalid_argument("Strassen cutoff must be positive");
+    }
+
+    if (pool == nullptr || pool->size() < 2) {
+        winograd<T>(A, B, C, cutoff, 0);
+        return;
+    }
+
+    if (atCutoff(A, B, cutoff)) {
+        parallelGemm<T>(pool, A, B, C, false);
+        return;
+    }
+    if ((A.rows | A.cols | B.cols) & 1) {
+        peelOdd<T>(A, B, C, pool,
+                [&](const BasicMatrixView<const T>& a, const BasicMatrixView<const T>& b,
+                    const BasicMatrixView<T>& c) {
+                    parallelTopLevel<T>(a, b, c, cutoff, pool);
+                });
+        return;
+    }
+    parallelTopLevel<T>(A, B, C, cutoff, pool);
+}
+
+template void strassenMultiply<std::int32_t>(const BasicMatrixView<const std::int32_t>&,
+                                             const BasicMatrixView<const std::int32_t>&,
+                                             const BasicMatrixView<std::int32_t>&, int, ThreadPool*);
+template void strassenMultiply<std::int64_t>(const BasicMatrixView<const std::int64_t>&,
+                                             const BasicMatrixView<const std::int64_t>&,
+                                             const BasicMatrixView<std::int64_t>&, int, ThreadPool*);
+template void strassenMultiply<float>(const BasicMatrixView<const float>&,
+                                      const BasicMatrixView<const float>&,
+                                      const BasicMatrixView<float>&, int, ThreadPool*);
+template void strassenMultiply<double>(const BasicMatrixView<const double>&,
+                                       const BasicMatrixView<const double>&,
+                                       const BasicMatrixView<double>&, int, ThreadPool*);
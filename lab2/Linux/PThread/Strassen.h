@@ -0,0 +1,36 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// C = A * B using Strassen-Winograd recursion (7 half-size products and
+// 15 additions per level) down to the cutoff, where gemm() takes over
+// (STRASSEN_DEFAULT_CUTOFF, in Matrix.h, unless given).
+// Odd dimensions are peeled off and patched up with gemm().
+// With a pool, the pre/post additions of the top level are split across the
+// workers and its seven products run concurrently; every product then recurses
+// on its own thread with temporaries reused from a per-thread workspace.
+// Integer arithmetic is exact (modulo wraparound, same as gemm()), so integer
+// results are identical to the classical product; floating-point results carry
+// the usual, slightly larger, Strassen rounding error. Operands and result share
+// one element type; instantiated for the accumulator types of MATRIX_PRODUCT_TYPES.
+template <typename T>
+void strassenMultiply(const BasicMatrixView<const T>& A, const BasicMatrixView<const T>& B,
+                      const BasicMatrixView<T>& C,
+                      int cutoff = STRASSEN_DEFAULT_CUTOFF, ThreadPool* pool = nullptr);
+
+// View of M in the accumulator type Strassen runs on: M itself when the types
+// already match, otherwise a widened copy kept in `storage`
+template <typename Acc>
+inline BasicMatrixView<const Acc> widened(const BasicMatrix<Acc>& M, BasicMatrix<Acc>&) {
+    return M.view();
+}
+
+template <typename T, typename Acc>
+inline BasicMatrixView<const Acc> widened(const BasicMatrix<T>& M, BasicMatrix<Acc>& storage) {
+    storage = M.template convert<Acc>();
+    return storage.view();
+}
+
+#endif // STRASSEN_H
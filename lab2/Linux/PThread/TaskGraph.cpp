@@ -0,0 +1,109 @@
+#include "TaskGraph.h"
+#include <pthread.h>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+int TaskGraph::add(const std::function<void()>& fn) {
+    Task task;
+    task.fn = fn;
+    task.prerequisites = 0;
+    tasks.push_back(task);
+    return static_cast<int>(tasks.size()) - 1;
+}
+
+void TaskGraph::depend(int task, int prerequisite) {
+    if (task < 0 || task >= size() || prerequisite < 0 || prerequisite >= task) {
+        throw std::invalid_argument("A prerequisite must be an earlier task");
+    }
+    tasks[prerequisite].successors.push_back(task);
+    ++tasks[task].prerequisites;
+}
+
+// State of one run(), shared by its workers and guarded by mutex
+struct TaskGraphRun {
+    pthread_mutex_t mutex;
+    pthread_cond_t readyCond;
+    std::vector<int> pending;   // unfinished prerequisites per task
+    std::vector<int> ready;     // stack: the newest ready task runs first
+    int finished;
+    std::exception_ptr error;
+};
+
+void TaskGraph::run(ThreadPool* pool, int workers) {
+    int total = size();
+    if (total == 0) {
+        return;
+    }
+
+    TaskGraphRun state;
+    pthread_mutex_init(&state.mutex, nullptr);
+    pthread_cond_init(&state.readyCond, nullptr);
+    state.finished = 0;
+    state.pending.resize(total);
+    for (int t = total - 1; t >= 0; --t) {
+        state.pending[t] = tasks[t].prerequisites;
+        if (state.pending[t] == 0) {
+            // Pushed backwards so the initial tasks start in id order
+            state.ready.push_back(t);
+        }
+    }
+
+    auto work = [this, &state, total](int) {
+        pthread_mutex_lock(&state.mutex);
+        while (true) {
+            while (state.ready.empty() && state.finished < total && !state.error) {
+                pthread_cond_wait(&state.readyCond, &state.mutex);
+            }
+            if (state.finished == total || state.error) {
+                break;
+            }
+            int t = state.ready.back();
+            state.ready.pop_back();
+            pthread_mutex_unlock(&state.mutex);
+
+            std::exception_ptr failure;
+            try {
+                tasks[t].fn();
+            }
+            catch (...) {
+                failure = std::current_exception();
+            }
+
+            pthread_mutex_lock(&state.mutex);
+            if (failure) {
+                if (!state.error) {
+                    state.error = failure;
+                }
+                pthread_cond_broadcast(&state.readyCond);
+                break;
+            }
+            ++state.finished;
+            bool woke = false;
+            for (int next : tasks[t].successors) {
+                if (--state.pending[next] == 0) {
+                    state.ready.push_back(next);
+                    woke = true;
+                }
+            }
+            if (woke || state.finished == total) {
+                pthread_cond_broadcast(&state.readyCond);
+            }
+        }
+        pthread_mutex_unlock(&state.mutex);
+    };
+
+    if (pool == nullptr) {
+        work(0);
+    }
+    else {
+        int threads = workers > 0 ? std::min(workers, pool->size()) : pool->size();
+        pool->run(std::min(threads, total), work);
+    }
+
+    pthread_cond_destroy(&state.readyCond);
+    pthread_mutex_destroy(&state.mutex);
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+}
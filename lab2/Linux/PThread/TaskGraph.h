@@ -0,0 +1,40 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include "ThreadPool.h"
+#include <functional>
+#include <vector>
+
+// Tasks with dependencies, run on a thread pool without barriers between them:
+// a task becomes ready the moment its last prerequisite finishes, and workers
+// take the most recently readied task first, so consumers follow their
+// producers while the data is still in cache.
+// A prerequisite must be added before the task that waits for it, which makes
+// every graph acyclic by construction.
+class TaskGraph {
+private:
+    struct Task {
+        std::function<void()> fn;
+        std::vector<int> successors;
+        int prerequisites;
+    };
+
+    std::vector<Task> tasks;
+
+public:
+    // Id of the new task (ids count up from 0)
+    int add(const std::function<void()>& fn);
+
+    // `task` starts only after `prerequisite` has finished; prerequisite < task
+    void depend(int task, int prerequisite);
+
+    int size() const { return static_cast<int>(tasks.size()); }
+
+    // Runs every task once on up to `workers` pool threads (0: the whole pool),
+    // inline without a pool. The first exception thrown by a task is rethrown
+    // once the running tasks are done; no task starts after it. The graph can
+    // be run again.
+    void run(ThreadPool* pool = nullptr, int workers = 0);
+};
+
+#endif // TASK_GRAPH_H
@@ -0,0 +1,179 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+// Pool whose job the current thread is executing, if any
+static thread_local const ThreadPool* currentPool = nullptr;
+
+ThreadPool::ThreadPool(int threadCount)
+    : job(nullptr), jobWorkers(0), generation(0), pending(0), stopping(false) {
+    if (threadCount <= 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount <= 0) threadCount = 8;
+    }
+
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&wakeCond, nullptr);
+    pthread_cond_init(&doneCond, nullptr);
+    pthread_mutex_init(&runMutex, nullptr);
+
+    threads.reserve(threadCount);
+    args.resize(threadCount);
+
+    for (int i = 0; i < threadCount; i++) {
+        args[i].pool = this;
+        args[i].index = i;
+
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, workerMain, &args[i]) != 0) {
+            shutdown();
+            throw std::runtime_error("Failed to create thread");
+        }
+        threads.push_back(thread);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+void ThreadPool::shutdown() {
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_broadcast(&wakeCond);
+    pthread_mutex_unlock(&mutex);
+
+    for (pthread_t thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+    threads.clear();
+
+    pthread_mutex_destroy(&runMutex);
+    pthread_cond_destroy(&doneCond);
+    pthread_cond_destroy(&wakeCond);
+    pthread_mutex_destroy(&mutex);
+}
+
+void* ThreadPool::workerMain(void* arg) {
+    WorkerArg* workerArg = static_cast<WorkerArg*>(arg);
+    workerArg->pool->workerLoop(workerArg->index);
+    return nullptr;
+}
+
+void ThreadPool::workerLoop(int index) {
+    currentPool = this;
+    unsigned long long seen = 0;
+
+    while (true) {
+        pthread_mutex_lock(&mutex);
+        while (!stopping && generation == seen) {
+            pthread_cond_wait(&wakeCond, &mutex);
+        }
+        if (stopping) {
+            pthread_mutex_unlock(&mutex);
+            break;
+        }
+        seen = generation;
+        const std::function<void(int)>* fn = job;
+        bool participate = index < jobWorkers;
+        pthread_mutex_unlock(&mutex);
+
+        if (!participate) {
+            continue;
+        }
+
+        std::exception_ptr thrown;
+        try {
+            (*fn)(index);
+        }
+        catch (...) {
+            thrown = std::current_exception();
+        }
+
+        pthread_mutex_lock(&mutex);
+        if (thrown && !error) {
+            error = thrown;
+        }
+        if (--pending == 0) {
+            pthread_cond_signal(&doneCond);
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+int ThreadPool::size() const {
+    return static_cast<int>(threads.size());
+}
+
+void ThreadPool::run(int workers, const std::function<void(int)>& fn) {
+    workers = std::min(workers, size());
+    if (workers <= 0) {
+        return;
+    }
+
+    if (currentPool == this) {
+        for (int i = 0; i < workers; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&runMutex);
+    pthread_mutex_lock(&mutex);
+
+    job = &fn;
+    jobWorkers = workers;
+    pending = workers;
+    error = nullptr;
+    ++generation;
+    pthread_cond_broadcast(&wakeCond);
+
+    while (pending > 0) {
+        pthread_cond_wait(&doneCond, &mutex);
+    }
+
+    std::exception_ptr thrown = error;
+    error = nullptr;
+    job = nullptr;
+
+    pthread_mutex_unlock(&mutex);
+    pthread_mutex_unlock(&runMutex);
+
+    if (thrown) {
+        std::rethrow_exception(thrown);
+    }
+}
+
+int ThreadPool::forEachChunk(ThreadPool* pool, int count, int chunk,
+                             const std::function<void(int, int, int)>& fn, int workers) {
+    if (chunk <= 0) {
+        throw std::invalid_argument("Chunk size must be positive");
+    }
+    int chunks = static_cast<int>((static_cast<long long>(count) + chunk - 1) / chunk);
+    int threads = 1;
+    if (pool != nullptr) {
+        threads = workers > 0 ? std::min(workers, pool->size()) : pool->size();
+        threads = std::min(threads, chunks);
+    }
+    std::atomic<int> nextChunk(0);
+
+    auto work = [&](int worker) {
+        while (true) {
+            int c = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunks) {
+                break;
+            }
+            int begin = static_cast<int>(static_cast<long long>(c) * chunk);
+            fn(begin, count - begin > chunk ? begin + chunk : count, worker);
+        }
+    };
+
+    if (threads <= 1) {
+        work(0);
+        return 1;
+    }
+    pool->run(threads, work);
+    return threads;
+}
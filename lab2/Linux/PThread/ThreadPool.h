@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <exception>
+#include <functional>
+#include <vector>
+
+// Fixed set of pthreads created once and parked on a condition variable.
+// run() hands one job to the first `workers` threads and waits for all of them,
+// so the per-call cost is a wakeup plus a barrier instead of create/join.
+class ThreadPool {
+private:
+    struct WorkerArg {
+        ThreadPool* pool;
+        int index;
+    };
+
+    std::vector<pthread_t> threads;
+    std::vector<WorkerArg> args;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeCond;
+    pthread_cond_t doneCond;
+    pthread_mutex_t runMutex;   // serializes concurrent run() callers
+
+    // Current job, guarded by mutex
+    const std::function<void(int)>* job;
+    int jobWorkers;
+    unsigned long long generation;
+    int pending;
+    bool stopping;
+    std::exception_ptr error;
+
+    static void* workerMain(void* arg);
+    void workerLoop(int index);
+    void shutdown();
+
+public:
+    // threadCount <= 0 means one thread per hardware thread
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const;
+
+    // Calls fn(worker) for worker in [0, workers) on pool threads and returns
+    // when every call has finished. workers is clamped to size(). The first
+    // exception thrown by fn is rethrown here. Called from inside a pool job,
+    // the calls run inline on the calling thread instead of deadlocking.
+    void run(int workers, const std::function<void(int)>& fn);
+
+    // Cuts [0, count) into pieces of `chunk` indices that the workers claim
+    // from a shared atomic cursor, calling fn(begin, end, worker) for each.
+    // Uses up to `workers` threads of the pool (0: all of them), never more
+    // than there are chunks; runs inline without a pool or with one chunk.
+    // Returns the number of workers that ran.
+    static int forEachChunk(ThreadPool* pool, int count, int chunk,
+                            const std::function<void(int, int, int)>& fn, int workers = 0);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,165 @@
+#include "Transpose.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TRANSPOSE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Transposes one SIZE x SIZE block: s has row stride ls, d row stride ld
+// (in elements). The default moves a single element.
+template <typename T, std::size_t Bytes = sizeof(T)>
+struct TransposeBlock {
+    static const int SIZE = 1;
+    static void apply(const T* s, std::size_t, T* d, std::size_t) { *d = *s; }
+};
+
+#ifdef TRANSPOSE_SSE2
+
+static inline __m128i loadRow(const void* p) {
+    return _mm_loadu_si128(static_cast<const __m128i*>(p));
+}
+
+static inline void storeRow(void* p, __m128i v) {
+    _mm_storeu_si128(static_cast<__m128i*>(p), v);
+}
+
+// 8 x 8 of 16-bit: three rounds of interleaving, 16-, 32- then 64-bit pairs
+template <typename T>
+struct TransposeBlock<T, 2> {
+    static const int SIZE = 8;
+    static void apply(const T* s, std::size_t ls, T* d, std::size_t ld) {
+        __m128i r[8], t[8], u[8];
+        for (int i = 0; i < 8; ++i) r[i] = loadRow(s + i * ls);
+        for (int i = 0; i < 8; i += 2) {
+            t[i] = _mm_unpacklo_epi16(r[i], r[i + 1]);
+            t[i + 1] = _mm_unpackhi_epi16(r[i], r[i + 1]);
+        }
+        for (int i = 0; i < 8; i += 4) {
+            u[i] = _mm_unpacklo_epi32(t[i], t[i + 2]);
+            u[i + 1] = _mm_unpackhi_epi32(t[i], t[i + 2]);
+            u[i + 2] = _mm_unpacklo_epi32(t[i + 1], t[i + 3]);
+            u[i + 3] = _mm_unpackhi_epi32(t[i + 1], t[i + 3]);
+        }
+        for (int i = 0; i < 4; ++i) {
+            storeRow(d + (2 * i) * ld, _mm_unpacklo_epi64(u[i], u[i + 4]));
+            storeRow(d + (2 * i + 1) * ld, _mm_unpackhi_epi64(u[i], u[i + 4]));
+        }
+    }
+};
+
+// 4 x 4 of 32-bit (int32 and float alike: only bits are moved)
+template <typename T>
+struct TransposeBlock<T, 4> {
+    static const int SIZE = 4;
+    static void apply(const T* s, std::size_t ls, T* d, std::size_t ld) {
+        __m128i r0 = loadRow(s);
+        __m128i r1 = loadRow(s + ls);
+        __m128i r2 = loadRow(s + 2 * ls);
+        __m128i r3 = loadRow(s + 3 * ls);
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+        storeRow(d, _mm_unpacklo_epi64(t0, t1));
+        storeRow(d + ld, _mm_unpackhi_epi64(t0, t1));
+        storeRow(d + 2 * ld, _mm_unpacklo_epi64(t2, t3));
+        storeRow(d + 3 * ld, _mm_unpackhi_epi64(t2, t3));
+    }
+};
+
+// 2 x 2 of 64-bit
+template <typename T>
+struct TransposeBlock<T, 8> {
+    static const int SIZE = 2;
+    static void apply(const T* s, std::size_t ls, T* d, std::size_t ld) {
+        __m128i r0 = loadRow(s);
+        __m128i r1 = loadRow(s + ls);
+        storeRow(d, _mm_unpacklo_epi64(r0, r1));
+        storeRow(d + ld, _mm_unpackhi_epi64(r0, r1));
+    }
+};
+
+#endif // TRANSPOSE_SSE2
+
+// Blocks up to this many elements are transposed directly (src and dst
+// together stay well inside L1)
+static const int TRANSPOSE_LEAF = 32 * 32;
+
+// Rows of dst per task claimed from the shared cursor
+static const int TRANSPOSE_BAND = 64;
+
+// src rows [r0, r1) x columns [c0, c1) -> dst
+template <typename T>
+static void transposeLeaf(const BasicMatrixView<const T>& src, const BasicMatrixView<T>& dst,
+                          int r0, int r1, int c0, int c1) {
+    const int B = TransposeBlock<T>::SIZE;
+    int i = r0;
+    for (; i + B <= r1; i += B) {
+        int j = c0;
+        for (; j + B <= c1; j += B) {
+            TransposeBlock<T>::apply(src.rowPtr(i) + j, src.stride, dst.rowPtr(j) + i, dst.stride);
+        }
+        for (; j < c1; ++j) {
+            for (int k = i; k < i + B; ++k) dst(j, k) = src(k, j);
+        }
+    }
+    for (; i < r1; ++i) {
+        for (int j = c0; j < c1; ++j) dst(j, i) = src(i, j);
+    }
+}
+
+// Halves the longer side (at a multiple of 8, so leaves keep whole SIMD blocks)
+// until the block is a leaf
+template <typename T>
+static void transposeRecursive(const BasicMatrixView<const T>& src, const BasicMatrixView<T>& dst,
+                               int r0, int r1, int c0, int c1) {
+    int rows = r1 - r0;
+    int cols = c1 - c0;
+    if (static_cast<long long>(rows) * cols <= TRANSPOSE_LEAF || (rows <= 8 && cols <= 8)) {
+        transposeLeaf(src, dst, r0, r1, c0, c1);
+    }
+    else if (rows >= cols) {
+        int mid = r0 + std::max(8, rows / 2 / 8 * 8);
+        transposeRecursive(src, dst, r0, mid, c0, c1);
+        transposeRecursive(src, dst, mid, r1, c0, c1);
+    }
+    else {
+        int mid = c0 + std::max(8, cols / 2 / 8 * 8);
+        transposeRecursive(src, dst, r0, r1, c0, mid);
+        transposeRecursive(src, dst, r0, r1, mid, c1);
+    }
+}
+
+template <typename T>
+void transpose(const BasicMatrixView<const T>& src, const BasicMatrixView<T>& dst,
+               ThreadPool* pool) {
+    if (dst.rows != src.cols || dst.cols != src.rows) {
+        throw std::invalid_argument("Transpose target must be cols x rows of the source");
+    }
+
+    ThreadPool::forEachChunk(pool, src.cols, TRANSPOSE_BAND, [&](int c0, int c1, int) {
+        transposeRecursive(src, dst, 0, src.rows, c0, c1);
+    });
+}
+
+template <typename T>
+BasicMatrix<T> transposed(const BasicMatrix<T>& M, ThreadPool* pool) {
+    // Every element is overwritten, so no zeroing; padding is cleared per row
+    BasicMatrix<T> result = BasicMatrix<T>::uninitialized(M.getCols(), M.getRows());
+    if (result.getStride() > result.getCols()) {
+        for (int i = 0; i < result.getRows(); ++i) {
+            std::fill(result.rowPtr(i) + result.getCols(), result.rowPtr(i) + result.getStride(), T(0));
+        }
+    }
+    transpose<T>(M.view(), result.view(), pool);
+    return result;
+}
+
+#define INSTANTIATE_TRANSPOSE(T)                                                         \
+    template void transpose<T>(const BasicMatrixView<const T>&, const BasicMatrixView<T>&, \
+                               ThreadPool*);                                             \
+    template BasicMatrix<T> transposed<T>(const BasicMatrix<T>&, ThreadPool*);
+MATRIX_ELEMENT_TYPES(INSTANTIATE_TRANSPOSE)
+#undef INSTANTIATE_TRANSPOSE
@@ -0,0 +1,24 @@
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// dst = src^T. dst must be src.cols x src.rows and must not overlap src.
+// Cache-oblivious: the block is halved along its longer side until it fits in
+// L1, so reads and writes both stay within a few cache lines at every level of
+// the hierarchy without tuning a block size. The leaves move 4 x 4 blocks of
+// 32-bit and 8 x 8 blocks of 16-bit elements through SSE2 registers (2 x 2 for
+// 64-bit), other types element by element. With a pool, dst is split into
+// bands of rows that workers claim from a shared cursor, so every thread writes
+// whole cache lines of its own.
+// Instantiated for MATRIX_ELEMENT_TYPES.
+template <typename T>
+void transpose(const BasicMatrixView<const T>& src, const BasicMatrixView<T>& dst,
+               ThreadPool* pool = nullptr);
+
+// Transposed copy of M
+template <typename T>
+BasicMatrix<T> transposed(const BasicMatrix<T>& M, ThreadPool* pool = nullptr);
+
+#endif // TRANSPOSE_H
@@ -1,40 +1,36 @@
 #include "Matrix.h"
 #include "PThreadMultiplier.h"
+#include "SparseMatrix.h"
+#include "MatrixFile.h"
+#include "OutOfCore.h"
+#include "Autotuner.h"
+#include "SimdKernels.h"
+#include "MatrixUtils.h"
+#include "Transpose.h"
+#include "Benchmark.h"
+#include "Distributed.h"
+#include "MortonMatrix.h"
+#include "MatrixGraph.h"
+#include "Gemm.h"
+#include "Gemv.h"
 #include <iostream>
 #include <iomanip>
 #include <chrono>
 #include <vector>
 #include <algorithm>
 #include <climits>
-
-std::vector<int> getBlockSizesToTest(int N) {
-    std::vector<int> blockSizes;
-
-    if (N < 100) {
-        for (int i = 1; i <= N; i++) {
-            blockSizes.push_back(i);
-        }
-    }
-    else {
-        blockSizes.push_back(N);
-
-        for (int k : {N / 2, N / 4, N / 8, 64, 32, 16, 8, 4, 2}) {
-            if (k > 0 && k <= N && std::find(blockSizes.begin(), blockSizes.end(), k) == blockSizes.end()) {
-                blockSizes.push_back(k);
-            }
-        }
-
-        for (int i = 2; i <= N / 10; i++) {
-            if (N % i == 0 && std::find(blockSizes.begin(), blockSizes.end(), i) == blockSizes.end()) {
-                blockSizes.push_back(i);
-            }
-        }
-
-        std::sort(blockSizes.begin(), blockSizes.end());
-    }
-
-    return blockSizes;
-}
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 void testPThreadMultiplication(int matrixSize) {
     std::cout << "Matrix size: " << matrixSize << "x" << matrixSize << std::endl;
@@ -62,50 +58,1030 @@ void testPThreadMultiplication(int matrixSize) {
               << std::setw(15) << "Speedup" << std::endl;
     std::cout << std::string(84, '-') << std::endl;
 
+    // A dozen or so configurations picked by the autotuner instead of every block size
+    Autotuner tuner;
+    TuningEntry tuned = tuner.tune<int, int>(matrixSize, matrixSize, matrixSize);
+
+    for (const TuningTrial& trial : tuner.getLastTrials()) {
+        int blocksPerDim = (matrixSize + trial.blockSize - 1) / trial.blockSize;
+        int totalBlocks = blocksPerDim * blocksPerDim;
+        double speedup = (trial.time > 0) ? static_cast<double>(timeSeq) / trial.time : 0.0;
+
+        std::cout << std::setw(10) << trial.blockSize
+                  << std::setw(12) << blocksPerDim
+                  << std::setw(12) << totalBlocks
+                  << std::setw(15) << std::min(trial.threads, totalBlocks)
+                  << std::setw(20) << trial.time
+                  << std::setw(15) << std::fixed << std::setprecision(2) << speedup
+                  << std::endl;
+    }
+
+    // With no block size the multiplier picks the tuned parameters up from the profile
+    PThreadMultiplier multiplier;
+    Matrix parResult = multiplier.multiply(A, B);
+    long long timePar = multiplier.getLastExecutionTime();
+
+    std::cout << std::endl;
+    std::cout << "Tuned: k=" << tuned.blockSize << ", " << tuned.threads << " threads, "
+              << tuned.time << " microseconds (saved to " << TuningProfile::defaultProfile().getPath()
+              << ")" << std::endl;
+    std::cout << "Auto-tuned run: " << timePar << " microseconds (k=" << multiplier.getBlockSize()
+              << ", " << multiplier.getThreadCount() << " threads)" << std::endl;
+    std::cout << "Maximum speedup: " << std::fixed << std::setprecision(2)
+              << static_cast<double>(timeSeq) / std::max(1LL, tuned.time) << "x" << std::endl;
+    std::cout << "Results match: " << (parResult.equals(seqResult) ? "yes" : "no") << std::endl;
+}
+
+void testRectangularMultiplication(int M, int K, int N, int blockSize) {
+    std::cout << "Shape: " << M << "x" << K << " * " << K << "x" << N
+              << " (k=" << blockSize << ")" << std::endl;
+
+    Matrix A(M, K);
+    Matrix B(K, N);
+    A.randomFill(1, 10);
+    B.randomFill(1, 10);
+
+    auto startSeq = std::chrono::high_resolution_clock::now();
+    Matrix seqResult = Matrix::sequentialMultiply(A, B);
+    auto endSeq = std::chrono::high_resolution_clock::now();
+    auto timeSeq = std::chrono::duration_cast<std::chrono::microseconds>(endSeq - startSeq).count();
+
     PThreadMultiplier multiplier;
-    long long bestTime = LLONG_MAX;
-    int bestBlockSize = 1;
+    Matrix parResult = multiplier.multiply(A, B, blockSize);
+    long long timePar = multiplier.getLastExecutionTime();
 
-    std::vector<int> blockSizes = getBlockSizesToTest(matrixSize);
+    std::cout << "Sequential time: " << timeSeq << " microseconds" << std::endl;
+    std::cout << "Parallel time: " << timePar << " microseconds ("
+              << multiplier.getThreadCount() << " threads, "
+              << multiplier.getKSplitCount() << " K-slices)" << std::endl;
+    std::cout << "Results match: " << (parResult.equals(seqResult) ? "yes" : "no") << std::endl;
+}
 
-    for (int blockSize : blockSizes) {
-        try {
-            Matrix parResult = multiplier.multiply(A, B, blockSize);
-            long long timePar = multiplier.getLastExecutionTime();
-            int threads = multiplier.getThreadCount();
+// Both Strassen entry points against the classical product. Odd, non-square
+// shapes with a small cutoff go through several recursion levels and peel an
+// odd row / column off at each of them.
+void testStrassenMultiplication(int M, int K, int N, int cutoff) {
+    Matrix A(M, K);
+    Matrix B(K, N);
+    A.randomFill(-10, 10, 1);
+    B.randomFill(-10, 10, 2);
+
+    auto startSeq = std::chrono::high_resolution_clock::now();
+    Matrix expected = Matrix::sequentialMultiply(A, B);
+    auto endSeq = std::chrono::high_resolution_clock::now();
+    Matrix single = Matrix::strassenMultiply(A, B, cutoff);
+    auto endSingle = std::chrono::high_resolution_clock::now();
+
+    PThreadMultiplier multiplier;
+    Matrix parallel = multiplier.multiplyStrassen(A, B, cutoff);
+
+    std::cout << "Strassen " << M << "x" << K << " * " << K << "x" << N
+              << " (cutoff " << cutoff << "):" << std::endl;
+    std::cout << "Sequential:      " << std::chrono::duration_cast<std::chrono::microseconds>(endSeq - startSeq).count()
+              << " microseconds" << std::endl;
+    std::cout << "Single-threaded: " << std::chrono::duration_cast<std::chrono::microseconds>(endSingle - endSeq).count()
+              << " microseconds, match: " << (single.equals(expected) ? "yes" : "no") << std::endl;
+    std::cout << "PThread:         " << multiplier.getLastExecutionTime()
+              << " microseconds, match: " << (parallel.equals(expected) ? "yes" : "no") << std::endl;
+}
+
+// Every SIMD kernel set this host can run, forced in turn, against the scalar
+// kernels. Odd sizes leave partial tiles and vector tails to every kernel.
+void testSimdKernels(int M, int K, int N) {
+    Matrix A(M, K);
+    Matrix B(K, N);
+    Matrix X(3, K);
+    A.randomFill(-100, 100, 1);
+    B.randomFill(-100, 100, 2);
+    X.randomFill(-100, 100, 3);
+
+    Matrix expectedC(M, N);
+    Matrix expectedGemv(X.getRows(), M);
+    Matrix expectedGevm(1, N);
+    int expectedDot = 0;
+    std::cout << "SIMD kernels against scalar (" << M << "x" << K << " * " << K << "x" << N
+              << "):" << std::endl;
+    for (int i = 0; i <= static_cast<int>(detectSimdIsa()); ++i) {
+        SimdIsa isa = static_cast<SimdIsa>(i);
+        setSimdIsa(isa);
+
+        Matrix C(M, N);
+        Matrix Y(X.getRows(), M);
+        Matrix Z(1, N);
+        gemm<int, int>(A.view(), B.view(), C.view());
+        gemv<int, int>(A.view(), X.view(), Y.view());
+        gevm<int, int>(A.block(0, 0, 1, K), B.view(), Z.view());
+        int dot = dotKernel()(K, A.rowPtr(0), X.rowPtr(0));
+
+        if (isa == SimdIsa::Scalar) {
+            expectedC = C;
+            expectedGemv = Y;
+            expectedGevm = Z;
+            expectedDot = dot;
+        }
+        std::cout << std::left << std::setw(8) << simdIsaName(isa) << std::right
+                  << "gemm match: " << (C.equals(expectedC) ? "yes" : "no")
+                  << ", gemv match: " << (Y.equals(expectedGemv) ? "yes" : "no")
+                  << ", gevm match: " << (Z.equals(expectedGevm) ? "yes" : "no")
+                  << ", dot match: " << (dot == expectedDot ? "yes" : "no") << std::endl;
+    }
+    resetSimdIsa();
+}
+
+template <typename T, typename Acc>
+void testElementType(const char* name, int matrixSize, int blockSize) {
+    BasicMatrix<T> A(matrixSize, matrixSize);
+    BasicMatrix<T> B(matrixSize, matrixSize);
+    A.randomFill(T(1), T(10));
+    B.randomFill(T(1), T(10));
+
+    BasicMatrix<Acc> seqResult = BasicMatrix<T>::template sequentialMultiply<Acc>(A, B);
+
+    PThreadMultiplier multiplier;
+    BasicMatrix<Acc> parResult = multiplier.multiply<T, Acc>(A, B, blockSize);
+
+    std::cout << std::left << std::setw(16) << name
+              << std::right << std::setw(10) << multiplier.getLastExecutionTime() << " microseconds"
+              << "   operands: " << std::setw(6) << sizeof(T) * A.getStride() * A.getRows() / 1024 << " KB"
+              << "   results match: " << (parResult.equals(seqResult) ? "yes" : "no") << std::endl;
+}
+
+// Dense tiled multiply against the sparse kernels on the same random data
+void testSparseMultiplication(int matrixSize, double density) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomSparseFill(density);
+    B.randomSparseFill(density);
+
+    SparseMatrix sparseA = SparseMatrix::fromDense(A);
+    SparseMatrix sparseB = SparseMatrix::fromDense(B);
+
+    PThreadMultiplier multiplier;
+    Matrix denseResult = multiplier.multiply(A, B, 64);
+    long long timeDense = multiplier.getLastExecutionTime();
+
+    Matrix spmmResult = multiplier.multiplySparse(sparseA, B);
+    long long timeSpmm = multiplier.getLastExecutionTime();
+
+    SparseMatrix spgemmResult = multiplier.multiplySparse(sparseA, sparseB);
+    long long timeSpgemm = multiplier.getLastExecutionTime();
+
+    bool match = spmmResult.equals(denseResult) && spgemmResult.toDense().equals(denseResult);
+    std::cout << std::setw(8) << std::fixed << std::setprecision(3) << density * 100 << "%"
+              << std::setw(14) << timeDense
+              << std::setw(14) << timeSpmm
+              << std::setw(14) << timeSpgemm
+              << std::setw(12) << std::setprecision(2) << spgemmResult.density() * 100 << "%"
+              << std::setw(8) << (match ? "yes" : "no") << std::endl;
+}
+
+// Round trip through the binary format: operands are multiplied straight from
+// their mappings and the result is streamed back out one tile row at a time
+void testMatrixFile(int matrixSize, int blockSize) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10);
+    B.randomFill(1, 10);
+    Matrix expected = Matrix::sequentialMultiply(A, B);
+
+    auto startSave = std::chrono::high_resolution_clock::now();
+    saveMatrix("matrix_a.bin", A);
+    saveMatrix("matrix_b.bin", B);
+    auto endSave = std::chrono::high_resolution_clock::now();
+
+    auto startMap = std::chrono::high_resolution_clock::now();
+    MappedMatrix<int> mappedA("matrix_a.bin");
+    MappedMatrix<int> mappedB("matrix_b.bin");
+    auto endMap = std::chrono::high_resolution_clock::now();
+
+    PThreadMultiplier multiplier;
+    MatrixFileWriter<int> writer("matrix_c.bin", matrixSize, matrixSize);
+    for (int row = 0; row < matrixSize; row += blockSize) {
+        int rows = std::min(blockSize, matrixSize - row);
+        Matrix band = multiplier.multiply(mappedA.view().rowRange(row, row + rows),
+                                          mappedB.view(), blockSize);
+        writer.writeRows(band.view());
+    }
+    writer.close();
+
+    bool match = loadMatrix<int>("matrix_c.bin").equals(expected);
+    std::remove("matrix_a.bin");
+    std::remove("matrix_b.bin");
+    std::remove("matrix_c.bin");
+
+    std::cout << "Binary file round trip (" << matrixSize << "x" << matrixSize << "):" << std::endl;
+    std::cout << "Save A, B: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(endSave - startSave).count()
+              << " microseconds" << std::endl;
+    std::cout << "Map A, B: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(endMap - startMap).count()
+              << " microseconds" << std::endl;
+    std::cout << "Results match: " << (match ? "yes" : "no") << std::endl;
+}
+
+// Out-of-core product under a memory budget far below the size of the operands
+void testOutOfCoreMultiplication(int matrixSize, std::size_t memoryBudget) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10);
+    B.randomFill(1, 10);
+    saveMatrix("matrix_a.bin", A);
+    saveMatrix("matrix_b.bin", B);
+
+    OutOfCoreMultiplier multiplier(memoryBudget);
+    multiplier.multiply<int>("matrix_a.bin", "matrix_b.bin", "matrix_c.bin");
+    OutOfCoreTiling tiling = multiplier.getLastTiling();
+
+    bool match = loadMatrix<int>("matrix_c.bin").equals(Matrix::sequentialMultiply(A, B));
+    std::remove("matrix_a.bin");
+    std::remove("matrix_b.bin");
+    std::remove("matrix_c.bin");
+
+    std::cout << "Out-of-core (" << matrixSize << "x" << matrixSize << ", budget "
+              << memoryBudget / 1024 << " KB, tiles " << tiling.mc << "x" << tiling.nc
+              << "x" << tiling.kc << "):" << std::endl;
+    std::cout << "Time: " << multiplier.getLastExecutionTime() << " microseconds, waiting for I/O "
+              << multiplier.getLastIoWaitTime() << " microseconds" << std::endl;
+    std::cout << "Results match: " << (match ? "yes" : "no") << std::endl;
+}
+
+// Same product with free-floating workers and with NUMA-aware placement
+void testNumaPlacement(int matrixSize, int blockSize) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10);
+    B.randomFill(1, 10);
+
+    PThreadMultiplier multiplier;
+    Matrix floating = multiplier.multiply(A, B, blockSize);
+    long long timeFloating = multiplier.getLastExecutionTime();
+
+    PlacementOptions options;
+    options.pinThreads = true;
+    options.numaTiles = true;
+    options.replicateB = true;
+    multiplier.setPlacement(options);
+    Matrix placed = multiplier.multiply(A, B, blockSize);
+    long long timePlaced = multiplier.getLastExecutionTime();
+
+    std::cout << "NUMA placement (" << matrixSize << "x" << matrixSize << ", k=" << blockSize << "):"
+              << std::endl;
+    std::cout << multiplier.getPlacementReport();
+    std::cout << "Unpinned time: " << timeFloating << " microseconds" << std::endl;
+    std::cout << "Placed time: " << timePlaced << " microseconds" << std::endl;
+    std::cout << "Results match: " << (placed.equals(floating) ? "yes" : "no") << std::endl;
+}
+
+// Many tiny products: one call per pair against one batched call
+void testBatchedMultiplication(int matrixSize, int batchSize) {
+    std::vector<Matrix> As, Bs;
+    std::vector<int> packedA, packedB;
+    std::vector<int> packedC(static_cast<size_t>(batchSize) * matrixSize * matrixSize);
+    for (int i = 0; i < batchSize; i++) {
+        As.push_back(Matrix(matrixSize, matrixSize));
+        Bs.push_back(Matrix(matrixSize, matrixSize));
+        As.back().randomFill(1, 10);
+        Bs.back().randomFill(1, 10);
+        for (int r = 0; r < matrixSize; r++) {
+            packedA.insert(packedA.end(), As.back().rowPtr(r), As.back().rowPtr(r) + matrixSize);
+            packedB.insert(packedB.end(), Bs.back().rowPtr(r), Bs.back().rowPtr(r) + matrixSize);
+        }
+    }
+
+    auto startSeq = std::chrono::high_resolution_clock::now();
+    std::vector<Matrix> results;
+    results.reserve(batchSize);
+    for (int i = 0; i < batchSize; i++) {
+        results.push_back(Matrix::sequentialMultiply(As[i], Bs[i]));
+    }
+    auto endSeq = std::chrono::high_resolution_clock::now();
+    auto timeSeq = std::chrono::duration_cast<std::chrono::microseconds>(endSeq - startSeq).count();
+
+    PThreadMultiplier multiplier;
+    StridedBatch<const int> batchA(packedA.data(), batchSize, matrixSize, matrixSize);
+    StridedBatch<const int> batchB(packedB.data(), batchSize, matrixSize, matrixSize);
+    StridedBatch<int> batchC(packedC.data(), batchSize, matrixSize, matrixSize);
+    multiplier.multiplyBatched(batchA, batchB, batchC);
 
-            int blocksPerDim = (matrixSize + blockSize - 1) / blockSize;
-            int totalBlocks = blocksPerDim * blocksPerDim;
+    bool match = true;
+    for (int i = 0; i < batchSize && match; i++) {
+        for (int r = 0; r < matrixSize && match; r++) {
+            match = std::equal(results[i].rowPtr(r), results[i].rowPtr(r) + matrixSize,
+                               batchC[i].rowPtr(r));
+        }
+    }
 
-            double speedup = (timeSeq > 0) ? static_cast<double>(timeSeq) / timePar : 0.0;
+    std::cout << std::setw(6) << matrixSize << std::setw(10) << batchSize
+              << std::setw(16) << timeSeq
+              << std::setw(16) << multiplier.getLastExecutionTime()
+              << std::setw(8) << (match ? "yes" : "no") << std::endl;
+}
 
-            if (timePar < bestTime) {
-                bestTime = timePar;
-                bestBlockSize = blockSize;
-            }
+// C = 2 * A * B - C + bias, clamped to [0, 1000]: separate passes over the
+// returned product against the fused multiplyInto()
+void testFusedMultiplication(int matrixSize) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    Matrix C(matrixSize, matrixSize);
+    A.randomFill(-10, 10);
+    B.randomFill(-10, 10);
+    C.randomFill(-100, 100);
+    std::vector<int> bias(matrixSize);
+    for (int j = 0; j < matrixSize; j++) {
+        bias[j] = j % 7 - 3;
+    }
 
-            std::cout << std::setw(10) << blockSize
-                      << std::setw(12) << blocksPerDim
-                      << std::setw(12) << totalBlocks
-                      << std::setw(15) << threads
-                      << std::setw(20) << timePar
-                      << std::setw(15) << std::fixed << std::setprecision(2) << speedup
-                      << std::endl;
+    PThreadMultiplier multiplier;
 
+    Matrix expected = C;
+    auto startSeparate = std::chrono::high_resolution_clock::now();
+    Matrix product = multiplier.multiply(A, B);
+    for (int i = 0; i < matrixSize; i++) {
+        int* c = expected.rowPtr(i);
+        const int* p = product.rowPtr(i);
+        for (int j = 0; j < matrixSize; j++) {
+            c[j] = std::min(std::max(2 * p[j] - c[j] + bias[j], 0), 1000);
+        }
+    }
+    auto endSeparate = std::chrono::high_resolution_clock::now();
+    auto timeSeparate =
+        std::chrono::duration_cast<std::chrono::microseconds>(endSeparate - startSeparate).count();
+
+    GemmEpilogue<int> epilogue;
+    epilogue.colBias = bias.data();
+    epilogue.activation = GemmActivation::Clamp;
+    epilogue.low = 0;
+    epilogue.high = 1000;
+    multiplier.multiplyInto<int, int>(A.view(), B.view(), C.view(), 2, -1, epilogue);
+
+    std::cout << "Size: " << matrixSize << "x" << matrixSize << std::endl;
+    std::cout << "Multiply, then separate pass: " << timeSeparate << " microseconds" << std::endl;
+    std::cout << "Fused into C:                 " << multiplier.getLastExecutionTime()
+              << " microseconds" << std::endl;
+    std::cout << "Results match: " << (expected.equals(C) ? "yes" : "no") << std::endl;
+}
+
+// Seeded fill and comparison, on one thread and on the whole pool
+void testFillAndCompare(int matrixSize) {
+    ThreadPool pool;
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    A.randomFill(1, 10, 2024);
+    auto mid = std::chrono::high_resolution_clock::now();
+    B.randomFill(1, 10, 2024, &pool);
+    auto end = std::chrono::high_resolution_clock::now();
+    auto timeSerialFill = std::chrono::duration_cast<std::chrono::microseconds>(mid - start).count();
+    auto timePoolFill = std::chrono::duration_cast<std::chrono::microseconds>(end - mid).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    bool same = A.equals(B);
+    mid = std::chrono::high_resolution_clock::now();
+    bool samePool = A.equals(B, &pool);
+    end = std::chrono::high_resolution_clock::now();
+    auto timeSerialEquals = std::chrono::duration_cast<std::chrono::microseconds>(mid - start).count();
+    auto timePoolEquals = std::chrono::duration_cast<std::chrono::microseconds>(end - mid).count();
+
+    B(matrixSize / 2, matrixSize / 3) += 1;
+    MatrixDiff<int> diff = matrixDiff<int>(A.view(), B.view(), &pool);
+
+    std::cout << "Fill and compare (" << matrixSize << "x" << matrixSize << ", "
+              << pool.size() << " threads):" << std::endl;
+    std::cout << "Seeded fill: " << timeSerialFill << " microseconds on 1 thread, "
+              << timePoolFill << " on the pool" << std::endl;
+    std::cout << "Equals: " << timeSerialEquals << " microseconds on 1 thread, "
+              << timePoolEquals << " on the pool" << std::endl;
+    std::cout << "Same matrix for both fills: " << (same && samePool ? "yes" : "no") << std::endl;
+    std::cout << "After one change: " << diff.mismatches << " mismatch at (" << diff.row << ", "
+              << diff.col << "), " << diff.expected << " vs " << diff.actual << std::endl;
+}
+
+// Explicit transpose before the multiply against reading B transposed in place
+void testTransposedMultiplication(int matrixSize) {
+    ThreadPool pool;
+    Matrix A(matrixSize, matrixSize);
+    Matrix Bt(matrixSize, matrixSize);
+    A.randomFill(1, 10, 1, &pool);
+    Bt.randomFill(1, 10, 2, &pool);
+
+    auto startTranspose = std::chrono::high_resolution_clock::now();
+    Matrix B = transposed(Bt, &pool);
+    auto endTranspose = std::chrono::high_resolution_clock::now();
+    auto timeTranspose =
+        std::chrono::duration_cast<std::chrono::microseconds>(endTranspose - startTranspose).count();
+
+    PThreadMultiplier multiplier;
+    Matrix explicitResult = multiplier.multiply(A, B);
+    long long timeExplicit = timeTranspose + multiplier.getLastExecutionTime();
+    Matrix inPlaceResult = multiplier.multiply(MatrixOp::Normal, A, MatrixOp::Transposed, Bt);
+
+    std::cout << "A * B^T (" << matrixSize << "x" << matrixSize << "):" << std::endl;
+    std::cout << "Transpose, then multiply: " << timeExplicit << " microseconds ("
+              << timeTranspose << " in the transpose)" << std::endl;
+    std::cout << "Transposed operand:       " << multiplier.getLastExecutionTime()
+              << " microseconds" << std::endl;
+    std::cout << "Results match: " << (inPlaceResult.equals(explicitResult, &pool) ? "yes" : "no")
+              << std::endl;
+}
+
+// Where the cycles of a multiply go, per worker. Prints "unavailable" where the
+// kernel does not expose hardware counters (VMs, containers, paranoid >= 3).
+void testHardwareCounters(int matrixSize, int blockSize) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10, 1);
+    B.randomFill(1, 10, 2);
+
+    PThreadMultiplier multiplier;
+    multiplier.setCollectCounters(true);
+    multiplier.multiply(A, B, blockSize);
+    const PerfStats& stats = multiplier.getLastCounters();
+
+    std::cout << "Hardware counters (" << matrixSize << "x" << matrixSize << ", block "
+              << blockSize << ", " << multiplier.getLastExecutionTime() << " microseconds):"
+              << std::endl;
+    std::cout << "Total:    " << stats.total.summary() << std::endl;
+    for (int worker = 0; worker < multiplier.getThreadCount(); ++worker) {
+        std::cout << "Worker " << std::setw(2) << worker << ": "
+                  << stats.perThread[worker].summary() << std::endl;
+    }
+}
+
+// Row-major tiled multiply against the cache-oblivious one on Morton storage
+void testMortonMultiplication(int matrixSize) {
+    ThreadPool pool;
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10, 1, &pool);
+    B.randomFill(1, 10, 2, &pool);
+
+    PThreadMultiplier multiplier;
+    Matrix expected = multiplier.multiply(A, B);
+    long long timeTiled = multiplier.getLastExecutionTime();
+
+    auto startConvert = std::chrono::high_resolution_clock::now();
+    MortonMatrix mortonA = MortonMatrix::fromMatrix(A, &pool);
+    MortonMatrix mortonB = MortonMatrix::fromMatrix(B, &pool);
+    auto endConvert = std::chrono::high_resolution_clock::now();
+    auto timeConvert =
+        std::chrono::duration_cast<std::chrono::microseconds>(endConvert - startConvert).count();
+
+    MortonMatrix mortonC = multiplier.multiplyMorton(mortonA, mortonB);
+
+    std::cout << "Morton layout (" << matrixSize << "x" << matrixSize << ", "
+              << MORTON_TILE << "x" << MORTON_TILE << " tiles):" << std::endl;
+    std::cout << "Row-major, tiled:      " << timeTiled << " microseconds (block "
+              << multiplier.getBlockSize() << ")" << std::endl;
+    std::cout << "Morton, recursive:     " << multiplier.getLastExecutionTime()
+              << " microseconds" << std::endl;
+    std::cout << "Conversion of A and B: " << timeConvert << " microseconds" << std::endl;
+    std::cout << "Results match: " << (mortonC.toMatrix(&pool).equals(expected, &pool) ? "yes" : "no")
+              << std::endl;
+}
+
+// Background jobs: one polled and awaited, one cancelled, one past its deadline
+void testAsyncMultiplication(int matrixSize) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10, 1);
+    B.randomFill(1, 10, 2);
+
+    PThreadMultiplier multiplier;
+    Matrix expected = multiplier.multiply(A, B);
+
+    std::cout << "Background multiply (" << matrixSize << "x" << matrixSize << "):" << std::endl;
+
+    MultiplyHandle<int> job = multiplier.multiplyAsync(A, B);
+    int polls = 0;
+    while (!job.waitFor(10)) {
+        ++polls;
+    }
+    std::cout << "Awaited:   " << jobStatusName(job.getStatus()) << " after " << polls
+              << " timed waits, " << job.getExecutionTime() << " microseconds, results match: "
+              << (job.get().equals(expected) ? "yes" : "no") << std::endl;
+
+    MultiplyHandle<int> cancelled = multiplier.multiplyAsync(A, B);
+    cancelled.cancel();
+    cancelled.wait();
+    std::cout << "Cancelled: " << jobStatusName(cancelled.getStatus()) << std::endl;
+
+    MultiplyHandle<int> late = multiplier.multiplyAsync(A, B, 0, 1);
+    try {
+        late.get();
+        std::cout << "Deadline:  finished within 1 ms" << std::endl;
+    }
+    catch (const JobAborted& e) {
+        std::cout << "Deadline:  " << e.what() << " after " << late.getExecutionTime()
+                  << " microseconds" << std::endl;
+    }
+}
+
+// Checking a large product: full recomputation against Freivalds' check, which
+// must also catch a single wrong element
+void testFreivaldsVerification(int matrixSize) {
+    ThreadPool pool;
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10, 1, &pool);
+    B.randomFill(1, 10, 2, &pool);
+
+    PThreadMultiplier multiplier;
+    Matrix C = multiplier.multiply(A, B);
+
+    auto startRecompute = std::chrono::high_resolution_clock::now();
+    bool recomputed = Matrix::sequentialMultiply(A, B).equals(C, &pool);
+    auto endRecompute = std::chrono::high_resolution_clock::now();
+    bool verified = Matrix::verifyProduct(A, B, C, 1e-9, &pool);
+    auto endVerify = std::chrono::high_resolution_clock::now();
+
+    C(matrixSize / 3, matrixSize / 2) += 1;
+    bool corruptedPassed = Matrix::verifyProduct(A, B, C, 1e-9, &pool);
+
+    // Values near the limit of int: the check itself must not overflow
+    Matrix largeA(33, 17);
+    Matrix largeB(17, 65);
+    largeA.randomFill(-10000, 10000, 3, &pool);
+    largeB.randomFill(-10000, 10000, 4, &pool);
+    Matrix largeC = Matrix::sequentialMultiply(largeA, largeB);
+    bool largeVerified = Matrix::verifyProduct(largeA, largeB, largeC, 1e-9, &pool);
+    largeC(20, 40) += 1;
+    bool largeCorruptedPassed = Matrix::verifyProduct(largeA, largeB, largeC, 1e-9, &pool);
+
+    std::cout << "Verifying a " << matrixSize << "x" << matrixSize << " product (PThread: "
+              << multiplier.getLastExecutionTime() << " microseconds):" << std::endl;
+    std::cout << "Recompute and compare: " << (recomputed ? "correct" : "wrong") << ", "
+              << std::chrono::duration_cast<std::chrono::microseconds>(endRecompute - startRecompute).count()
+              << " microseconds" << std::endl;
+    std::cout << "Freivalds, 30 rounds:  " << (verified ? "correct" : "wrong") << ", "
+              << std::chrono::duration_cast<std::chrono::microseconds>(endVerify - endRecompute).count()
+              << " microseconds" << std::endl;
+    std::cout << "One element off by 1:  " << (corruptedPassed ? "missed" : "caught") << std::endl;
+    std::cout << "Large values (33x17x65): " << (largeVerified ? "correct" : "wrong")
+              << ", one element off by 1: " << (largeCorruptedPassed ? "missed" : "caught") << std::endl;
+}
+
+// (A * B) * (C * D) + E: one call per operation against a single tile task graph
+void testMatrixGraph(int matrixSize) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    Matrix C(matrixSize, matrixSize);
+    Matrix D(matrixSize, matrixSize);
+    Matrix E(matrixSize, matrixSize);
+    A.randomFill(-3, 3, 1);
+    B.randomFill(-3, 3, 2);
+    C.randomFill(-3, 3, 3);
+    D.randomFill(-3, 3, 4);
+    E.randomFill(-3, 3, 5);
+
+    PThreadMultiplier multiplier;
+    auto start = std::chrono::high_resolution_clock::now();
+    Matrix AB = multiplier.multiply(A, B);
+    Matrix CD = multiplier.multiply(C, D);
+    Matrix expected = multiplier.multiply(AB, CD);
+    for (int i = 0; i < matrixSize; ++i) {
+        for (int j = 0; j < matrixSize; ++j) {
+            expected(i, j) += E(i, j);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    auto timeCalls = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    MatrixGraph graph;
+    int product = graph.multiply(graph.multiply(graph.input(A), graph.input(B)),
+                                 graph.multiply(graph.input(C), graph.input(D)));
+    int root = graph.add(product, graph.input(E));
+    Matrix result = multiplier.evaluate(graph, root);
+
+    std::cout << "(A*B)*(C*D)+E (" << matrixSize << "x" << matrixSize << "):" << std::endl;
+    std::cout << "Call per operation: " << timeCalls << " microseconds" << std::endl;
+    std::cout << "Task graph:         " << multiplier.getLastExecutionTime() << " microseconds ("
+              << graph.getLastTaskCount() << " tasks of " << graph.getLastTileSize() << "x"
+              << graph.getLastTileSize() << ")" << std::endl;
+    std::cout << "Peak intermediates: " << graph.getLastPeakIntermediateBytes() / (1024 * 1024)
+              << " MB (all three at once: "
+              << 3LL * matrixSize * AB.getStride() * sizeof(int) / (1024 * 1024) << " MB)" << std::endl;
+    std::cout << "Results match: " << (result.equals(expected) ? "yes" : "no") << std::endl;
+}
+
+// A * x and x^T * A as N x 1 / 1 x N products against the vector kernels, then
+// a batch of vectors in one pass over A against one call per vector
+void testMatrixVector(int matrixSize, int vectors) {
+    ThreadPool pool;
+    Matrix A(matrixSize, matrixSize);
+    Matrix X(vectors, matrixSize);
+    A.randomFill(-10, 10, 1, &pool);
+    X.randomFill(-10, 10, 2, &pool);
+    std::vector<int> x(X.rowPtr(0), X.rowPtr(0) + matrixSize);
+    Matrix column(matrixSize, 1);
+    Matrix row(1, matrixSize);
+    for (int i = 0; i < matrixSize; ++i) {
+        column(i, 0) = x[i];
+        row(0, i) = x[i];
+    }
+
+    PThreadMultiplier multiplier;
+    Matrix columnResult = multiplier.multiply(A, column);
+    long long timeColumn = multiplier.getLastExecutionTime();
+    std::vector<int> y = multiplier.multiplyVector(A, x);
+    long long timeGemv = multiplier.getLastExecutionTime();
+    Matrix rowResult = multiplier.multiply(row, A);
+    long long timeRow = multiplier.getLastExecutionTime();
+    std::vector<int> yt = multiplier.multiplyVector(x, A);
+    long long timeGevm = multiplier.getLastExecutionTime();
+
+    bool match = true;
+    for (int i = 0; i < matrixSize; ++i) {
+        match = match && y[i] == columnResult(i, 0) && yt[i] == rowResult(0, i);
+    }
+
+    long long timeSingle = 0;
+    Matrix expected(vectors, matrixSize);
+    for (int v = 0; v < vectors; ++v) {
+        std::vector<int> xv(X.rowPtr(v), X.rowPtr(v) + matrixSize);
+        std::vector<int> yv = multiplier.multiplyVector(A, xv);
+        timeSingle += multiplier.getLastExecutionTime();
+        std::copy(yv.begin(), yv.end(), expected.rowPtr(v));
+    }
+    Matrix batch = multiplier.multiplyVectors(A, X);
+    long long timeBatch = multiplier.getLastExecutionTime();
+    Matrix batchLeft = multiplier.multiplyVectorsLeft(X, A);
+    long long timeBatchLeft = multiplier.getLastExecutionTime();
+    match = match && batch.equals(expected) &&
+            batchLeft.equals(multiplier.multiply(X, A));
+
+    // A is read once per call, so bytes of A per second is the figure to watch
+    double bytes = static_cast<double>(matrixSize) * matrixSize * sizeof(int);
+    auto rate = [bytes](long long micros) { return bytes / std::max(micros, 1LL) / 1000.0; };
+    std::cout << "Matrix-vector products (" << matrixSize << "x" << matrixSize << ", "
+              << multiplier.getThreadCount() << " threads):" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "A * x as N x 1 multiply:    " << std::setw(8) << timeColumn << " microseconds" << std::endl;
+    std::cout << "A * x, GEMV:                " << std::setw(8) << timeGemv << " microseconds ("
+              << rate(timeGemv) << " GB/s)" << std::endl;
+    std::cout << "x^T * A as 1 x N multiply:  " << std::setw(8) << timeRow << " microseconds" << std::endl;
+    std::cout << "x^T * A, GEVM:              " << std::setw(8) << timeGevm << " microseconds ("
+              << rate(timeGevm) << " GB/s)" << std::endl;
+    std::cout << vectors << " vectors, one call each: " << std::setw(8) << timeSingle << " microseconds" << std::endl;
+    std::cout << vectors << " vectors, one batch:     " << std::setw(8) << timeBatch << " microseconds" << std::endl;
+    std::cout << vectors << " vectors, batch x^T * A: " << std::setw(8) << timeBatchLeft << " microseconds" << std::endl;
+    std::cout << "Results match: " << (match ? "yes" : "no") << std::endl;
+}
+
+// SUMMA over worker processes with both transports against the threaded multiply
+void testDistributedMultiplication(int matrixSize, int processes) {
+    Matrix A(matrixSize, matrixSize);
+    Matrix B(matrixSize, matrixSize);
+    A.randomFill(1, 10, 1);
+    B.randomFill(1, 10, 2);
+
+    PThreadMultiplier multiplier;
+    Matrix expected = multiplier.multiply(A, B);
+
+    std::cout << "SUMMA (" << matrixSize << "x" << matrixSize << ", " << processes
+              << " processes), PThread: " << multiplier.getLastExecutionTime()
+              << " microseconds" << std::endl;
+    const DistributedTransport transports[] = { DistributedTransport::SharedMemory,
+                                                DistributedTransport::UnixSockets };
+    for (DistributedTransport transport : transports) {
+        DistributedOptions options;
+        options.processes = processes;
+        options.transport = transport;
+        DistributedMultiplier distributed(options);
+        Matrix result = distributed.multiply(A, B);
+
+        std::cout << std::left << std::setw(15)
+                  << (transport == DistributedTransport::SharedMemory ? "Shared memory:" : "Unix sockets:")
+                  << std::right << distributed.getLastExecutionTime() << " microseconds ("
+                  << distributed.getGrid().rows << "x" << distributed.getGrid().cols << " grid, "
+                  << distributed.getLastCommunicationTime() << " in broadcasts), match: "
+                  << (result.equals(expected) ? "yes" : "no") << std::endl;
+
+        // A failing coordinator kills the workers; its own error must come out,
+        // not the kills
+        std::unique_ptr<Communicator> comm = transport == DistributedTransport::SharedMemory
+                                                 ? createSharedMemoryCommunicator(3)
+                                                 : createSocketCommunicator(3);
+        std::string reported;
+        try {
+            runProcessGroup(*comm,
+                            [](Communicator& c) {
+                                int token = 0;
+                                c.recv(c.size() - 1, &token, sizeof(token));
+                            },
+                            [](Communicator&) { throw std::runtime_error("coordinator failed"); });
         }
         catch (const std::exception& e) {
-            std::cout << "Error with k=" << blockSize << ": " << e.what() << std::endl;
+            reported = e.what();
         }
+        std::cout << std::string(15, ' ') << "coordinator error reported: "
+                  << (reported == "coordinator failed" ? "yes" : "no (" + reported + ")") << std::endl;
     }
+}
 
-    std::cout << std::endl;
-    std::cout << "Best parallel time: " << bestTime << " microseconds (k=" << bestBlockSize << ")" << std::endl;
-    std::cout << "Maximum speedup: " << std::fixed << std::setprecision(2)
-              << static_cast<double>(timeSeq) / bestTime << "x" << std::endl;
+// std::thread counterpart of PThreadMultiplier for the benchmark: threads are
+// created for every call (as in the STDThread lab) and claim tiles from a shared
+// counter, each tile through the same packed gemm()
+Matrix stdThreadMultiply(const Matrix& A, const Matrix& B, int blockSize, int threads) {
+    int M = A.getRows();
+    int N = B.getCols();
+    int K = A.getCols();
+    Matrix C(M, N);
+    int colBlocks = (N + blockSize - 1) / blockSize;
+    int tiles = ((M + blockSize - 1) / blockSize) * colBlocks;
+    std::atomic<int> next(0);
+
+    auto work = [&]() {
+        for (int t = next.fetch_add(1); t < tiles; t = next.fetch_add(1)) {
+            int row = t / colBlocks * blockSize;
+            int col = t % colBlocks * blockSize;
+            int rows = std::min(blockSize, M - row);
+            int cols = std::min(blockSize, N - col);
+            gemm<int, int>(A.block(row, 0, rows, K), B.block(0, col, K, cols),
+                           C.block(row, col, rows, cols));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < std::min(threads, tiles); i++) {
+        pool.push_back(std::thread(work));
+    }
+    work();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    return C;
 }
 
-int main() {
+// What --benchmark runs and where the results go
+struct BenchmarkCommand {
+    bool enabled;
+    std::vector<int> sizes;
+    std::vector<int> blockSizes;
+    BenchmarkOptions options;
+    std::string jsonPath;
+    std::string csvPath;
+    std::string baselinePath;
+    double tolerance;
+    bool counters;
+    bool verify;
+    double verifyBound;
+
+    BenchmarkCommand() : enabled(false), sizes({256, 512, 1024}), blockSizes({32, 64, 128}),
+                         tolerance(0.10), counters(false), verify(false), verifyBound(1e-9) {}
+};
+
+// Sequential, PThread (pool) and std::thread (threads per call) multipliers on
+// square int32 products. Returns the exit status: 1 if a baseline was given
+// and some case got slower than the tolerance allows, or a result failed --verify.
+int runBenchmarks(const BenchmarkCommand& command) {
+    // Fail before spending minutes on the runs
+    if (!command.baselinePath.empty() && !std::ifstream(command.baselinePath.c_str())) {
+        throw std::runtime_error("Cannot open benchmark baseline '" + command.baselinePath + "'");
+    }
+
+    BenchmarkSuite suite(command.options);
+    PThreadMultiplier multiplier;
+    int threads = multiplier.getPoolSize();
+
+    // Pool workers count themselves; the sequential and std::thread cases run
+    // on this thread and on threads it creates, which an inherited counter covers
+    std::function<PerfCounts()> poolCounters, callerCounters;
+    std::unique_ptr<ThreadCounters> caller;
+    PerfCounts callerLast;
+    auto counted = [&](const std::function<void()>& fn) -> std::function<void()> {
+        if (!caller) return fn;
+        ThreadCounters* counters = caller.get();
+        return [counters, &callerLast, fn]() {
+            counters->start();
+            fn();
+            callerLast = counters->stop();
+        };
+    };
+    if (command.counters) {
+        multiplier.setCollectCounters(true);
+        caller.reset(new ThreadCounters(true));
+        poolCounters = [&]() { return multiplier.getLastCounters().total; };
+        callerCounters = [&]() { return callerLast; };
+        if (!caller->anyOpen()) {
+            std::cerr << "Hardware counters unavailable (perf_event_open refused, see "
+                      << "/proc/sys/kernel/perf_event_paranoid)" << std::endl;
+        }
+    }
+
+    // --verify: the last result of every case goes through Freivalds' check,
+    // outside the timed runs
+    std::unique_ptr<ThreadPool> verifyPool;
+    if (command.verify) {
+        verifyPool.reset(new ThreadPool());
+    }
+    std::vector<std::string> verifyFailures;
+    int verified = 0;
+    long long verifyTime = 0;
+    Matrix last;
+    auto keep = [&](const std::function<Matrix()>& fn) -> std::function<void()> {
+        if (!command.verify) return [fn]() { fn(); };
+        return [&last, fn]() { last = fn(); };
+    };
+    auto verify = [&](const Matrix& A, const Matrix& B, const BenchmarkCase& config) {
+        if (!command.verify) return;
+        auto start = std::chrono::high_resolution_clock::now();
+        bool ok = Matrix::verifyProduct(A, B, last, command.verifyBound, verifyPool.get());
+        auto end = std::chrono::high_resolution_clock::now();
+        verifyTime += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        ++verified;
+        if (!ok) {
+            std::ostringstream name;
+            name << config.multiplier << " n=" << config.M << " block=" << config.blockSize;
+            verifyFailures.push_back(name.str());
+        }
+    };
+
+    for (int size : command.sizes) {
+        Matrix A(size, size);
+        Matrix B(size, size);
+        A.randomFill(1, 10, 1);
+        B.randomFill(1, 10, 2);
+
+        BenchmarkCase config = { "sequential", "int32", size, size, size, 0, 1, 4, 4 };
+        suite.run(config, counted(keep([&]() { return Matrix::sequentialMultiply(A, B); })),
+                  callerCounters);
+        verify(A, B, config);
+
+        // Block size 0: tuned or heuristic (see PThreadMultiplier::multiply)
+        config.multiplier = "pthread";
+        config.threads = threads;
+        suite.run(config, keep([&]() { return multiplier.multiply(A, B, 0); }), poolCounters);
+        verify(A, B, config);
+
+        for (int blockSize : command.blockSizes) {
+            config.blockSize = blockSize;
+            config.multiplier = "pthread";
+            suite.run(config, keep([&]() { return multiplier.multiply(A, B, blockSize); }),
+                      poolCounters);
+            verify(A, B, config);
+            config.multiplier = "stdthread";
+            suite.run(config,
+                      counted(keep([&]() { return stdThreadMultiply(A, B, blockSize, threads); })),
+                      callerCounters);
+            verify(A, B, config);
+        }
+    }
+
+    suite.printTable(std::cout);
+
+    int status = 0;
+    if (command.verify) {
+        std::cout << std::endl << "Freivalds verification (error bound " << command.verifyBound << "): "
+                  << verified - static_cast<int>(verifyFailures.size()) << "/" << verified
+                  << " results correct, " << verifyTime << " microseconds" << std::endl;
+        for (const std::string& failure : verifyFailures) {
+            std::cout << "Wrong result: " << failure << std::endl;
+        }
+        if (!verifyFailures.empty()) {
+            status = 1;
+        }
+    }
+
+    if (!command.jsonPath.empty()) {
+        std::ofstream out(command.jsonPath.c_str());
+        suite.writeJson(out);
+        std::cout << "JSON written to " << command.jsonPath << std::endl;
+    }
+    if (!command.csvPath.empty()) {
+        std::ofstream out(command.csvPath.c_str());
+        suite.writeCsv(out);
+        std::cout << "CSV written to " << command.csvPath << std::endl;
+    }
+    if (!command.baselinePath.empty()) {
+        std::cout << std::endl << "Median time against " << command.baselinePath << ":" << std::endl;
+        int regressions = suite.compareWithBaseline(command.baselinePath, command.tolerance, std::cout);
+        std::cout << regressions << " regression(s) beyond " << command.tolerance * 100.0 << "%"
+                  << std::endl;
+        if (regressions > 0) {
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// "256,512,1024" -> {256, 512, 1024}; false on anything that is not a positive list
+bool parseSizeList(const char* text, std::vector<int>& values) {
+    values.clear();
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        int value = std::atoi(item.c_str());
+        if (value <= 0) return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--benchmark [options]]\n"
+              << "  --sizes LIST       matrix sizes, e.g. 256,512,1024\n"
+              << "  --blocks LIST      block sizes for the threaded multipliers\n"
+              << "  --warmup N         untimed runs per case (default 1)\n"
+              << "  --repeats N        timed runs per case (default 5)\n"
+              << "  --json FILE        write results as JSON\n"
+              << "  --csv FILE         write results as CSV\n"
+              << "  --baseline FILE    compare with a CSV from an earlier run\n"
+              << "  --tolerance X      allowed slowdown against the baseline (default 0.10)\n"
+              << "  --counters         collect cycles, instructions and cache / TLB misses\n"
+              << "  --verify           check every result with Freivalds' algorithm\n"
+              << "  --verify-bound X   chance of accepting a wrong result (default 1e-9)\n";
+}
+
+// Returns false (after printing the usage) on an unknown or incomplete option
+bool parseArguments(int argc, char** argv, BenchmarkCommand& command) {
+    static const char* const valueOptions[] = { "--sizes", "--blocks", "--warmup", "--repeats",
+                                                "--json", "--csv", "--baseline", "--tolerance",
+                                                "--verify-bound" };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark") {
+            command.enabled = true;
+            continue;
+        }
+        if (arg == "--counters") {
+            command.counters = true;
+            continue;
+        }
+        if (arg == "--verify") {
+            command.verify = true;
+            continue;
+        }
+        if (std::find(std::begin(valueOptions), std::end(valueOptions), arg) ==
+            std::end(valueOptions)) {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        bool ok = true;
+        if (value == nullptr) {
+            ok = false;
+        }
+        else if (arg == "--sizes") {
+            ok = parseSizeList(value, command.sizes);
+        }
+        else if (arg == "--blocks") {
+            ok = parseSizeList(value, command.blockSizes);
+        }
+        else if (arg == "--warmup") {
+            command.options.warmup = std::atoi(value);
+            ok = command.options.warmup >= 0;
+        }
+        else if (arg == "--repeats") {
+            command.options.repeats = std::atoi(value);
+            ok = command.options.repeats >= 1;
+        }
+        else if (arg == "--json") {
+            command.jsonPath = value;
+        }
+        else if (arg == "--csv") {
+            command.csvPath = value;
+        }
+        else if (arg == "--baseline") {
+            command.baselinePath = value;
+        }
+        else if (arg == "--verify-bound") {
+            command.verifyBound = std::atof(value);
+            ok = command.verifyBound > 0.0 && command.verifyBound < 1.0;
+        }
+        else {
+            command.tolerance = std::atof(value);
+            ok = command.tolerance >= 0.0;
+        }
+
+        if (!ok) {
+            std::cerr << "Bad or missing value for " << arg << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkCommand command;
+    if (!parseArguments(argc, argv, command)) {
+        return 2;
+    }
+    if (command.enabled) {
+        try {
+            return runBenchmarks(command);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Benchmark failed: " << e.what() << std::endl;
+            return 2;
+        }
+    }
+
     std::cout << "Matrix multiplication with pthread" << std::endl;
+    std::cout << "SIMD kernels: " << simdIsaName(activeSimdIsa()) << std::endl;
     std::cout << std::string(84, '-') << std::endl;
 
     testPThreadMultiplication(20);
@@ -118,6 +1094,88 @@ int main() {
     std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
 
     testPThreadMultiplication(200);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    // Tall-skinny and short-wide products
+    testRectangularMultiplication(2000, 64, 16, 64);
+    std::cout << std::endl;
+    testRectangularMultiplication(16, 4096, 16, 64);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testStrassenMultiplication(129, 257, 131, 16);
+    std::cout << std::endl;
+    testStrassenMultiplication(1025, 1023, 1021, 128);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testSimdKernels(67, 131, 45);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testNumaPlacement(1000, 128);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    // Times in microseconds
+    std::cout << "Batched small products:" << std::endl;
+    std::cout << std::setw(6) << "size" << std::setw(10) << "batch"
+              << std::setw(16) << "per-pair" << std::setw(16) << "batched"
+              << std::setw(8) << "match" << std::endl;
+    for (int size : {4, 8, 16, 32, 20}) {
+        testBatchedMultiplication(size, 20000);
+    }
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testFusedMultiplication(1000);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testFillAndCompare(4000);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testTransposedMultiplication(1500);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testMortonMultiplication(1500);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testHardwareCounters(1000, 64);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testAsyncMultiplication(1500);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testMatrixGraph(1000);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testFreivaldsVerification(2000);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testMatrixVector(4000, 16);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testDistributedMultiplication(1000, 4);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    // Same product with different element / accumulator types
+    std::cout << "Element types (500x500, k=64):" << std::endl;
+    testElementType<std::int8_t, std::int32_t>("int8 -> int32", 500, 64);
+    testElementType<std::int16_t, std::int32_t>("int16 -> int32", 500, 64);
+    testElementType<std::int32_t, std::int32_t>("int32", 500, 64);
+    testElementType<std::int32_t, std::int64_t>("int32 -> int64", 500, 64);
+    testElementType<float, float>("float", 500, 64);
+    testElementType<double, double>("double", 500, 64);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    // Sparse kernels against the dense multiply, times in microseconds
+    std::cout << "Sparse products (2000x2000):" << std::endl;
+    std::cout << std::setw(9) << "density" << std::setw(14) << "dense"
+              << std::setw(14) << "sparse*dense" << std::setw(14) << "sparse*sparse"
+              << std::setw(13) << "C density" << std::setw(8) << "match" << std::endl;
+    for (double density : {0.2, 0.05, 0.01, 0.001, 0.0001}) {
+        testSparseMultiplication(2000, density);
+    }
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    testMatrixFile(1000, 128);
+    std::cout << std::endl;
+    testOutOfCoreMultiplication(1500, 2 * 1024 * 1024);
 
     return 0;
 }
@@ -7,46 +7,92 @@
 #include <cstdlib>  
 #include <ctime> 
 
-Matrix::Matrix() : rows(0), cols(0) {}
+Matrix::Matrix() : rows(0), cols(0), stride(0) {}
 
-Matrix::Matrix(int r, int c) : rows(r), cols(c) {
+Matrix::Matrix(int r, int c) : rows(r), cols(c), stride(0) {
     if (r < 0 || c < 0) {
         throw std::invalid_argument("Matrix dimensions must be non-negative");
     }
-    data.resize(r, std::vector<int>(c, 0));
+    stride = strideFor(c);
+    data.assign(static_cast<size_t>(r) * stride, 0);
 }
 
-Matrix::Matrix(const std::vector<std::vector<int>>& d) : data(d) {
+Matrix::Matrix(const std::vector<std::vector<int>>& d) : rows(0), cols(0), stride(0) {
     rows = d.size();
     if (rows > 0) {
         cols = d[0].size();
-        for (const auto& row : data) {
+        for (const auto& row : d) {
             if (row.size() != cols) {
                 throw std::invalid_argument("All matrix rows must have equal length");
             }
         }
     }
-    else {
-        cols = 0;
+    stride = strideFor(cols);
+    data.assign(static_cast<size_t>(rows) * stride, 0);
+    for (int i = 0; i < rows; i++) {
+        std::copy(d[i].begin(), d[i].end(), rowPtr(i));
+    }
+}
+
+// Rows start on a cache line (16 ints). Strides that are a multiple of 4 KB get one
+// extra line so that walking down a column does not hit the same cache set every row.
+int Matrix::strideFor(int c) {
+    const int lineInts = 16;
+    int s = (c + lineInts - 1) / lineInts * lineInts;
+    if (s > 0 && s % 1024 == 0) {
+        s += lineInts;
     }
+    return s;
 }
 
 int Matrix::getRows() const { return rows; }
 
 int Matrix::getCols() const { return cols; }
 
+int Matrix::getStride() const { return stride; }
+
 int& Matrix::operator()(int i, int j) {
     if (i < 0 || i >= rows || j < 0 || j >= cols) {
         throw std::out_of_range("Matrix index out of bounds");
     }
-    return data[i][j];
+    return rowPtr(i)[j];
 }
 
 const int& Matrix::operator()(int i, int j) const {
     if (i < 0 || i >= rows || j < 0 || j >= cols) {
         throw std::out_of_range("Matrix index out of bounds");
     }
-    return data[i][j];
+    return rowPtr(i)[j];
+}
+
+MatrixView Matrix::view() {
+    return MatrixView(data.data(), rows, cols, stride);
+}
+
+ConstMatrixView Matrix::view() const {
+    return ConstMatrixView(data.data(), rows, cols, stride);
+}
+
+MatrixView Matrix::block(int r, int c, int nr, int nc) {
+    if (r < 0 || c < 0 || nr < 0 || nc < 0 || r + nr > rows || c + nc > cols) {
+        throw std::out_of_range("Matrix block out of bounds");
+    }
+    return view().block(r, c, nr, nc);
+}
+
+ConstMatrixView Matrix::block(int r, int c, int nr, int nc) const {
+    if (r < 0 || c < 0 || nr < 0 || nc < 0 || r + nr > rows || c + nc > cols) {
+        throw std::out_of_range("Matrix block out of bounds");
+    }
+    return view().block(r, c, nr, nc);
+}
+
+MatrixView Matrix::rowRange(int begin, int end) {
+    return block(begin, 0, end - begin, cols);
+}
+
+ConstMatrixView Matrix::rowRange(int begin, int end) const {
+    return block(begin, 0, end - begin, cols);
 }
 
 void Matrix::randomFill(int min, int max) {
@@ -55,8 +101,9 @@ void Matrix::randomFill(int min, int max) {
     std::uniform_int_distribution<> distrib(min, max);
 
     for (int i = 0; i < rows; i++) {
+        int* row = rowPtr(i);
         for (int j = 0; j < cols; j++) {
-            data[i][j] = distrib(gen);
+            row[j] = distrib(gen);
         }
     }
 }
@@ -71,7 +118,7 @@ void Matrix::print(const std::string& name, int limit) const {
 
     for (int i = 0; i < displayRows; i++) {
         for (int j = 0; j < displayCols; j++) {
-            std::cout << std::setw(4) << data[i][j];
+            std::cout << std::setw(4) << rowPtr(i)[j];
         }
         if (displayCols < cols) std::cout << " ...";
         std::cout << std::endl;
@@ -83,9 +130,7 @@ bool Matrix::equals(const Matrix& other) const {
     if (rows != other.rows || cols != other.cols) return false;
 
     for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            if (data[i][j] != other(i, j)) return false;
-        }
+        if (!std::equal(rowPtr(i), rowPtr(i) + cols, other.rowPtr(i))) return false;
     }
     return true;
 }
@@ -102,13 +147,16 @@ Matrix Matrix::sequentialMultiply(const Matrix& A, const Matrix& B) {
 
     Matrix result(M, N);
 
+    // i-k-j order: the innermost loop streams a row of B and a row of the result
     for (int i = 0; i < M; i++) {
-        for (int j = 0; j < N; j++) {
-            int sum = 0;
-            for (int k = 0; k < K; k++) {
-                sum += A(i, k) * B(k, j);
+        const int* a = A.rowPtr(i);
+        int* c = result.rowPtr(i);
+        for (int k = 0; k < K; k++) {
+            int aik = a[k];
+            const int* b = B.rowPtr(k);
+            for (int j = 0; j < N; j++) {
+                c[j] += aik * b[j];
             }
-            result(i, j) = sum;
         }
     }
 
@@ -1,14 +1,70 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include "AlignedAllocator.h"
+#include <cstddef>
 #include <vector>
 #include <string>
 
+// Non-owning window into row-major storage: element (i, j) is data[i * stride + j].
+// No bounds checks, meant for inner loops.
+class MatrixView {
+public:
+    int* data;
+    int rows;
+    int cols;
+    int stride;
+
+    MatrixView() : data(nullptr), rows(0), cols(0), stride(0) {}
+    MatrixView(int* d, int r, int c, int s) : data(d), rows(r), cols(c), stride(s) {}
+
+    int* rowPtr(int i) const { return data + static_cast<std::size_t>(i) * stride; }
+    int& operator()(int i, int j) const { return rowPtr(i)[j]; }
+
+    // Sub-matrix of nr x nc elements starting at (r, c)
+    MatrixView block(int r, int c, int nr, int nc) const {
+        return MatrixView(rowPtr(r) + c, nr, nc, stride);
+    }
+
+    // Rows [begin, end)
+    MatrixView rowRange(int begin, int end) const {
+        return MatrixView(rowPtr(begin), end - begin, cols, stride);
+    }
+};
+
+class ConstMatrixView {
+public:
+    const int* data;
+    int rows;
+    int cols;
+    int stride;
+
+    ConstMatrixView() : data(nullptr), rows(0), cols(0), stride(0) {}
+    ConstMatrixView(const int* d, int r, int c, int s) : data(d), rows(r), cols(c), stride(s) {}
+    ConstMatrixView(const MatrixView& v) : data(v.data), rows(v.rows), cols(v.cols), stride(v.stride) {}
+
+    const int* rowPtr(int i) const { return data + static_cast<std::size_t>(i) * stride; }
+    const int& operator()(int i, int j) const { return rowPtr(i)[j]; }
+
+    ConstMatrixView block(int r, int c, int nr, int nc) const {
+        return ConstMatrixView(rowPtr(r) + c, nr, nc, stride);
+    }
+
+    ConstMatrixView rowRange(int begin, int end) const {
+        return ConstMatrixView(rowPtr(begin), end - begin, cols, stride);
+    }
+};
+
 class Matrix {
 private:
-    std::vector<std::vector<int>> data;
+    // One contiguous, cache-line aligned row-major buffer of rows * stride elements.
+    // Columns [cols, stride) are padding and always hold zero.
+    std::vector<int, AlignedAllocator<int, 64>> data;
     int rows;
     int cols;
+    int stride;
+
+    static int strideFor(int c);
 
 public:
     Matrix();
@@ -18,16 +74,30 @@ public:
     int getRows() const;
     int getCols() const;
 
+    // Distance in elements between the starts of two consecutive rows
+    int getStride() const;
+
     // Access element at position (i,j) for modification
     int& operator()(int i, int j);
 
     // Access element at position (i,j) for reading only
     const int& operator()(int i, int j) const;
 
+    // Raw pointer to the first element of row i (unchecked)
+    int* rowPtr(int i) { return data.data() + static_cast<std::size_t>(i) * stride; }
+    const int* rowPtr(int i) const { return data.data() + static_cast<std::size_t>(i) * stride; }
+
+    MatrixView view();
+    ConstMatrixView view() const;
+    MatrixView block(int r, int c, int nr, int nc);
+    ConstMatrixView block(int r, int c, int nr, int nc) const;
+    MatrixView rowRange(int begin, int end);
+    ConstMatrixView rowRange(int begin, int end) const;
+
     void randomFill(int min = 1, int max = 10);
     void print(const std::string& name = "", int limit = 6) const;
     bool equals(const Matrix& other) const;
     static Matrix sequentialMultiply(const Matrix& A, const Matrix& B);
 };
 
-#endif // MATRIX_H
\ No newline at end of file
+#endif // MATRIX_H
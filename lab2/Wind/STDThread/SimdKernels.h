@@ -0,0 +1,54 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+// int32 multiply-accumulate kernels for SSE4.1 / AVX2 / AVX-512 with a scalar
+// fallback. The widest instruction set supported by the CPU and the OS is picked
+// at run time (CPUID + XGETBV), so one binary runs on every x86-64 host.
+// The choice can be forced with setSimdIsa() or the MATRIX_SIMD environment
+// variable (scalar, sse4.1, avx2, avx512), which is read on first use.
+
+enum class SimdIsa {
+    Scalar = 0,
+    Sse41 = 1,
+    Avx2 = 2,
+    Avx512 = 3
+};
+
+// Computes an mr x nr tile from packed panels: a holds mr values per k step,
+// b holds nr values per k step, kc steps in total. The top-left m x n corner of
+// the tile is stored to c (row stride ldc), or added to it when accumulate is set.
+typedef void (*GemmMicroKernelFn)(int kc, const int* a, const int* b, int* c, int ldc,
+                                  int m, int n, bool accumulate);
+
+struct GemmMicroKernel {
+    SimdIsa isa;
+    int mr;
+    int nr;
+    GemmMicroKernelFn fn;
+};
+
+// y[0..n) += alpha * x[0..n)
+typedef void (*AxpyKernelFn)(int n, int alpha, const int* x, int* y);
+
+// Widest ISA this CPU and OS can run
+SimdIsa detectSimdIsa();
+
+// ISA currently used by the kernels below
+SimdIsa activeSimdIsa();
+
+// Forces the kernels to a specific ISA; throws std::invalid_argument if the
+// host cannot run it
+void setSimdIsa(SimdIsa isa);
+
+// Goes back to the detected (or MATRIX_SIMD) choice
+void resetSimdIsa();
+
+const char* simdIsaName(SimdIsa isa);
+
+// Parses "scalar", "sse4.1", "avx2" or "avx512"; throws std::invalid_argument otherwise
+SimdIsa parseSimdIsa(const char* name);
+
+const GemmMicroKernel& gemmMicroKernel();
+AxpyKernelFn axpyKernel();
+
+#endif // SIMD_KERNELS_H
@@ -1,4 +1,5 @@
 #include "StdThreadMultiplier.h"
+#include "SimdKernels.h"
 #include <iostream>
 #include <chrono>
 #include <algorithm>
@@ -6,28 +7,35 @@
 #include <vector>
 #include <mutex>
 
-StdThreadMultiplier::StdThreadMultiplier() : executionTime(0), threadCount(0) {}
+// Shortest K slice worth a thread of its own when K is split
+static const int MIN_K_SLICE = 256;
+
+StdThreadMultiplier::StdThreadMultiplier() : executionTime(0), threadCount(0), kSplits(1) {}
 
 void StdThreadMultiplier::multiplyBlock(const Matrix& A, const Matrix& B, Matrix& C,
-    int rowBlock, int colBlock, int blockSize, std::mutex& mtx) {
+    int rowBlock, int colBlock, int blockSize, int kBegin, int kEnd, std::mutex& mtx) {
 
-    int N = A.getRows();
     int startRow = rowBlock * blockSize;
     int startCol = colBlock * blockSize;
-    int endRow = std::min(startRow + blockSize, N);
-    int endCol = std::min(startCol + blockSize, N);
+    int endRow = std::min(startRow + blockSize, A.getRows());
+    int endCol = std::min(startCol + blockSize, B.getCols());
+    int width = endCol - startCol;
+
+    // Row i of the block is built as sum over k of A(i, k) * (row k of B),
+    // so the inner loop is a unit-stride vector multiply-add
+    AxpyKernelFn axpy = axpyKernel();
+    std::vector<int> rowSum(width);
 
     for (int i = startRow; i < endRow; ++i) {
-        for (int j = startCol; j < endCol; ++j) {
-            int sum = 0;
-            for (int k = 0; k < N; ++k) {
-                sum += A(i, k) * B(k, j);
-            }
-
-            // Lock for writing
-            std::lock_guard<std::mutex> lock(mtx);
-            C(i, j) = sum;
+        std::fill(rowSum.begin(), rowSum.end(), 0);
+        const int* a = A.rowPtr(i);
+        for (int k = kBegin; k < kEnd; ++k) {
+            axpy(width, a[k], B.rowPtr(k) + startCol, rowSum.data());
         }
+
+        // Lock for writing
+        std::lock_guard<std::mutex> lock(mtx);
+        std::copy(rowSum.begin(), rowSum.end(), C.rowPtr(i) + startCol);
     }
 }
 
@@ -40,16 +48,16 @@ Matrix StdThreadMultiplier::multiply(const Matrix& A, const Matrix& B, int block
         throw std::invalid_argument("Block size must be positive");
     }
 
-    int N = A.getRows();
-    if (B.getCols() != N || A.getCols() != N) {
-        throw std::invalid_argument("Matrices must be square and same size");
-    }
+    // A is M x K, B is K x N
+    int M = A.getRows();
+    int N = B.getCols();
+    int K = A.getCols();
 
-    Matrix result(N, N);
+    Matrix result(M, N);
     std::mutex mtx;
 
     // Calculate number of blocks
-    int numRowBlocks = (N + blockSize - 1) / blockSize;
+    int numRowBlocks = (M + blockSize - 1) / blockSize;
     int numColBlocks = (N + blockSize - 1) / blockSize;
     int totalBlocks = numRowBlocks * numColBlocks;
 
@@ -65,23 +73,46 @@ Matrix StdThreadMultiplier::multiply(const Matrix& A, const Matrix& B, int block
         auto end = std::chrono::high_resolution_clock::now();
         executionTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
         threadCount = 1;
+        kSplits = 1;
         return result;
     }
 
+    // Too few blocks for the hardware threads (tall-skinny / short-wide
+    // results): K is split as well, slice s > 0 goes to its own buffer and
+    // the slices are summed afterwards
+    kSplits = 1;
+    if (totalBlocks > 0 && totalBlocks < static_cast<int>(maxHardwareThreads)) {
+        int wanted = (static_cast<int>(maxHardwareThreads) + totalBlocks - 1) / totalBlocks;
+        kSplits = std::max(1, std::min(wanted, K / MIN_K_SLICE));
+    }
+    int kChunk = std::max(1, (K + kSplits - 1) / kSplits);
+    int totalTasks = totalBlocks * kSplits;
+    std::vector<Matrix> partials;
+    for (int s = 1; s < kSplits; ++s) {
+        partials.push_back(Matrix(M, N));
+    }
+
+    // Task t is block t % totalBlocks of K slice t / totalBlocks
+    auto runTask = [&](int task) {
+        int slice = task / totalBlocks;
+        int blockIdx = task % totalBlocks;
+        int kBegin = std::min(K, slice * kChunk);
+        int kEnd = std::min(K, kBegin + kChunk);
+        Matrix& target = slice == 0 ? result : partials[slice - 1];
+        multiplyBlock(A, B, target, blockIdx / numColBlocks, blockIdx % numColBlocks,
+            blockSize, kBegin, kEnd, mtx);
+    };
+
     auto start = std::chrono::high_resolution_clock::now();
 
-    if (totalBlocks <= static_cast<int>(maxHardwareThreads)) {
-        // Create one thread per block
-        threadCount = totalBlocks;
+    if (totalTasks <= static_cast<int>(maxHardwareThreads)) {
+        // Create one thread per task
+        threadCount = totalTasks;
         std::vector<std::thread> threads;
-        threads.reserve(totalBlocks);
-
-        for (int rowBlock = 0; rowBlock < numRowBlocks; ++rowBlock) {
-            for (int colBlock = 0; colBlock < numColBlocks; ++colBlock) {
-                threads.emplace_back(multiplyBlock,
-                    std::cref(A), std::cref(B), std::ref(result),
-                    rowBlock, colBlock, blockSize, std::ref(mtx));
-            }
+        threads.reserve(totalTasks);
+
+        for (int task = 0; task < totalTasks; ++task) {
+            threads.emplace_back(runTask, task);
         }
 
         for (auto& thread : threads) {
@@ -94,31 +125,40 @@ Matrix StdThreadMultiplier::multiply(const Matrix& A, const Matrix& B, int block
         std::vector<std::thread> threads;
         threads.reserve(threadCount);
 
-        int blocksPerThread = (totalBlocks + threadCount - 1) / threadCount;
+        int tasksPerThread = (totalTasks + threadCount - 1) / threadCount;
 
         for (int t = 0; t < threadCount; ++t) {
-            threads.emplace_back([&, t, blocksPerThread, numRowBlocks, numColBlocks]() {
-                int startBlock = t * blocksPerThread;
-                int endBlock = std::min(startBlock + blocksPerThread, totalBlocks);
+            threads.emplace_back([&, t, tasksPerThread]() {
+                int startTask = t * tasksPerThread;
+                int endTask = std::min(startTask + tasksPerThread, totalTasks);
+
+                for (int task = startTask; task < endTask; ++task) {
+                    runTask(task);
+                }
+                });
+        }
 
-                for (int blockIdx = startBlock; blockIdx < endBlock; ++blockIdx) {
-                    int rowBlock = blockIdx / numColBlocks;
-                    int colBlock = blockIdx % numColBlocks;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
 
-                    int startRow = rowBlock * blockSize;
-                    int startCol = colBlock * blockSize;
-                    int endRow = std::min(startRow + blockSize, N);
-                    int endCol = std::min(startCol + blockSize, N);
+    if (kSplits > 1) {
+        // Sum the slices into the result, one band of rows per thread
+        int reduceThreads = std::min(threadCount, M);
+        std::vector<std::thread> threads;
+        threads.reserve(reduceThreads);
 
+        for (int t = 0; t < reduceThreads; ++t) {
+            threads.emplace_back([&, t]() {
+                int startRow = static_cast<int>(static_cast<long long>(M) * t / reduceThreads);
+                int endRow = static_cast<int>(static_cast<long long>(M) * (t + 1) / reduceThreads);
+                for (const Matrix& partial : partials) {
                     for (int i = startRow; i < endRow; ++i) {
-                        for (int j = startCol; j < endCol; ++j) {
-                            int sum = 0;
-                            for (int k = 0; k < N; ++k) {
-                                sum += A(i, k) * B(k, j);
-                            }
-
-                            std::lock_guard<std::mutex> lock(mtx);
-                            result(i, j) = sum;
+                        int* c = result.rowPtr(i);
+                        const int* p = partial.rowPtr(i);
+                        for (int j = 0; j < N; ++j) {
+                            c[j] += p[j];
                         }
                     }
                 }
@@ -142,4 +182,8 @@ long long StdThreadMultiplier::getLastExecutionTime() const {
 
 int StdThreadMultiplier::getThreadCount() const {
     return threadCount;
+}
+
+int StdThreadMultiplier::getKSplitCount() const {
+    return kSplits;
 }
\ No newline at end of file
@@ -10,9 +10,11 @@ class StdThreadMultiplier {
 private:
     long long executionTime;
     int threadCount;
+    int kSplits;
 
+    // Block (rowBlock, colBlock) of A * B over k in [kBegin, kEnd)
     static void multiplyBlock(const Matrix& A, const Matrix& B, Matrix& C,
-        int rowBlock, int colBlock, int blockSize, std::mutex& mtx);
+        int rowBlock, int colBlock, int blockSize, int kBegin, int kEnd, std::mutex& mtx);
 
 public:
     StdThreadMultiplier();
@@ -21,6 +23,8 @@ public:
 
     long long getLastExecutionTime() const;
     int getThreadCount() const;
+    // Number of K slices of the last call (1: plain 2D tiling)
+    int getKSplitCount() const;
 };
 
 #endif
\ No newline at end of file
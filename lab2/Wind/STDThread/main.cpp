@@ -108,6 +108,30 @@ void testStdThreadMultiplication(int matrixSize) {
         << static_cast<double>(timeSeq) / bestTime << "x" << std::endl;
 }
 
+void testRectangularMultiplication(int M, int K, int N, int blockSize) {
+    std::cout << "Shape: " << M << "x" << K << " * " << K << "x" << N
+        << " (k=" << blockSize << ")" << std::endl;
+
+    Matrix A(M, K);
+    Matrix B(K, N);
+    A.randomFill(1, 10);
+    B.randomFill(1, 10);
+
+    auto startSeq = std::chrono::high_resolution_clock::now();
+    Matrix seqResult = Matrix::sequentialMultiply(A, B);
+    auto endSeq = std::chrono::high_resolution_clock::now();
+    auto timeSeq = std::chrono::duration_cast<std::chrono::microseconds>(endSeq - startSeq).count();
+
+    StdThreadMultiplier multiplier;
+    Matrix parResult = multiplier.multiply(A, B, blockSize);
+
+    std::cout << "Sequential time: " << timeSeq << " microseconds" << std::endl;
+    std::cout << "Parallel time: " << multiplier.getLastExecutionTime() << " microseconds ("
+        << multiplier.getThreadCount() << " threads, "
+        << multiplier.getKSplitCount() << " K-slices)" << std::endl;
+    std::cout << "Results match: " << (parResult.equals(seqResult) ? "yes" : "no") << std::endl;
+}
+
 int main() {
     std::cout << "Matrix multiplication with std::thread" << std::endl;
     std::cout << std::string(84, '-') << std::endl;
@@ -123,6 +147,12 @@ int main() {
     std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
 
     testStdThreadMultiplication(300);
+    std::cout << std::endl << std::string(84, '-') << std::endl << std::endl;
+
+    // Tall-skinny and short-wide products
+    testRectangularMultiplication(2000, 64, 16, 64);
+    std::cout << std::endl;
+    testRectangularMultiplication(16, 4096, 16, 64);
 
     return 0;
 }
\ No newline at end of file